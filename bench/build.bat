@@ -0,0 +1,9 @@
+@echo off
+
+cl /O2 bench/escape.c generator/escape.c /I . /Fe:escape_bench
+cl /O2 bench/containers.c /I . /Fe:container_bench
+
+rem The pipeline benchmark is POSIX only, see build.sh.
+cl /O2 bench/corpus.c /Fe:corpus
+
+del *.obj
\ No newline at end of file
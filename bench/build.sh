@@ -0,0 +1,8 @@
+#!/bin/sh
+
+cc -O2 -fgnu89-inline bench/escape.c generator/escape.c -I. -o escape_bench
+
+cc -O2 -fgnu89-inline bench/containers.c -I. -o container_bench
+
+cc -O2 bench/corpus.c -o corpus
+cc -O2 -fgnu89-inline bench/pipeline.c generator/*.c -I. -o pipeline -lpthread
@@ -0,0 +1,545 @@
+// Times the containers on their own: darray pushes, inserts and
+// erases, dictionary puts and lookups at different load factors and
+// string making, appending and comparing at different sizes. Every
+// benchmark reports the best ns/op over a few runs and how many
+// allocations and bytes an op took, one line each, so the output of
+// two builds can be diffed. Only what's between timer_start and
+// timer_stop is timed or counted.
+// Build with bench/build.sh (or build.bat) from the repo root.
+//
+//     container_bench [filter]
+//
+// Only benchmarks with filter in their name run if it's given.
+
+// Allocations are counted through the hooks alloc.h has for tracking,
+// without the locking and call site table of the real tracker.
+#define CONTAINER_TRACK_ALLOCS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STRING_IMPL
+#include "containers/string.h"
+
+#define DARRAY_IMPL
+#include "containers/darray.h"
+
+#define DICTIONARY_IMPL
+#include "containers/dictionary.h"
+
+#define RUNS 5
+
+// Roughly how many ops a run does, benchmarks repeat
+// themselves until they get there.
+#define TARGET_OPS (1 << 20)
+
+typedef struct
+{
+    double started;
+    double elapsed;
+    size_t ops;
+
+    int counting;
+    size_t allocs;
+    size_t bytes;
+} Bench_Run;
+
+static Bench_Run run;
+
+// Keeps results alive so the work isn't optimized away.
+static volatile size_t sink;
+
+static double now()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void timer_start()
+{
+    run.counting = 1;
+    run.started = now();
+}
+
+static void timer_stop()
+{
+    run.elapsed += now() - run.started;
+    run.counting = 0;
+}
+
+static void count_alloc(size_t size)
+{
+    if (!run.counting)
+        return;
+
+    run.allocs++;
+    run.bytes += size;
+}
+
+void* alloc_track_malloc(size_t size, const char* file, int line)
+{
+    count_alloc(size);
+    return malloc(size);
+}
+
+void* alloc_track_calloc(size_t n, size_t size, const char* file, int line)
+{
+    count_alloc(n * size);
+    return calloc(n, size);
+}
+
+// Reallocs count as allocations too since that's what they
+// usually turn into once a block has to grow.
+void* alloc_track_realloc(void* ptr, size_t size, const char* file, int line)
+{
+    count_alloc(size);
+    return realloc(ptr, size);
+}
+
+void alloc_track_free(void* ptr)
+{
+    free(ptr);
+}
+
+static size_t repeats(size_t ops_per_repeat)
+{
+    size_t count = TARGET_OPS / ops_per_repeat;
+    return (count > 0) ? count : 1;
+}
+
+/* DARRAY */
+
+static void darray_push_back(size_t size, double load)
+{
+    for (size_t r = repeats(size); r > 0; r--)
+    {
+        timer_start();
+
+        DArray(int) arr;
+        da_make(arr);
+
+        for (size_t i = 0; i < size; i++)
+            da_push_back(arr, (int) i);
+
+        sink += da_size(arr);
+        da_free(arr);
+
+        timer_stop();
+        run.ops += size;
+    }
+}
+
+static void darray_push_back_reserved(size_t size, double load)
+{
+    for (size_t r = repeats(size); r > 0; r--)
+    {
+        timer_start();
+
+        DArray(int) arr;
+        da_make_with_cap(arr, size);
+
+        for (size_t i = 0; i < size; i++)
+            da_push_back(arr, (int) i);
+
+        sink += da_size(arr);
+        da_free(arr);
+
+        timer_stop();
+        run.ops += size;
+    }
+}
+
+static void darray_insert_front(size_t size, double load)
+{
+    for (size_t r = repeats(size * size / 16); r > 0; r--)
+    {
+        timer_start();
+
+        DArray(int) arr;
+        da_make(arr);
+
+        for (size_t i = 0; i < size; i++)
+            da_insert(arr, 0, (int) i);
+
+        sink += da_size(arr);
+        da_free(arr);
+
+        timer_stop();
+        run.ops += size;
+    }
+}
+
+static void darray_erase_at_front(size_t size, double load)
+{
+    for (size_t r = repeats(size * size / 16); r > 0; r--)
+    {
+        DArray(int) arr;
+        da_make_with_cap(arr, size);
+        for (size_t i = 0; i < size; i++)
+            da_push_back(arr, (int) i);
+
+        timer_start();
+
+        while (da_size(arr) > 0)
+            da_erase_at(arr, 0);
+
+        timer_stop();
+        run.ops += size;
+
+        da_free(arr);
+    }
+}
+
+static void darray_erase_swap(size_t size, double load)
+{
+    for (size_t r = repeats(size); r > 0; r--)
+    {
+        DArray(int) arr;
+        da_make_with_cap(arr, size);
+        for (size_t i = 0; i < size; i++)
+            da_push_back(arr, (int) i);
+
+        timer_start();
+
+        while (da_size(arr) > 0)
+            da_erase_swap(arr, 0);
+
+        timer_stop();
+        run.ops += size;
+
+        da_free(arr);
+    }
+}
+
+static void darray_foreach(size_t size, double load)
+{
+    DArray(int) arr;
+    da_make_with_cap(arr, size);
+    for (size_t i = 0; i < size; i++)
+        da_push_back(arr, (int) i);
+
+    for (size_t r = repeats(size); r > 0; r--)
+    {
+        timer_start();
+
+        size_t sum = 0;
+        da_foreach(int, it, arr)
+            sum += *it;
+
+        sink += sum;
+
+        timer_stop();
+        run.ops += size;
+    }
+
+    da_free(arr);
+}
+
+/* DICTIONARY */
+
+typedef Dict(int) Bench_Dict;
+
+static char** make_keys(const char* prefix, size_t count)
+{
+    char** keys = (char**) malloc(count * sizeof(char*));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char key[64];
+        sprintf(key, "%s-%zu", prefix, i);
+        keys[i] = (char*) malloc(strlen(key) + 1);
+        strcpy(keys[i], key);
+    }
+
+    return keys;
+}
+
+static void free_keys(char** keys, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        free(keys[i]);
+
+    free(keys);
+}
+
+// The dictionary doesn't free its keys itself.
+static void free_dict(Bench_Dict* dict)
+{
+    for (size_t i = 0; i < dict->cap; i++)
+        if (dict->buckets[i].key)
+            string_free(&dict->buckets[i].key);
+
+    dict_free((*dict));
+}
+
+// Size is the number of buckets to fill up to load.
+static Bench_Dict make_dict(char** keys, size_t size, double load)
+{
+    Bench_Dict dict;
+    dict_make(dict);
+
+    if (size > dict.cap)
+        dict_resize(dict, size);
+
+    size_t count = (size_t) (size * load);
+    for (size_t i = 0; i < count; i++)
+        dict_put(dict, keys[i], (int) i);
+
+    return dict;
+}
+
+// Starts from an empty dictionary, so this includes growing it.
+static void dict_put_keys(size_t size, double load)
+{
+    char** keys = make_keys("key", size);
+
+    for (size_t r = repeats(size); r > 0; r--)
+    {
+        Bench_Dict dict = { 0 };
+
+        timer_start();
+
+        for (size_t i = 0; i < size; i++)
+            dict_put(dict, keys[i], (int) i);
+
+        timer_stop();
+        run.ops += size;
+
+        sink += dict_filled(dict);
+        free_dict(&dict);
+    }
+
+    free_keys(keys, size);
+}
+
+static void dict_find_keys(size_t size, double load, const char* prefix)
+{
+    size_t count = (size_t) (size * load);
+    char** keys = make_keys("key", count);
+    char** lookups = (strcmp(prefix, "key") == 0) ? keys : make_keys(prefix, count);
+
+    Bench_Dict dict = make_dict(keys, size, load);
+
+    for (size_t r = repeats(count); r > 0; r--)
+    {
+        timer_start();
+
+        size_t found = 0;
+        for (size_t i = 0; i < count; i++)
+            found += dict_find(dict, lookups[i]) != dict_end(dict);
+
+        sink += found;
+
+        timer_stop();
+        run.ops += count;
+    }
+
+    free_dict(&dict);
+
+    if (lookups != keys)
+        free_keys(lookups, count);
+
+    free_keys(keys, count);
+}
+
+static void dict_find_hit(size_t size, double load)
+{
+    dict_find_keys(size, load, "key");
+}
+
+static void dict_find_miss(size_t size, double load)
+{
+    dict_find_keys(size, load, "miss");
+}
+
+/* STRING */
+
+static char* make_text(size_t length)
+{
+    char* text = (char*) malloc(length + 1);
+
+    for (size_t i = 0; i < length; i++)
+        text[i] = 'a' + i % 26;
+
+    text[length] = '\0';
+    return text;
+}
+
+static void string_make_free(size_t size, double load)
+{
+    char* text = make_text(size);
+    size_t count = repeats(1 + size / 64);
+
+    timer_start();
+
+    for (size_t r = 0; r < count; r++)
+    {
+        String str = string_make(text);
+        sink += str[0];
+        string_free(&str);
+    }
+
+    timer_stop();
+    run.ops += count;
+
+    free(text);
+}
+
+// Always the first 16 characters of a string of size.
+static void string_make_prefix(size_t size, double load)
+{
+    char* text = make_text(size);
+    size_t count = repeats(64);
+
+    timer_start();
+
+    for (size_t r = 0; r < count; r++)
+    {
+        String str = string_make_till_n(text, 16);
+        sink += str[0];
+        string_free(&str);
+    }
+
+    timer_stop();
+    run.ops += count;
+
+    free(text);
+}
+
+// Builds a string of size out of 16 character pieces.
+static void string_append_pieces(size_t size, double load)
+{
+    char* piece = make_text(16);
+    size_t pieces = size / 16;
+
+    for (size_t r = repeats(pieces * pieces / 64); r > 0; r--)
+    {
+        timer_start();
+
+        String str = NULL;
+        for (size_t i = 0; i < pieces; i++)
+            string_append(&str, piece);
+
+        sink += string_length(str);
+        string_free(&str);
+
+        timer_stop();
+        run.ops += pieces;
+    }
+
+    free(piece);
+}
+
+static void string_cmp_equal(size_t size, double load)
+{
+    char* text = make_text(size);
+    String a = string_make(text);
+    String b = string_make(text);
+    size_t count = repeats(1 + size / 64);
+
+    timer_start();
+
+    for (size_t r = 0; r < count; r++)
+        sink += string_cmp(a, b);
+
+    timer_stop();
+    run.ops += count;
+
+    string_free(&a);
+    string_free(&b);
+    free(text);
+}
+
+typedef void (*Bench_Proc)(size_t size, double load);
+
+typedef struct
+{
+    const char* name;
+    Bench_Proc proc;
+
+    // Elements, buckets or characters depending on the benchmark.
+    size_t size;
+    double load;
+} Bench;
+
+static Bench benches[] = {
+    { "darray/push_back/4",             darray_push_back,          4 },
+    { "darray/push_back/64",            darray_push_back,          64 },
+    { "darray/push_back/4096",          darray_push_back,          4096 },
+    { "darray/push_back/1048576",       darray_push_back,          1 << 20 },
+    { "darray/push_back_reserved/64",   darray_push_back_reserved, 64 },
+    { "darray/push_back_reserved/4096", darray_push_back_reserved, 4096 },
+    { "darray/insert_front/64",         darray_insert_front,       64 },
+    { "darray/insert_front/4096",       darray_insert_front,       4096 },
+    { "darray/erase_at_front/64",       darray_erase_at_front,     64 },
+    { "darray/erase_at_front/4096",     darray_erase_at_front,     4096 },
+    { "darray/erase_swap/4096",         darray_erase_swap,         4096 },
+    { "darray/foreach/4096",            darray_foreach,            4096 },
+
+    { "dict/put/100",                   dict_put_keys,             100 },
+    { "dict/put/10000",                 dict_put_keys,             10000 },
+    { "dict/put/100000",                dict_put_keys,             100000 },
+    { "dict/find_hit/1024/0.10",        dict_find_hit,             1024,  0.10 },
+    { "dict/find_hit/1024/0.50",        dict_find_hit,             1024,  0.50 },
+    { "dict/find_hit/1024/0.70",        dict_find_hit,             1024,  0.70 },
+    { "dict/find_hit/65536/0.50",       dict_find_hit,             65536, 0.50 },
+    { "dict/find_hit/65536/0.70",       dict_find_hit,             65536, 0.70 },
+    { "dict/find_miss/1024/0.10",       dict_find_miss,            1024,  0.10 },
+    { "dict/find_miss/1024/0.50",       dict_find_miss,            1024,  0.50 },
+    { "dict/find_miss/1024/0.70",       dict_find_miss,            1024,  0.70 },
+    { "dict/find_miss/65536/0.50",      dict_find_miss,            65536, 0.50 },
+    { "dict/find_miss/65536/0.70",      dict_find_miss,            65536, 0.70 },
+
+    { "string/make/8",                  string_make_free,          8 },
+    { "string/make/64",                 string_make_free,          64 },
+    { "string/make/1024",               string_make_free,          1024 },
+    { "string/make/65536",              string_make_free,          65536 },
+    { "string/make_till_n/64",          string_make_prefix,        64 },
+    { "string/make_till_n/65536",       string_make_prefix,        65536 },
+    { "string/append/256",              string_append_pieces,      256 },
+    { "string/append/4096",             string_append_pieces,      4096 },
+    { "string/append/65536",            string_append_pieces,      65536 },
+    { "string/cmp_equal/8",             string_cmp_equal,          8 },
+    { "string/cmp_equal/1024",          string_cmp_equal,          1024 },
+    { "string/cmp_equal/65536",         string_cmp_equal,          65536 },
+};
+
+#define NUM_BENCHES (int) (sizeof(benches) / sizeof(benches[0]))
+
+int main(int argc, char* argv[])
+{
+    char* filter = (argc > 1) ? argv[1] : NULL;
+
+    printf("%-32s %12s %12s %12s %12s\n", "benchmark", "ops", "ns/op", "allocs/op", "bytes/op");
+
+    for (int i = 0; i < NUM_BENCHES; i++)
+    {
+        Bench* bench = benches + i;
+        if (filter && !strstr(bench->name, filter))
+            continue;
+
+        double best = 0;
+        Bench_Run last = { 0 };
+
+        for (int r = 0; r < RUNS; r++)
+        {
+            memset(&run, 0, sizeof(run));
+            bench->proc(bench->size, bench->load);
+
+            double ns = run.elapsed * 1e9 / run.ops;
+            if (r == 0 || ns < best)
+                best = ns;
+
+            last = run;
+        }
+
+        printf("%-32s %12zu %12.2f %12.3f %12.1f\n", bench->name, last.ops, best,
+               (double) last.allocs / last.ops, (double) last.bytes / last.ops);
+        fflush(stdout);
+    }
+
+    return 0;
+}
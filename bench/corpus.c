@@ -0,0 +1,330 @@
+// Writes a synthetic portfolio and templates into a directory so swg
+// can be measured at any size. Everything comes from a seeded random
+// generator, so the same options always give the same corpus.
+// Build with bench/build.sh from the repo root.
+//
+//     corpus [options] <dir>
+//         --personas <N>      Personas (default 50)
+//         --projects <N>      Projects per persona (default 40)
+//         --skills <N>        Distinct skills across the portfolio (default 200)
+//         --per-project <N>   Skills per project (default 5)
+//         --desc <N>          Average description length in bytes (default 600)
+//         --template <shape>  flat, nested or views (default nested)
+//         --page-size <N>     Projects per persona page, 0 for one page (default 0)
+//         --seed <N>          Seed for the random generator (default 1)
+//         --outdir-last       Put $outdir after the personas instead of first,
+//                             so none of the pages can be rendered while parsing
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    int personas;
+    int projects;
+    int skills;
+    int per_project;
+    int desc;
+    int page_size;
+    char* shape;
+    unsigned int seed;
+    int outdir_last;
+} Corpus_Options;
+
+static unsigned int rng_state;
+
+static unsigned int next_random()
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int random_below(int n)
+{
+    return (n > 0) ? (int) (next_random() % (unsigned int) n) : 0;
+}
+
+static const char* words[] = {
+    "render", "engine", "shader", "frame", "light", "camera", "story", "level",
+    "player", "network", "server", "pixel", "colour", "sound", "music", "edit",
+    "build", "parse", "token", "memory", "thread", "cache", "vector", "matrix",
+    "scene", "script", "actor", "light", "shadow", "texture", "photo", "street",
+};
+
+#define NUM_WORDS (int) (sizeof(words) / sizeof(words[0]))
+
+static const char* months[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "June", "July", "Aug", "Sept", "Oct", "Nov", "Dec"
+};
+
+// Roughly length bytes of words, with the odd character
+// that has to be escaped.
+static void write_text(FILE* file, int length)
+{
+    int written = 0;
+    while (written < length)
+    {
+        const char* word = words[random_below(NUM_WORDS)];
+        written += fprintf(file, "%s%s", (written > 0) ? " " : "", word);
+
+        if (random_below(50) == 0)
+            written += fprintf(file, " &");
+    }
+}
+
+static void write_portfolio(FILE* file, Corpus_Options options)
+{
+    fprintf(file, "$home_template \"home.html\"\n");
+    fprintf(file, "$page_template \"page.html\"\n");
+
+    if (!options.outdir_last)
+        fprintf(file, "$outdir \"out\"\n");
+
+    if (options.page_size > 0)
+        fprintf(file, "$page_size \"%d\"\n", options.page_size);
+
+    fprintf(file, "\n");
+
+    for (int i = 0; i < 5; i++)
+    {
+        fprintf(file, "$link \"Link %d\" {\n", i);
+        fprintf(file, "    link: \"https://example.com/%d?a=1&b=2\";\n", i);
+        fprintf(file, "    icon: \"res/icons/link%d.svg\";\n", i);
+        fprintf(file, "    color: \"#%06x\";\n", random_below(0x1000000));
+        fprintf(file, "}\n\n");
+    }
+
+    for (int i = 0; i < options.personas; i++)
+    {
+        fprintf(file, "$persona \"Persona %d\" {\n", i);
+        fprintf(file, "    color: \"#%06x\";\n", random_below(0x1000000));
+        fprintf(file, "    image: \"res/images/persona%d.png\";\n", i);
+        fprintf(file, "    icon: \"res/icons/persona%d.png\";\n", i);
+        fprintf(file, "    abilities: [ \"%s\", \"%s\", \"%s\" ];\n",
+                words[random_below(NUM_WORDS)], words[random_below(NUM_WORDS)], words[random_below(NUM_WORDS)]);
+
+        fprintf(file, "    blurb: `");
+        write_text(file, options.desc / 2);
+        fprintf(file, "`;\n");
+
+        fprintf(file, "    projects: [\n");
+        for (int j = 0; j < options.projects; j++)
+        {
+            fprintf(file, "        {\n");
+            fprintf(file, "            name: \"Project %d %s\";\n", j, words[random_below(NUM_WORDS)]);
+            fprintf(file, "            date: \"%d %s %d\";\n",
+                    1 + random_below(28), months[random_below(12)], 2010 + random_below(15));
+
+            fprintf(file, "            desc: `");
+            write_text(file, options.desc / 2 + random_below(options.desc + 1));
+            fprintf(file, "`;\n");
+
+            fprintf(file, "            link: \"https://example.com/p/%d/%d\";\n", i, j);
+
+            fprintf(file, "            skills: [");
+            for (int k = 0; k < options.per_project; k++)
+                fprintf(file, "%s\"Skill %d\"", (k > 0) ? ", " : " ", random_below(options.skills));
+            fprintf(file, " ];\n");
+
+            fprintf(file, "            images: [ \"res/images/%d/%d.jpg\" ];\n", i, j);
+            fprintf(file, "        },\n");
+        }
+        fprintf(file, "    ];\n");
+        fprintf(file, "}\n\n");
+    }
+
+    if (options.outdir_last)
+        fprintf(file, "$outdir \"out\"\n");
+}
+
+static const char* home_flat =
+    "<html><head><title>Home</title></head><body>\n"
+    "<$personas -> p { <a href=\"<$p.name>.html\"><$p.name></a> }>\n"
+    "</body></html>\n";
+
+static const char* page_flat =
+    "<html><head><title><$name></title></head><body>\n"
+    "<h1><$name></h1><p><$blurb></p>\n"
+    "<$projects -> pj { <h2><$pj.name></h2><p><$pj.description></p> }>\n"
+    "</body></html>\n";
+
+static const char* home_nested =
+    "<html><head><title>Home</title></head><body>\n"
+    "<nav><$links -> l { <a href=\"<$l.link>\" style=\"color: <$l.color>\"><img src=\"<$l.icon>\"></a> }></nav>\n"
+    "<$personas -> p {\n"
+    "    <div style=\"background: <$p.color>\"><img src=\"<$p.image>\"><h2><$p.name></h2><p><$p.blurb></p>\n"
+    "    <ul><$p.abilities -> a { <li><$a></li> }></ul></div>\n"
+    "}>\n"
+    "</body></html>\n";
+
+static const char* page_nested =
+    "<html><head><title><$name></title></head><body style=\"--accent: <$color>\">\n"
+    "<nav><$personas -> p { <a href=\"<$p.name>.html\" <$if p.selected { class=\"selected\" }>><img src=\"<$p.icon>\"></a> }></nav>\n"
+    "<h1><$name></h1><p><$blurb></p>\n"
+    "<$projects -> pj {\n"
+    "    <article><h2><a href=\"<$pj.link>\"><$pj.name></a></h2><span><$pj.date></span>\n"
+    "    <p><$pj.description></p>\n"
+    "    <ul><$pj.skills -> s { <li><$s></li> }></ul>\n"
+    "    <$pj.images -> i { <img src=\"<$i>\" alt=\"<$pj.name>\"> }></article>\n"
+    "}>\n"
+    "<$if has_next_page { <a href=\"<$next_page>\">Next</a> }>\n"
+    "</body></html>\n";
+
+static const char* page_views =
+    "<html><head><title><$name></title></head><body style=\"--accent: <$color>\">\n"
+    "<nav><$personas -> p { <a href=\"<$p.name>.html\" <$if p.selected { class=\"selected\" }>><img src=\"<$p.icon>\"></a> }></nav>\n"
+    "<h1><$name></h1><p><$blurb></p>\n"
+    "<$projects | group_by year desc -> g {\n"
+    "    <h2><$g.name></h2>\n"
+    "    <$g.projects -> pj {\n"
+    "        <article><h3><a href=\"<$pj.link>\"><$pj.name></a></h3><span><$pj.date></span>\n"
+    "        <p><$pj.description></p>\n"
+    "        <ul><$pj.skills -> s { <li><$s></li> }></ul></article>\n"
+    "    }>\n"
+    "}>\n"
+    "<ol><$projects | sort name -> pj { <li><$pj.name></li> }></ol>\n"
+    "</body></html>\n";
+
+static int write_string(char* dir, char* name, const char* contents)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Error: Couldn't write %s\n", path);
+        return 0;
+    }
+
+    fputs(contents, file);
+    fclose(file);
+    return 1;
+}
+
+static int parse_int(char* str, int* value)
+{
+    char* end;
+    long res = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || res < 0)
+        return 0;
+
+    *value = (int) res;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    Corpus_Options options = { 50, 40, 200, 5, 600, 0, "nested", 1, 0 };
+    char* dir = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--outdir-last") == 0)
+        {
+            options.outdir_last = 1;
+            continue;
+        }
+
+        int* value = NULL;
+        if (strcmp(argv[i], "--personas") == 0)
+            value = &options.personas;
+        else if (strcmp(argv[i], "--projects") == 0)
+            value = &options.projects;
+        else if (strcmp(argv[i], "--skills") == 0)
+            value = &options.skills;
+        else if (strcmp(argv[i], "--per-project") == 0)
+            value = &options.per_project;
+        else if (strcmp(argv[i], "--desc") == 0)
+            value = &options.desc;
+        else if (strcmp(argv[i], "--page-size") == 0)
+            value = &options.page_size;
+
+        if (value || strcmp(argv[i], "--seed") == 0 || strcmp(argv[i], "--template") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                printf("Error: %s needs a value\n", argv[i]);
+                return 1;
+            }
+
+            int seed;
+            if (strcmp(argv[i], "--template") == 0)
+                options.shape = argv[i + 1];
+            else if (strcmp(argv[i], "--seed") == 0 && parse_int(argv[i + 1], &seed))
+                options.seed = (unsigned int) seed;
+            else if (!value || !parse_int(argv[i + 1], value))
+            {
+                printf("Error: %s needs a number\n", argv[i]);
+                return 1;
+            }
+
+            i++;
+            continue;
+        }
+
+        if (argv[i][0] == '-' || dir)
+        {
+            printf("Usage: corpus [options] <dir>\n");
+            return 1;
+        }
+
+        dir = argv[i];
+    }
+
+    if (!dir)
+    {
+        printf("Usage: corpus [options] <dir>\n");
+        return 1;
+    }
+
+    const char* home;
+    const char* page;
+    if (strcmp(options.shape, "flat") == 0)
+    {
+        home = home_flat;
+        page = page_flat;
+    }
+    else if (strcmp(options.shape, "nested") == 0)
+    {
+        home = home_nested;
+        page = page_nested;
+    }
+    else if (strcmp(options.shape, "views") == 0)
+    {
+        home = home_nested;
+        page = page_views;
+    }
+    else
+    {
+        printf("Error: Unknown template shape %s\n", options.shape);
+        return 1;
+    }
+
+    if (options.skills < 1)
+        options.skills = 1;
+
+    rng_state = (options.seed) ? options.seed : 1;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/portfolio.txt", dir);
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Error: Couldn't write %s\n", path);
+        return 1;
+    }
+
+    write_portfolio(file, options);
+    fclose(file);
+
+    if (!write_string(dir, "home.html", home) || !write_string(dir, "page.html", page))
+        return 1;
+
+    return 0;
+}
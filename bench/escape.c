@@ -0,0 +1,132 @@
+// Compares escape_html with a plain loop that looks at one
+// character at a time, over text with more and less to escape.
+// Build with bench/build.sh (or build.bat) from the repo root.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "generator/escape.h"
+
+#define TEXT_SIZE (32 * 1024 * 1024)
+#define RUNS 5
+
+typedef struct
+{
+    char* data;
+    size_t length;
+} Buffer;
+
+static void buffer_write(void* data, char* chunk, size_t length)
+{
+    Buffer* buffer = (Buffer*) data;
+    memcpy(buffer->data + buffer->length, chunk, length);
+    buffer->length += length;
+}
+
+static void escape_scalar(char* str, size_t length, Escape_Context context, Buffer* out)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        char* replacement = NULL;
+        switch (str[i])
+        {
+            case '&':  replacement = "&amp;"; break;
+            case '<':  replacement = "&lt;"; break;
+            case '>':  replacement = "&gt;"; break;
+            case '"':  replacement = (context == ESCAPE_ATTRIBUTE) ? "&quot;" : NULL; break;
+            case '\'': replacement = (context == ESCAPE_ATTRIBUTE) ? "&#39;" : NULL; break;
+        }
+
+        if (replacement)
+            buffer_write(out, replacement, strlen(replacement));
+        else
+            out->data[out->length++] = str[i];
+    }
+}
+
+static double now()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Text made of words, with one in every special_every
+// characters being one that has to be escaped.
+static char* make_text(size_t length, int special_every)
+{
+    static const char specials[] = "&<>\"'";
+    char* text = (char*) malloc(length + 1);
+
+    srand(1234);
+    for (size_t i = 0; i < length; i++)
+    {
+        if (special_every > 0 && rand() % special_every == 0)
+            text[i] = specials[rand() % 5];
+        else
+            text[i] = (rand() % 6 == 0) ? ' ' : 'a' + rand() % 26;
+    }
+
+    text[length] = '\0';
+    return text;
+}
+
+int main()
+{
+    int densities[] = { 0, 2000, 200, 20 };
+    Buffer simd   = { (char*) malloc(TEXT_SIZE * 6), 0 };
+    Buffer scalar = { (char*) malloc(TEXT_SIZE * 6), 0 };
+
+    printf("%-12s %-10s %12s %12s %8s\n", "special", "context", "simd MB/s", "scalar MB/s", "speedup");
+
+    for (int d = 0; d < (int) (sizeof(densities) / sizeof(densities[0])); d++)
+    {
+        char* text = make_text(TEXT_SIZE, densities[d]);
+
+        for (int context = ESCAPE_TEXT; context <= ESCAPE_ATTRIBUTE; context++)
+        {
+            double best_simd = 1e9, best_scalar = 1e9;
+
+            for (int run = 0; run < RUNS; run++)
+            {
+                simd.length = 0;
+                double start = now();
+                escape_html(text, TEXT_SIZE, (Escape_Context) context, buffer_write, &simd);
+                double time = now() - start;
+                if (time < best_simd)
+                    best_simd = time;
+
+                scalar.length = 0;
+                start = now();
+                escape_scalar(text, TEXT_SIZE, (Escape_Context) context, &scalar);
+                time = now() - start;
+                if (time < best_scalar)
+                    best_scalar = time;
+            }
+
+            if (simd.length != scalar.length || memcmp(simd.data, scalar.data, simd.length) != 0)
+            {
+                printf("Outputs don't match!\n");
+                return 1;
+            }
+
+            char label[32];
+            if (densities[d] > 0)
+                sprintf(label, "1 in %d", densities[d]);
+            else
+                sprintf(label, "none");
+
+            double mb = TEXT_SIZE / (1024.0 * 1024.0);
+            printf("%-12s %-10s %12.0f %12.0f %7.1fx\n", label,
+                   (context == ESCAPE_TEXT) ? "text" : "attribute",
+                   mb / best_simd, mb / best_scalar, best_scalar / best_simd);
+        }
+
+        free(text);
+    }
+
+    free(simd.data);
+    free(scalar.data);
+    return 0;
+}
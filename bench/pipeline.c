@@ -0,0 +1,328 @@
+// Runs each phase of swg on its own over a portfolio, usually one
+// made by corpus.c, and reports how long each took, how much it got
+// through and the peak memory use so far. The last row is a whole
+// build through generate_webpages on as many threads as --jobs.
+// Linux only. Build with bench/build.sh from the repo root.
+//
+//     pipeline [--runs N] [--jobs N] <dir/portfolio.txt>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "generator/parser.h"
+#include "generator/webpage.h"
+#include "generator/build.h"
+#include "generator/filestuff.h"
+
+typedef enum
+{
+    PHASE_LOAD,
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_TEMPLATES,
+    PHASE_GENERATE,
+    PHASE_WRITE,
+    PHASE_BUILD,
+    NUM_PHASES
+} Phase;
+
+static const char* phase_names[NUM_PHASES] = {
+    "load_file",
+    "lexer_lex",
+    "parser_parse",
+    "template_parser_parse",
+    "generate_page",
+    "write_file",
+    "generate_webpages"
+};
+
+typedef struct
+{
+    double seconds;
+    size_t bytes;
+    int pages;
+    long peak_rss;
+} Phase_Result;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// High water mark of the process in KB.
+static long peak_rss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static int parse_template(String path, Template_Parser* tp, size_t* bytes)
+{
+    String contents = load_file(path);
+    if (!contents)
+    {
+        printf("Error: Couldn't load %s\n", path);
+        return 0;
+    }
+
+    *bytes += strlen(contents);
+    *tp = template_parser_make(contents);
+    template_parser_parse(tp);
+
+    if (tp->status == TP_FAILURE)
+    {
+        printf("%s\n", tp->message);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Renders and writes one page, adding the time each took.
+static int run_page(Generator* gen, Portfolio portfolio, int selected, DArray(Stage) stages,
+                    Page_Info* page, char* name, Phase_Result* results)
+{
+    generator_reset(gen);
+    gen->stages = stages;
+    gen->page = (page && page->number_text) ? page : NULL;
+
+    double start = now();
+    generate_page(gen, portfolio, selected);
+    results[PHASE_GENERATE].seconds += now() - start;
+
+    if (gen->status == GEN_FAILURE)
+    {
+        printf("%s\n", gen->message);
+        return 0;
+    }
+
+    results[PHASE_GENERATE].bytes += gen->output_size;
+    results[PHASE_GENERATE].pages++;
+
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s/%s", portfolio.outdir, name);
+
+    start = now();
+    int res = write_file_segments(filepath, gen->segments) ||
+              (make_dirs(filepath) && write_file_segments(filepath, gen->segments));
+    results[PHASE_WRITE].seconds += now() - start;
+
+    if (!res)
+    {
+        printf("Error: Couldn't write %s\n", filepath);
+        return 0;
+    }
+
+    results[PHASE_WRITE].bytes += gen->output_size;
+    results[PHASE_WRITE].pages++;
+    return 1;
+}
+
+static int run_pipeline(char* filepath, int jobs, Phase_Result* results)
+{
+    double start = now();
+    String contents = load_file(filepath);
+    results[PHASE_LOAD].seconds = now() - start;
+
+    if (!contents)
+    {
+        printf("Error: Couldn't load %s\n", filepath);
+        return 0;
+    }
+
+    size_t size = strlen(contents);
+    results[PHASE_LOAD].bytes = size;
+    results[PHASE_LOAD].peak_rss = peak_rss();
+
+    // The lexer takes the contents.
+    Lexer lexer = lexer_make(contents);
+    start = now();
+    lexer_lex(&lexer);
+    results[PHASE_LEX].seconds = now() - start;
+    results[PHASE_LEX].bytes = size;
+    results[PHASE_LEX].peak_rss = peak_rss();
+
+    if (lexer.status == LEXER_FAILURE)
+    {
+        printf("%s\n", lexer.message);
+        lexer_free(&lexer);
+        return 0;
+    }
+
+    Parser parser = parser_make(lexer.tokens);
+    start = now();
+    Portfolio portfolio = parser_parse(&parser);
+    results[PHASE_PARSE].seconds = now() - start;
+    results[PHASE_PARSE].bytes = size;
+    results[PHASE_PARSE].peak_rss = peak_rss();
+
+    int res = parser.status != PARSER_FAILURE;
+    if (!res)
+        printf("%s\n", parser.message);
+
+    // The tokens belong to the lexer.
+    parser.tokens = NULL;
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    Template_Parser home_tp = { 0 };
+    Template_Parser page_tp = { 0 };
+    if (res)
+    {
+        start = now();
+        res = parse_template(portfolio.home_template, &home_tp, &results[PHASE_TEMPLATES].bytes) &&
+              parse_template(portfolio.page_template, &page_tp, &results[PHASE_TEMPLATES].bytes);
+        results[PHASE_TEMPLATES].seconds = now() - start;
+        results[PHASE_TEMPLATES].peak_rss = peak_rss();
+    }
+
+    if (res)
+    {
+        Skill_Map skills = skill_map_make(portfolio);
+        View_Cache views;
+        view_cache_make(&views);
+
+        Generator gen = generator_make(NULL);
+        gen.skills = &skills;
+        gen.views = &views;
+
+        res = run_page(&gen, portfolio, -1, home_tp.stages, NULL, "index.html", results);
+
+        for (int i = 0; res && i < da_size(portfolio.personas); i++)
+        {
+            int count = persona_page_count(portfolio, i);
+            for (int number = 1; res && number <= count; number++)
+            {
+                char name[PAGE_NAME_SIZE];
+                page_name(name, portfolio.personas[i], number);
+
+                Page_Info page = page_info_make(portfolio, i, number);
+                res = run_page(&gen, portfolio, i, page_tp.stages, &page, name, results);
+                page_info_free(&page);
+            }
+        }
+
+        results[PHASE_GENERATE].peak_rss = peak_rss();
+        results[PHASE_WRITE].peak_rss = results[PHASE_GENERATE].peak_rss;
+
+        generator_free(&gen);
+        view_cache_free(&views);
+        skill_map_free(&skills);
+    }
+
+    if (res)
+    {
+        Webpage_Options options = { 0 };
+        options.jobs = jobs;
+
+        start = now();
+        res = generate_webpages(portfolio, options) == WP_SUCCESS;
+        results[PHASE_BUILD].seconds = now() - start;
+        results[PHASE_BUILD].bytes = results[PHASE_WRITE].bytes;
+        results[PHASE_BUILD].pages = results[PHASE_WRITE].pages;
+        results[PHASE_BUILD].peak_rss = peak_rss();
+
+        if (!res)
+            printf("Error: generate_webpages failed\n");
+    }
+
+    if (home_tp.content)
+        template_parser_free(&home_tp);
+
+    if (page_tp.content)
+        template_parser_free(&page_tp);
+
+    portfolio_free(&portfolio);
+    return res;
+}
+
+int main(int argc, char** argv)
+{
+    int runs = 1;
+    int jobs = 1;
+    char* filepath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--runs") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc)
+        {
+            int value = atoi(argv[i + 1]);
+            if (value < 1)
+            {
+                printf("Error: %s expects a positive number\n", argv[i]);
+                return 1;
+            }
+
+            *((argv[i][2] == 'r') ? &runs : &jobs) = value;
+            i++;
+        }
+        else if (argv[i][0] != '-' && !filepath)
+        {
+            filepath = argv[i];
+        }
+        else
+        {
+            printf("Usage: pipeline [--runs N] [--jobs N] <portfolio>\n");
+            return 1;
+        }
+    }
+
+    if (!filepath)
+    {
+        printf("Usage: pipeline [--runs N] [--jobs N] <portfolio>\n");
+        return 1;
+    }
+
+    // Paths in the portfolio are relative to where it is.
+    char* slash = strrchr(filepath, '/');
+    if (slash)
+    {
+        *slash = '\0';
+        if (chdir(filepath) != 0)
+        {
+            printf("Error: Couldn't change to %s\n", filepath);
+            return 1;
+        }
+        filepath = slash + 1;
+    }
+
+    // Keeps the fastest of the runs for each phase.
+    Phase_Result best[NUM_PHASES] = { 0 };
+    for (int run = 0; run < runs; run++)
+    {
+        Phase_Result results[NUM_PHASES] = { 0 };
+        if (!run_pipeline(filepath, jobs, results))
+            return 1;
+
+        for (int i = 0; i < NUM_PHASES; i++)
+            if (run == 0 || results[i].seconds < best[i].seconds)
+                best[i] = results[i];
+    }
+
+    printf("%-22s %10s %10s %10s %8s %10s %10s\n",
+           "phase", "ms", "MB", "MB/s", "pages", "pages/s", "peak KB");
+
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        Phase_Result r = best[i];
+        double mb = r.bytes / (1024.0 * 1024.0);
+        double seconds = (r.seconds > 0) ? r.seconds : 1e-9;
+
+        printf("%-22s %10.2f %10.2f %10.1f %8d", phase_names[i], r.seconds * 1000, mb, mb / seconds, r.pages);
+
+        if (r.pages > 0)
+            printf(" %10.0f", r.pages / seconds);
+        else
+            printf(" %10s", "-");
+
+        printf(" %10ld\n", r.peak_rss);
+    }
+
+    return 0;
+}
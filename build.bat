@@ -1,6 +1,6 @@
 @echo off
 
 cl /c generator/*.c /I ..\swg
-cl main.c *.obj /Fe:swg
+cl main.c *.obj /Fe:swg psapi.lib
 
 del *.obj
\ No newline at end of file
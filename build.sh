@@ -0,0 +1,6 @@
+#!/bin/sh
+
+cc -c -fgnu89-inline generator/*.c -I.
+cc -fgnu89-inline main.c *.o -I. -o swg -lpthread
+
+rm *.o
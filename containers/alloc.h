@@ -0,0 +1,313 @@
+/*
+    ALLOCATION ACCOUNTING FOR THE CONTAINERS
+    Every allocation the containers make goes through the macros below.
+    Normally they are just malloc, calloc, realloc and free.
+
+    To count allocations by call site use:
+        #define CONTAINER_TRACK_ALLOCS
+    in *every* file that uses the containers, usually by passing
+    -DCONTAINER_TRACK_ALLOCS to the compiler. The container macros then
+    pass __FILE__ and __LINE__ of the code that called them down to the
+    allocator, and a table of the top call sites by bytes allocated is
+    printed when the program exits.
+
+    To create the implementation use:
+        #define ALLOC_IMPL
+    before you include this file in *one* C or C++ file. It's only
+    needed when allocations are tracked.
+
+    Number of call sites in the report can be changed by using:
+        #define ALLOC_REPORT_TOP <value>
+    before creating the implementation. Default is 20.
+*/
+
+#ifndef CONTAINER_ALLOC_H
+#define CONTAINER_ALLOC_H
+
+#include <stdlib.h>
+
+#ifdef CONTAINER_TRACK_ALLOCS
+
+// Added to the argument list of a container function that allocates.
+#define CONTAINER_SITE        , __FILE__, __LINE__
+#define CONTAINER_SITE_PARAMS , const char* file, int line
+#define CONTAINER_SITE_ARGS   , file, line
+
+#define container_malloc(size, file, line)       alloc_track_malloc(size, file, line)
+#define container_calloc(n, size, file, line)    alloc_track_calloc(n, size, file, line)
+#define container_realloc(ptr, size, file, line) alloc_track_realloc(ptr, size, file, line)
+#define container_free(ptr)                      alloc_track_free(ptr)
+
+void* alloc_track_malloc(size_t size, const char* file, int line);
+void* alloc_track_calloc(size_t n, size_t size, const char* file, int line);
+void* alloc_track_realloc(void* ptr, size_t size, const char* file, int line);
+void  alloc_track_free(void* ptr);
+
+// Prints the report. Called at exit once anything is allocated.
+void alloc_track_report();
+
+#else
+
+#define CONTAINER_SITE
+#define CONTAINER_SITE_PARAMS
+#define CONTAINER_SITE_ARGS
+
+#define container_malloc(size, file, line)       malloc(size)
+#define container_calloc(n, size, file, line)    calloc(n, size)
+#define container_realloc(ptr, size, file, line) realloc(ptr, size)
+#define container_free(ptr)                      free(ptr)
+
+#endif // CONTAINER_TRACK_ALLOCS
+
+#endif // CONTAINER_ALLOC_H
+
+#if defined(ALLOC_IMPL) && defined(CONTAINER_TRACK_ALLOCS)
+
+#ifndef ALLOC_IMPLEMENTED
+#define ALLOC_IMPLEMENTED
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifndef ALLOC_REPORT_TOP
+#define ALLOC_REPORT_TOP 20
+#endif // ALLOC_REPORT_TOP
+
+// Call sites past this many are counted together as (other).
+#define ALLOC_MAX_SITES 4096
+
+typedef struct
+{
+    const char* file;
+    int line;
+
+    size_t allocs;
+    size_t reallocs;
+    size_t frees;
+    size_t bytes;
+    size_t live;
+    size_t peak;
+} Alloc_Site;
+
+/*
+    Every tracked block starts with its size and call site so frees
+    know what to take off. The union keeps the block after it as
+    aligned as malloc would have.
+*/
+typedef union
+{
+    struct
+    {
+        size_t size;
+        int site;
+    } info;
+
+    long double align_ld;
+    void* align_ptr;
+} Alloc_Header;
+
+static Alloc_Site alloc_sites[ALLOC_MAX_SITES + 1];
+static int alloc_num_sites;
+static size_t alloc_live;
+static size_t alloc_peak;
+static int alloc_registered;
+
+#ifdef _WIN32
+static SRWLOCK alloc_lock = SRWLOCK_INIT;
+#define alloc_lock_acquire() AcquireSRWLockExclusive(&alloc_lock)
+#define alloc_lock_release() ReleaseSRWLockExclusive(&alloc_lock)
+#else
+static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+#define alloc_lock_acquire() pthread_mutex_lock(&alloc_lock)
+#define alloc_lock_release() pthread_mutex_unlock(&alloc_lock)
+#endif
+
+// Open addressing on the file name and line. Only called with the lock.
+static int alloc_find_site(const char* file, int line)
+{
+    size_t hash = (size_t) line * 2654435761u;
+    for (const char* c = file; *c; c++)
+        hash = (hash ^ (size_t) *c) * 16777619u;
+
+    size_t index = hash % ALLOC_MAX_SITES;
+    for (int i = 0; i < ALLOC_MAX_SITES; i++)
+    {
+        Alloc_Site* site = alloc_sites + index;
+
+        if (!site->file)
+        {
+            if (alloc_num_sites + 1 >= ALLOC_MAX_SITES)
+                break;
+
+            site->file = file;
+            site->line = line;
+            alloc_num_sites++;
+            return (int) index;
+        }
+
+        if (site->line == line && (site->file == file || strcmp(site->file, file) == 0))
+            return (int) index;
+
+        index = (index + 1) % ALLOC_MAX_SITES;
+    }
+
+    alloc_sites[ALLOC_MAX_SITES].file = "(other)";
+    return ALLOC_MAX_SITES;
+}
+
+static void alloc_add_live(Alloc_Site* site, size_t size)
+{
+    site->live += size;
+    if (site->live > site->peak)
+        site->peak = site->live;
+
+    alloc_live += size;
+    if (alloc_live > alloc_peak)
+        alloc_peak = alloc_live;
+}
+
+static void alloc_remove_live(Alloc_Header* header)
+{
+    alloc_sites[header->info.site].live -= header->info.size;
+    alloc_live -= header->info.size;
+}
+
+static void* alloc_track(Alloc_Header* header, size_t size, const char* file, int line, int realloced)
+{
+    alloc_lock_acquire();
+
+    if (!alloc_registered)
+    {
+        atexit(alloc_track_report);
+        alloc_registered = 1;
+    }
+
+    int index = alloc_find_site(file, line);
+    Alloc_Site* site = alloc_sites + index;
+
+    if (realloced)
+        site->reallocs++;
+    else
+        site->allocs++;
+
+    site->bytes += size;
+    alloc_add_live(site, size);
+
+    header->info.size = size;
+    header->info.site = index;
+
+    alloc_lock_release();
+    return header + 1;
+}
+
+void* alloc_track_malloc(size_t size, const char* file, int line)
+{
+    Alloc_Header* header = (Alloc_Header*) malloc(sizeof(Alloc_Header) + size);
+    if (!header)
+        return NULL;
+
+    return alloc_track(header, size, file, line, 0);
+}
+
+void* alloc_track_calloc(size_t n, size_t size, const char* file, int line)
+{
+    Alloc_Header* header = (Alloc_Header*) calloc(1, sizeof(Alloc_Header) + n * size);
+    if (!header)
+        return NULL;
+
+    return alloc_track(header, n * size, file, line, 0);
+}
+
+void* alloc_track_realloc(void* ptr, size_t size, const char* file, int line)
+{
+    if (!ptr)
+        return alloc_track_malloc(size, file, line);
+
+    Alloc_Header* header = (Alloc_Header*) ptr - 1;
+
+    alloc_lock_acquire();
+    alloc_remove_live(header);
+    alloc_lock_release();
+
+    Alloc_Header* moved = (Alloc_Header*) realloc(header, sizeof(Alloc_Header) + size);
+    if (!moved)
+    {
+        // The old block is still there.
+        alloc_lock_acquire();
+        alloc_add_live(alloc_sites + header->info.site, header->info.size);
+        alloc_lock_release();
+        return NULL;
+    }
+
+    return alloc_track(moved, size, file, line, 1);
+}
+
+// Frees are counted against the site that made the block.
+void alloc_track_free(void* ptr)
+{
+    if (!ptr)
+        return;
+
+    Alloc_Header* header = (Alloc_Header*) ptr - 1;
+
+    alloc_lock_acquire();
+    alloc_sites[header->info.site].frees++;
+    alloc_remove_live(header);
+    alloc_lock_release();
+
+    free(header);
+}
+
+static int alloc_compare_sites(const void* a, const void* b)
+{
+    const Alloc_Site* x = *(const Alloc_Site**) a;
+    const Alloc_Site* y = *(const Alloc_Site**) b;
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+void alloc_track_report()
+{
+    static Alloc_Site* sorted[ALLOC_MAX_SITES + 1];
+    size_t allocs = 0, reallocs = 0, frees = 0, bytes = 0;
+
+    alloc_lock_acquire();
+
+    int count = 0;
+    for (int i = 0; i <= ALLOC_MAX_SITES; i++)
+    {
+        Alloc_Site* site = alloc_sites + i;
+        if (!site->file)
+            continue;
+
+        allocs   += site->allocs;
+        reallocs += site->reallocs;
+        frees    += site->frees;
+        bytes    += site->bytes;
+        sorted[count++] = site;
+    }
+
+    qsort(sorted, count, sizeof(Alloc_Site*), alloc_compare_sites);
+
+    printf("Allocations: %zu allocs, %zu reallocs, %zu frees, %.1f KB total, %.1f KB peak, %.1f KB live\n",
+           allocs, reallocs, frees, bytes / 1024.0, alloc_peak / 1024.0, alloc_live / 1024.0);
+    printf("    %10s %10s %10s %12s %12s  %s\n", "allocs", "reallocs", "frees", "total KB", "peak KB", "site");
+
+    for (int i = 0; i < count && i < ALLOC_REPORT_TOP; i++)
+    {
+        Alloc_Site* site = sorted[i];
+        printf("    %10zu %10zu %10zu %12.1f %12.1f  %s:%d\n", site->allocs, site->reallocs, site->frees,
+               site->bytes / 1024.0, site->peak / 1024.0, site->file, site->line);
+    }
+
+    alloc_lock_release();
+}
+
+#endif // ALLOC_IMPLEMENTED
+
+#endif // ALLOC_IMPL && CONTAINER_TRACK_ALLOCS
@@ -20,6 +20,8 @@
         #define CONTAINER_NO_ASSERT
     before creating the implemenation.
 
+    Allocations can be counted by call site, see alloc.h.
+
     Example:
         #define DARRAY_IMPL
         #define DARRAY_START_CAP 5
@@ -32,6 +34,8 @@
 #ifndef DARRAY_H
 #define DARRAY_H
 
+#include "alloc.h"
+
 #ifndef DARRAY_GROWTH_RATE
 #define DARRAY_GROWTH_RATE 1.5
 #endif // DARRAY_GROWTH_RATE
@@ -43,13 +47,14 @@
 #define DArray(type) type*
 #define DA_Itr(type) type*
 
-#define da_make(arr)                 da_make_impl((void**)&arr, DARRAY_START_CAP, sizeof(*arr))
-#define da_copy(dest, src)           da_copy_impl((void**)&dest, (void*)src, sizeof(*src))
+#define da_make(arr)                 da_make_impl((void**)&arr, DARRAY_START_CAP, sizeof(*arr) CONTAINER_SITE)
+#define da_copy(dest, src)           da_copy_impl((void**)&dest, (void*)src, sizeof(*src) CONTAINER_SITE)
 #define da_move(dest, src)           da_move_impl((void**)&dest, (void**)&src, sizeof(*src))
 #define da_free(arr)                 da_free_impl((void**)&arr)
 
-#define da_make_with_cap(arr, cap)   da_make_impl((void**)&arr, cap, sizeof(*arr))
-#define da_resize(arr, cap)          da_resize_impl((void**)&arr, cap, sizeof(*arr))
+#define da_make_with_cap(arr, cap)   da_make_impl((void**)&arr, cap, sizeof(*arr) CONTAINER_SITE)
+#define da_resize(arr, cap)          da_resize_impl((void**)&arr, cap, sizeof(*arr) CONTAINER_SITE)
+#define da_reserve(arr, cap)         da_reserve_impl((void**)&arr, cap, sizeof(*arr) CONTAINER_SITE)
 
 #define da_begin(arr)                da_get_itr_impl((void*)arr, 0, sizeof(*arr))
 #define da_end(arr)                  da_get_itr_impl((void*)arr, da_size(arr), sizeof(*arr))
@@ -62,15 +67,17 @@
 #define da_insert(arr, index, value) da_insert_impl(arr, index, value)
 #define da_erase_at(arr, index)      da_erase_at_impl(arr, index)
 #define da_erase_swap(arr, index)    da_erase_swap_impl(arr, index)
+#define da_clear(arr)                da_clear_impl(arr)
 
 #define da_foreach(type, it, arr)    for (DA_Itr(type) it = (DA_Itr(type))da_begin(arr); it != (DA_Itr(type))da_end(arr); it++)
 
-void da_make_impl(void** arr, size_t cap, size_t type_size);
-void da_copy_impl(void** dest, void* src, size_t type_size);
+void da_make_impl(void** arr, size_t cap, size_t type_size CONTAINER_SITE_PARAMS);
+void da_copy_impl(void** dest, void* src, size_t type_size CONTAINER_SITE_PARAMS);
 void da_move_impl(void** dest, void** src, size_t type_size);
 void da_free_impl(void** arr);
 
-void da_resize_impl(void** arr, size_t new_cap, size_t type_size);
+void da_resize_impl(void** arr, size_t new_cap, size_t type_size CONTAINER_SITE_PARAMS);
+void da_reserve_impl(void** arr, size_t cap, size_t type_size CONTAINER_SITE_PARAMS);
 
 DA_Itr(void) da_get_itr_impl(void* arr, size_t index, size_t type_size);
 
@@ -147,6 +154,12 @@ typedef struct
         da->size--;                             \
     } while(0)
 
+#define da_clear_impl(arr) \
+    do {                                    \
+        hd_assert(arr != NULL);             \
+        da_data(arr)->size = 0;             \
+    } while(0)
+
 #endif // DARRAY_H
 
 #ifdef DARRAY_IMPL
@@ -166,10 +179,10 @@ typedef struct
 #include <string.h>
 #include "hd_assert.h"
 
-void da_make_impl(void** arr, size_t cap, size_t type_size)
+void da_make_impl(void** arr, size_t cap, size_t type_size CONTAINER_SITE_PARAMS)
 {
     size_t byte_size = cap * type_size + sizeof(DA_Internal);
-    DA_Internal* da = (DA_Internal*) malloc(byte_size);
+    DA_Internal* da = (DA_Internal*) container_malloc(byte_size, file, line);
     hd_assert(da != NULL);
 
     da->cap  = cap;
@@ -178,15 +191,15 @@ void da_make_impl(void** arr, size_t cap, size_t type_size)
     *arr = da->buffer;
 }
 
-void da_copy_impl(void** dest, void* src, size_t type_size)
+void da_copy_impl(void** dest, void* src, size_t type_size CONTAINER_SITE_PARAMS)
 {
     hd_assert(src != NULL);
     DA_Internal* src_da = da_data(src);
     size_t byte_size = src_da->cap * type_size + sizeof(DA_Internal);
     
     DA_Internal* dest_da;
-    if (*dest) dest_da = (DA_Internal*) realloc(da_data(*dest), byte_size);
-    else       dest_da = (DA_Internal*) malloc(byte_size);
+    if (*dest) dest_da = (DA_Internal*) container_realloc(da_data(*dest), byte_size, file, line);
+    else       dest_da = (DA_Internal*) container_malloc(byte_size, file, line);
 
     hd_assert(dest_da != NULL);
     
@@ -209,12 +222,12 @@ void da_free_impl(void** arr)
 {
     hd_assert(*arr != NULL);
     DA_Internal* da = da_data(*arr);
-    free(da);
+    container_free(da);
     *arr = NULL;
 }
 
 
-void da_resize_impl(void** arr, size_t new_cap, size_t type_size)
+void da_resize_impl(void** arr, size_t new_cap, size_t type_size CONTAINER_SITE_PARAMS)
 {
     DA_Internal* da = NULL;
     size_t size = 0;
@@ -226,7 +239,7 @@ void da_resize_impl(void** arr, size_t new_cap, size_t type_size)
     }
 
     size_t byte_size = new_cap * type_size + sizeof(DA_Internal);
-    DA_Internal* new_da = (DA_Internal*) realloc(da, byte_size);
+    DA_Internal* new_da = (DA_Internal*) container_realloc(da, byte_size, file, line);
     
     new_da->size = size;
     new_da->cap  = new_cap;
@@ -234,6 +247,14 @@ void da_resize_impl(void** arr, size_t new_cap, size_t type_size)
     *arr = new_da->buffer;
 }
 
+// Grows the array to hold at least cap values so pushing that
+// many doesn't have to grow it a bit at a time. Never shrinks it.
+void da_reserve_impl(void** arr, size_t cap, size_t type_size CONTAINER_SITE_PARAMS)
+{
+    if (da_cap_impl(*arr) < cap)
+        da_resize_impl(arr, cap, type_size CONTAINER_SITE_ARGS);
+}
+
 DA_Itr(void) da_get_itr_impl(void* arr, size_t index, size_t type_size)
 {
     hd_assert(arr != NULL);
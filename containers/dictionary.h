@@ -4,6 +4,7 @@
 #include <stdlib.h>
 
 #include "hd_assert.h"
+#include "alloc.h"
 #include "string.h"
 
 #ifndef DICT_GROWTH_RATE
@@ -60,7 +61,9 @@ typedef struct
     {                                                                 \
         dict.cap = DICT_START_CAP;                                    \
         dict.filled = 0;                                              \
-        dict.buckets = calloc(DICT_START_CAP, sizeof(*dict.buckets)); \
+        dict.buckets = container_calloc(DICT_START_CAP,               \
+                                        sizeof(*dict.buckets),        \
+                                        __FILE__, __LINE__);          \
         hd_assert(dict.buckets != NULL);                              \
     } while (0)
     
@@ -68,7 +71,8 @@ typedef struct
     do                                                                                              \
     {                                                                                               \
         size_t new_cap = _cap;                                                                      \
-        Dict_Bucket_Internal* new_bkts = calloc(new_cap, sizeof(*dict.buckets));                    \
+        Dict_Bucket_Internal* new_bkts = container_calloc(new_cap, sizeof(*dict.buckets),           \
+                                                          __FILE__, __LINE__);                      \
         hd_assert(new_bkts != NULL);                                                                \
                                                                                                     \
         for (int i = 0; i < dict.cap; i++)                                                          \
@@ -95,7 +99,7 @@ typedef struct
         }                                                                                           \
                                                                                                     \
         dict.cap = new_cap;                                                                         \
-        free(dict.buckets);                                                                         \
+        container_free(dict.buckets);                                                               \
         dict.buckets = (void*) new_bkts;                                                            \
     } while (0)
 
@@ -103,7 +107,7 @@ typedef struct
     do {                                                          \
         if (dict.buckets == NULL)                                 \
             dict_make(dict);                                      \
-        else if (((dict.filled + 1) / dict.cap) >= DICT_MAX_LOAD) \
+        else if (dict.filled + 1 >= dict.cap * DICT_MAX_LOAD)     \
             dict_resize(dict, dict.cap * DICT_GROWTH_RATE);       \
                                                                   \
         size_t index = dict_string_hasher(_key) % dict.cap;       \
@@ -125,7 +129,7 @@ typedef struct
                 break;                                            \
             }                                                     \
                                                                   \
-            index++;                                              \
+            index = (index + 1) % dict.cap;                       \
         } while (index != start);                                 \
                                                                   \
     } while (0)
@@ -140,11 +144,11 @@ typedef struct
     } while (0)
 
 #define dict_free(dict) \
-    do                                        \
-    {                                         \
-        if (dict.buckets) free(dict.buckets); \
-        dict.cap = dict.filled = 0;           \
-        dict.buckets = NULL;                  \
+    do                                                  \
+    {                                                   \
+        if (dict.buckets) container_free(dict.buckets); \
+        dict.cap = dict.filled = 0;                     \
+        dict.buckets = NULL;                            \
     } while (0)
 
 #define dict_find(dict, _key) ((dict.buckets) ? (dict_find_bucket(dict.buckets, dict.cap, sizeof(*dict.buckets), _key)).ptr : NULL)
@@ -157,11 +161,18 @@ typedef struct
 #define dict_cap(dict)    (dict.cap)
 #define dict_filled(dict) (dict.filled)
 
-#define dict_next_bucket(bkt, dict) dict_next_bucket_impl(&bkt, dict_end(dict), sizeof(*dict.buckets))
+#define dict_next_bucket(bkt, dict) dict_next_bucket_impl((void**) &(bkt), dict_end(dict), sizeof(*dict.buckets))
 
+// GCC doesn't allow declaring a struct in the for loop initializer.
+#ifdef __GNUC__
+#define dict_foreach(type, it, dict) for (__typeof__(dict.buckets) it = dict_begin(dict); \
+                                          it != dict_end(dict);                          \
+                                          dict_next_bucket(it, dict))
+#else
 #define dict_foreach(type, it, dict) for (Dict_Bkt(type) it = dict_begin(dict); \
                                           it != dict_end(dict);                \
                                           dict_next_bucket(it, dict))
+#endif
 
 size_t dict_string_hasher(String key);
 Dict_Itr dict_find_bucket(void* buckets, size_t cap, size_t bkt_size, String key);
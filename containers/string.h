@@ -1,25 +1,42 @@
 #ifndef CONTAINER_STRING_H
 #define CONTAINER_STRING_H
 
+#include <stddef.h>
+#include "alloc.h"
+
 typedef char* String;
 
-String string_make(char* cstr);
-void   string_copy(String* dest, String src);
+String string_make(char* cstr CONTAINER_SITE_PARAMS);
+void   string_copy(String* dest, String src CONTAINER_SITE_PARAMS);
 void   string_free(String* str);
 
-String string_make_till_char(char* cstr, char delim);
-String string_make_till_n(char* cstr, size_t n);
-void   string_replace(String* str, char* cstr);
+String string_make_till_char(char* cstr, char delim CONTAINER_SITE_PARAMS);
+String string_make_till_n(char* cstr, size_t n CONTAINER_SITE_PARAMS);
+void   string_replace(String* str, char* cstr CONTAINER_SITE_PARAMS);
 
-String string_get_line(String contents, size_t* index);
-void   string_resize(String* str, size_t new_len);
+String string_get_line(String contents, size_t* index CONTAINER_SITE_PARAMS);
+void   string_resize(String* str, size_t new_len CONTAINER_SITE_PARAMS);
 
 inline size_t string_length(String str);
 inline int    string_cmp(String s1, String s2);
 
-void string_append(String* dest, char* other);
+void string_append(String* dest, char* other CONTAINER_SITE_PARAMS);
 void string_to_lower(String* str);
 
+// The functions that allocate get the caller's file and line when
+// allocations are tracked (see alloc.h). The definitions below put
+// their names in parentheses so these don't apply to them.
+#ifdef CONTAINER_TRACK_ALLOCS
+#define string_make(cstr)                   string_make(cstr CONTAINER_SITE)
+#define string_copy(dest, src)              string_copy(dest, src CONTAINER_SITE)
+#define string_make_till_char(cstr, delim)  string_make_till_char(cstr, delim CONTAINER_SITE)
+#define string_make_till_n(cstr, n)         string_make_till_n(cstr, n CONTAINER_SITE)
+#define string_replace(str, cstr)           string_replace(str, cstr CONTAINER_SITE)
+#define string_get_line(contents, index)    string_get_line(contents, index CONTAINER_SITE)
+#define string_resize(str, new_len)         string_resize(str, new_len CONTAINER_SITE)
+#define string_append(dest, other)          string_append(dest, other CONTAINER_SITE)
+#endif // CONTAINER_TRACK_ALLOCS
+
 #endif // CONTAINER_STRING_H
 
 #ifdef STRING_IMPL
@@ -40,10 +57,10 @@ typedef struct
 
 #define string_data(str) ((String_Internal*)(str) - 1)
 
-String string_make(char* cstr)
+String (string_make)(char* cstr CONTAINER_SITE_PARAMS)
 {
     size_t len = strlen(cstr) + 1;
-    String_Internal* s = (String_Internal*) malloc(len * sizeof(char) + sizeof(String_Internal));
+    String_Internal* s = (String_Internal*) container_malloc(len * sizeof(char) + sizeof(String_Internal), file, line);
     hd_assert(s != NULL);
     
     s->length = len;
@@ -51,15 +68,15 @@ String string_make(char* cstr)
     return s->buffer;
 }
 
-void string_copy(String* dest, String src)
+void (string_copy)(String* dest, String src CONTAINER_SITE_PARAMS)
 {
     hd_assert(src != NULL);
     String_Internal* src_str = string_data(src);
     size_t byte_size = (src_str->length + 1) * sizeof(char) + sizeof(String_Internal);
     
     String_Internal* dest_str;
-    if (*dest) dest_str = (String_Internal*) realloc(string_data(*dest), byte_size);
-    else       dest_str = (String_Internal*) malloc(byte_size);
+    if (*dest) dest_str = (String_Internal*) container_realloc(string_data(*dest), byte_size, file, line);
+    else       dest_str = (String_Internal*) container_malloc(byte_size, file, line);
 
     hd_assert(dest_str != NULL);
     dest_str->length = src_str->length;
@@ -72,20 +89,20 @@ void string_free(String* str)
 {
     hd_assert(*str != NULL);
     String_Internal* s = string_data(*str);
-    free(s);
+    container_free(s);
     *str = NULL;
 }
 
-String string_make_till_char(char* cstr, char delim)
+String (string_make_till_char)(char* cstr, char delim CONTAINER_SITE_PARAMS)
 {
     char* end = strchr(cstr, delim);
 
     if (!end)
-        return string_make(cstr);
+        return (string_make)(cstr CONTAINER_SITE_ARGS);
 
     size_t len = end - cstr;
     size_t byte_size = len * sizeof(char) + sizeof(String_Internal);
-    String_Internal* s = (String_Internal*) malloc(byte_size);
+    String_Internal* s = (String_Internal*) container_malloc(byte_size, file, line);
     hd_assert(s != NULL);
 
     s->length = len;
@@ -94,12 +111,13 @@ String string_make_till_char(char* cstr, char delim)
     return s->buffer;
 }
 
-String string_make_till_n(char* cstr, size_t n)
+String (string_make_till_n)(char* cstr, size_t n CONTAINER_SITE_PARAMS)
 {
-    hd_assert(n < strlen(cstr) + 1);
+    // Only looks as far as n, cstr is often the rest of a whole file.
+    hd_assert(memchr(cstr, '\0', n) == NULL);
 
     size_t byte_size = (n + 1) * sizeof(char) + sizeof(String_Internal);
-    String_Internal* s = (String_Internal*) malloc(byte_size);
+    String_Internal* s = (String_Internal*) container_malloc(byte_size, file, line);
     hd_assert(s != NULL);
 
     s->length = n + 1;
@@ -108,7 +126,7 @@ String string_make_till_n(char* cstr, size_t n)
     return s->buffer;
 }
 
-String string_get_line(String contents, size_t* index)
+String (string_get_line)(String contents, size_t* index CONTAINER_SITE_PARAMS)
 {
     if (!contents)
         return NULL;
@@ -132,15 +150,15 @@ String string_get_line(String contents, size_t* index)
     temp[cpy_idx] = '\n';
     temp[cpy_idx + 1] = '\0';
 
-    return string_make(temp);
+    return (string_make)(temp CONTAINER_SITE_ARGS);
 }
 
-void string_replace(String* str, char* cstr)
+void (string_replace)(String* str, char* cstr CONTAINER_SITE_PARAMS)
 {
     hd_assert(*str);
     size_t length = strlen(cstr);
     size_t byte_size = (length + 1) * sizeof(char) + sizeof(String_Internal);
-    String_Internal* s = (String_Internal*) realloc(string_data(*str), byte_size);
+    String_Internal* s = (String_Internal*) container_realloc(string_data(*str), byte_size, file, line);
 
     s->length = length;
     strcpy(s->buffer, cstr);
@@ -148,13 +166,13 @@ void string_replace(String* str, char* cstr)
 }
 
 // Dangerous...
-void string_resize(String* str, size_t new_len)
+void (string_resize)(String* str, size_t new_len CONTAINER_SITE_PARAMS)
 {
     size_t byte_size = (new_len + 1) * sizeof(char) + sizeof(String_Internal);
 
     String_Internal* s;
-    if (*str) s = (String_Internal*) realloc(string_data(*str), byte_size);
-    else      s = (String_Internal*) malloc(byte_size);
+    if (*str) s = (String_Internal*) container_realloc(string_data(*str), byte_size, file, line);
+    else      s = (String_Internal*) container_malloc(byte_size, file, line);
 
     hd_assert(s != NULL);
     s->length = new_len;
@@ -177,16 +195,16 @@ inline int string_cmp(String s1, String s2)
     return 0;    
 }
 
-void string_append(String* dest, char* other)
+void (string_append)(String* dest, char* other CONTAINER_SITE_PARAMS)
 {
     if (*dest == NULL)
     {
-        *dest = string_make(other);
+        *dest = (string_make)(other CONTAINER_SITE_ARGS);
     }
     else
     {
         size_t prev_len = string_length(*dest);
-        string_resize(dest, prev_len + strlen(other) + 1);
+        (string_resize)(dest, prev_len + strlen(other) + 1 CONTAINER_SITE_ARGS);
         String_Internal* s = string_data(*dest);
         strcat(*dest, other);
     }
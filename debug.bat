@@ -1,4 +1,4 @@
 @echo off
 
 cl /Zi /c generator/*.c /I ..\swg
-cl /Zi main.c *.obj /Fe:swg
\ No newline at end of file
+cl /Zi main.c *.obj /Fe:swg psapi.lib
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "assets.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "jobs.h"
+#include "hash.h"
+#include "filestuff.h"
+#include "containers/hd_assert.h"
+
+Asset_Map asset_map_make()
+{
+    Asset_Map map = { 0 };
+    da_make(map.assets);
+    return map;
+}
+
+void asset_map_free(Asset_Map* map)
+{
+    da_foreach(Asset, asset, map->assets)
+    {
+        string_free(&asset->path);
+
+        if (asset->fingerprinted)
+            string_free(&asset->fingerprinted);
+    }
+    da_free(map->assets);
+
+    dict_foreach(int, bkt, map->index)
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free(map->index);
+
+    map->rewrite_html = 0;
+}
+
+// Only relative paths to files with an extension can be assets.
+// Pages aren't since their names have to stay the same and paths
+// leaving the current directory would end up outside the output.
+static int could_be_asset(char* path, size_t length)
+{
+    if (length == 0 || length >= ASSET_PATH_SIZE)
+        return 0;
+
+    if (path[0] == '/' || path[0] == '\\')
+        return 0;
+
+    int has_extension = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = path[i];
+
+        // URLs, mailto: links, queries, fragments and anything
+        // that's obviously not a file name.
+        if (c == ':' || c == '?' || c == '#' || c == '<' || c == '>' ||
+            c == '=' || c == '\n' || c == '\r')
+            return 0;
+
+        if (c == '.' && i + 1 < length && path[i + 1] == '.')
+            return 0;
+
+        if (c == '/' || c == '\\')
+            has_extension = 0;
+        else if (c == '.')
+            has_extension = 1;
+    }
+
+    if (!has_extension)
+        return 0;
+
+    char* extension = path + length;
+    while (extension[-1] != '.')
+        extension--;
+
+    size_t extension_length = path + length - extension;
+    return !(extension_length == 4 && !strncmp(extension, "html", 4)) &&
+           !(extension_length == 3 && !strncmp(extension, "htm", 3));
+}
+
+Asset* assets_find(Asset_Map* map, char* path, size_t length)
+{
+    if (length == 0 || length >= ASSET_PATH_SIZE || !map->index.buckets)
+        return NULL;
+
+    char key[ASSET_PATH_SIZE];
+    memcpy(key, path, length);
+    key[length] = '\0';
+
+    Dict_Bkt(int) bkt = dict_find(map->index, key);
+    if (bkt == dict_end(map->index))
+        return NULL;
+
+    return map->assets + bkt->value;
+}
+
+void assets_add(Asset_Map* map, char* path, size_t length, int in_html)
+{
+    if (!could_be_asset(path, length))
+        return;
+
+    if (in_html)
+        map->rewrite_html = 1;
+
+    if (assets_find(map, path, length))
+        return;
+
+    Asset asset = { 0 };
+    asset.path = string_make_till_n(path, length);
+
+    int asset_index = da_size(map->assets);
+    da_push_back(map->assets, asset);
+    dict_put(map->index, asset.path, asset_index);
+}
+
+static void add_string(Asset_Map* map, String str)
+{
+    if (str)
+        assets_add(map, str, strlen(str), 0);
+}
+
+void assets_add_portfolio(Asset_Map* map, Portfolio portfolio)
+{
+    da_foreach(Persona, persona, portfolio.personas)
+    {
+        add_string(map, persona->image);
+        add_string(map, persona->icon);
+
+        da_foreach(Project, project, persona->projects)
+            da_foreach(String, image, project->images)
+                add_string(map, *image);
+    }
+
+    da_foreach(Link, link, portfolio.links)
+        add_string(map, link->icon);
+}
+
+int html_next_value(char* html, size_t length, size_t* pos, size_t* start, size_t* value_length)
+{
+    for (size_t i = *pos; i + 1 < length; i++)
+    {
+        if (html[i] != '=' || (html[i + 1] != '"' && html[i + 1] != '\''))
+            continue;
+
+        char quote = html[i + 1];
+        char* end = memchr(html + i + 2, quote, length - i - 2);
+
+        // Values that carry on into a property can't be assets.
+        if (!end)
+            return 0;
+
+        *start = i + 2;
+        *value_length = end - (html + i + 2);
+        *pos = end - html + 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+void assets_add_html(Asset_Map* map, String html)
+{
+    size_t length = strlen(html);
+    size_t pos = 0, start, value_length;
+
+    while (html_next_value(html, length, &pos, &start, &value_length))
+        assets_add(map, html + start, value_length, 1);
+}
+
+// res/hero.png becomes res/hero.<hash>.png
+static String fingerprint_path(String path, uint64_t hash)
+{
+    char* name = path;
+    for (char* c = path; *c; c++)
+        if (*c == '/' || *c == '\\')
+            name = c + 1;
+
+    char* extension = strrchr(name, '.');
+    size_t stem_length = extension - path;
+
+    char digits[17];
+    sprintf(digits, "%016llx", (unsigned long long) hash);
+
+    char fingerprinted[ASSET_PATH_SIZE + ASSET_HASH_DIGITS + 2];
+    sprintf(fingerprinted, "%.*s.%.*s%s", (int) stem_length, path,
+            ASSET_HASH_DIGITS, digits, extension);
+
+    return string_make(fingerprinted);
+}
+
+typedef struct
+{
+    Asset_Map* map;
+    String outdir;
+} Copy_Context;
+
+// Files are copied next to where they end up and then moved into
+// place, so a name that exists always has the whole file behind it
+// and doesn't need to be copied again.
+static void copy_asset_job(void* data, int worker, int job)
+{
+    Copy_Context* ctx = (Copy_Context*) data;
+    Asset* asset = ctx->map->assets + job;
+
+    if (!hash_file(asset->path, &asset->hash))
+    {
+        asset->status = ASSET_MISSING;
+        return;
+    }
+
+    asset->fingerprinted = fingerprint_path(asset->path, asset->hash);
+
+    char filepath[1024], temp_filepath[1024 + 8];
+    snprintf(filepath, sizeof(filepath), "%s/%s", ctx->outdir, asset->fingerprinted);
+
+    if (file_exists(filepath))
+    {
+        asset->status = ASSET_UNCHANGED;
+        return;
+    }
+
+    sprintf(temp_filepath, "%s.tmp", filepath);
+
+    int res = make_dirs(filepath) &&
+              copy_file(asset->path, temp_filepath) &&
+              replace_file(temp_filepath, filepath);
+
+    if (!res)
+        remove_file(temp_filepath);
+
+    asset->status = (res) ? ASSET_COPIED : ASSET_COPY_FAILED;
+}
+
+int assets_copy(Asset_Map* map, String outdir, int worker_count)
+{
+    int num_assets = da_size(map->assets);
+    Copy_Context ctx = { map, outdir };
+
+    if (worker_count > num_assets)
+        worker_count = num_assets;
+
+    if (num_assets > 0)
+        jobs_run(worker_count, num_assets, copy_asset_job, &ctx);
+
+    // Reported in order so the output doesn't depend on the workers.
+    int res = 1;
+    da_foreach(Asset, asset, map->assets)
+    {
+        if (asset->status == ASSET_COPIED)
+        {
+            printf("%s/%s\n", outdir, asset->fingerprinted);
+        }
+        else if (asset->status == ASSET_COPY_FAILED)
+        {
+            printf("Error: Couldn't copy %s to %s/%s\n", asset->path, outdir, asset->fingerprinted);
+            res = 0;
+        }
+    }
+
+    return res;
+}
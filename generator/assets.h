@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "portfolio.h"
+#include "containers/string.h"
+#include "containers/darray.h"
+#include "containers/dictionary.h"
+
+// Hex digits of the content hash that go into asset names.
+#define ASSET_HASH_DIGITS 8
+
+// Longest path that can be an asset.
+#define ASSET_PATH_SIZE 512
+
+typedef enum
+{
+    ASSET_PENDING,
+    ASSET_MISSING,
+    ASSET_COPIED,
+    ASSET_UNCHANGED,
+    ASSET_COPY_FAILED
+} Asset_Status;
+
+typedef struct
+{
+    // As it's referenced, like res/hero.png, and the name it gets
+    // in the output directory, like res/hero.3f2a9c1b.png.
+    String path;
+    String fingerprinted;
+    uint64_t hash;
+    Asset_Status status;
+} Asset;
+
+/*
+    Local files referenced by the portfolio (images and icons) and by
+    attribute values in the templates. They're copied into the output
+    directory under names that include a hash of their contents so
+    they can be cached forever, and pages are rendered with the new
+    names. Paths that don't exist are left alone.
+*/
+typedef struct
+{
+    DArray(Asset) assets;
+    Dict(int) index;
+
+    // Set when template html has to be searched for asset paths.
+    int rewrite_html;
+} Asset_Map;
+
+Asset_Map asset_map_make();
+void asset_map_free(Asset_Map* map);
+
+void assets_add(Asset_Map* map, char* path, size_t length, int in_html);
+void assets_add_portfolio(Asset_Map* map, Portfolio portfolio);
+void assets_add_html(Asset_Map* map, String html);
+
+// Hashes and copies everything on worker_count threads.
+// Returns 0 if anything couldn't be copied.
+int assets_copy(Asset_Map* map, String outdir, int worker_count);
+
+Asset* assets_find(Asset_Map* map, char* path, size_t length);
+
+// Finds the next quoted attribute value at or after *pos and
+// moves *pos past it. Returns 0 once there aren't any left.
+int html_next_value(char* html, size_t length, size_t* pos, size_t* start, size_t* value_length);
@@ -0,0 +1,1301 @@
+#include "build.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "jobs.h"
+#include "hash.h"
+#include "trace.h"
+#include "containers/hd_assert.h"
+
+#define WRITE_QUEUE_CAP 64
+
+// Most jobs the writer thread takes off the queue at once.
+#define WRITE_BATCH 32
+
+#define VARIANT_PATH_SIZE (sizeof(((Page_Result*) 0)->filename) + 8)
+
+typedef Compressed (*Compress_Proc)(char* data, size_t length, int level);
+
+typedef struct
+{
+    char* suffix;
+    Compress_Proc compress;
+} Encoding;
+
+static const Encoding encodings[] =
+{
+    { ".gz", gzip_compress },
+#ifdef SWG_BROTLI
+    { ".br", brotli_compress },
+#endif
+};
+
+#define NUM_ENCODINGS (int) (sizeof(encodings) / sizeof(encodings[0]))
+
+static void write_queue_make(Write_Queue* queue)
+{
+    mutex_make(&queue->lock);
+    cond_make(&queue->not_empty);
+    cond_make(&queue->not_full);
+
+    queue->cap   = WRITE_QUEUE_CAP;
+    queue->jobs  = (Write_Job*) malloc(queue->cap * sizeof(Write_Job));
+    queue->head  = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    queue->writer = file_writer_make(WRITER_THREADS);
+    hd_assert(queue->jobs != NULL);
+}
+
+static void write_queue_free(Write_Queue* queue)
+{
+    mutex_free(&queue->lock);
+    cond_free(&queue->not_empty);
+    cond_free(&queue->not_full);
+    free(queue->jobs);
+    queue->jobs = NULL;
+    file_writer_free(&queue->writer);
+}
+
+// Blocks while the queue is full so rendering can't
+// get too far ahead of the disk.
+static void write_queue_push(Write_Queue* queue, Write_Job job)
+{
+    mutex_lock(&queue->lock);
+
+    while (queue->count == queue->cap)
+        cond_wait(&queue->not_full, &queue->lock);
+
+    queue->jobs[(queue->head + queue->count) % queue->cap] = job;
+    queue->count++;
+    trace_counter("write queue", queue->count);
+
+    cond_signal(&queue->not_empty);
+    mutex_unlock(&queue->lock);
+}
+
+// Waits for at least one job and takes up to max of them.
+// Returns 0 once the queue is closed and empty.
+static int write_queue_pop_batch(Write_Queue* queue, Write_Job* jobs, int max)
+{
+    mutex_lock(&queue->lock);
+
+    while (queue->count == 0 && !queue->closed)
+        cond_wait(&queue->not_empty, &queue->lock);
+
+    int count = 0;
+    while (queue->count > 0 && count < max)
+    {
+        jobs[count++] = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % queue->cap;
+        queue->count--;
+    }
+
+    trace_counter("write queue", queue->count);
+
+    if (count > 0)
+        cond_broadcast(&queue->not_full);
+
+    mutex_unlock(&queue->lock);
+    return count;
+}
+
+static void write_queue_close(Write_Queue* queue)
+{
+    mutex_lock(&queue->lock);
+    queue->closed = 1;
+    cond_broadcast(&queue->not_empty);
+    mutex_unlock(&queue->lock);
+}
+
+static void set_write_error(Page_Result* result, char* path, int error)
+{
+    if (result->message)
+        return;
+
+    char message[VARIANT_PATH_SIZE + 128];
+    sprintf(message, "Error: Couldn't write %s (%s)", path, strerror(error));
+    result->message = string_make(message);
+}
+
+// Writes pages and their compressed copies as one batch, then frees
+// everything the jobs held on to. Writer can be NULL to write on the
+// calling thread.
+static void write_jobs(File_Writer* writer, Write_Job* jobs, int count, Build_Stats* stats)
+{
+    hd_assert(count <= WRITE_BATCH);
+
+    Output_File files[WRITE_BATCH * (1 + MAX_ENCODINGS)];
+    Segment variants[WRITE_BATCH * MAX_ENCODINGS];
+    char paths[WRITE_BATCH * MAX_ENCODINGS][VARIANT_PATH_SIZE];
+    int owners[WRITE_BATCH * (1 + MAX_ENCODINGS)];
+    int num_files = 0, num_variants = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        Write_Job* job = jobs + i;
+
+        if (job->segments)
+        {
+            Output_File file = { job->result->filename, job->segments, da_size(job->segments), 0 };
+            owners[num_files] = i;
+            files[num_files++] = file;
+        }
+
+        for (int j = 0; j < NUM_ENCODINGS; j++)
+        {
+            if (!job->variants[j].data)
+                continue;
+
+            char* path = paths[num_variants];
+            sprintf(path, "%s%s", job->result->filename, encodings[j].suffix);
+
+            Segment* seg = variants + num_variants++;
+            seg->data   = job->variants[j].data;
+            seg->length = job->variants[j].length;
+
+            Output_File file = { path, seg, 1, 0 };
+            owners[num_files] = i;
+            files[num_files++] = file;
+        }
+    }
+
+    Stat_Span span = stats_begin(stats, STAT_WRITE);
+    file_writer_write(writer, files, num_files);
+    stats_end(stats, span);
+
+    for (int i = 0; i < count; i++)
+        jobs[i].result->status = WP_SUCCESS;
+
+    for (int i = 0; i < num_files; i++)
+    {
+        if (!files[i].error)
+            continue;
+
+        Page_Result* result = jobs[owners[i]].result;
+        result->status = WP_WRITE_ERROR;
+        set_write_error(result, files[i].path, files[i].error);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (jobs[i].segments)
+            da_free(jobs[i].segments);
+
+        for (int j = 0; j < NUM_ENCODINGS; j++)
+            if (jobs[i].variants[j].data)
+                compressed_free(jobs[i].variants + j);
+    }
+}
+
+static void writer_proc(void* data)
+{
+    Write_Queue* queue = (Write_Queue*) data;
+    trace_name_thread("writer");
+
+    Write_Job jobs[WRITE_BATCH];
+    int count;
+
+    while ((count = write_queue_pop_batch(queue, jobs, WRITE_BATCH)) > 0)
+        write_jobs(&queue->writer, jobs, count, queue->stats);
+}
+
+Build_Cache build_cache_make()
+{
+    Build_Cache cache = { 0 };
+    return cache;
+}
+
+static void cached_template_free(Cached_Template* cached)
+{
+    if (cached->path)
+        string_free(&cached->path);
+
+    if (cached->tp.stages)
+        template_parser_free(&cached->tp);
+}
+
+void build_cache_free(Build_Cache* cache)
+{
+    cached_template_free(&cache->home);
+    cached_template_free(&cache->page);
+    cached_template_free(&cache->project);
+    cached_template_free(&cache->skill);
+
+    if (cache->outdir)
+        string_free(&cache->outdir);
+
+    if (cache->has_manifest)
+        manifest_free(&cache->manifest);
+
+    cache->has_manifest = 0;
+}
+
+// Loads and parses a template. The parser owns the template's
+// contents and stages afterwards, and the cache owns the parser
+// if there is one. Templates that haven't changed since they were
+// cached don't get parsed again.
+static Webpage_Status load_template(String filepath, Template_Parser* tp, Cached_Template* cached,
+                                    Build_Stats* stats)
+{
+    Stat_Span span = stats_begin(stats, STAT_LOAD);
+    String content = load_file(filepath);
+    stats_end(stats, span);
+
+    if (!content)
+        return WP_MISSING_TEMPLATE;
+
+    uint64_t hash = 0;
+    if (cached)
+    {
+        hash = hash_bytes(content, strlen(content), 0);
+
+        if (cached->tp.stages && cached->hash == hash && string_cmp(cached->path, filepath))
+        {
+            string_free(&content);
+            *tp = cached->tp;
+            return WP_SUCCESS;
+        }
+    }
+
+    span = stats_begin(stats, STAT_TEMPLATES);
+    *tp = template_parser_make(content);
+    template_parser_parse(tp);
+    stats_end(stats, span);
+
+    if (tp->status == TP_FAILURE)
+    {
+        printf("%s\n", tp->message);
+        return WP_TEMPLATE_ERROR;
+    }
+
+    if (cached)
+    {
+        cached_template_free(cached);
+        cached->path = string_make(filepath);
+        cached->hash = hash;
+        cached->tp   = *tp;
+    }
+
+    return WP_SUCCESS;
+}
+
+static void load_templates_proc(void* data)
+{
+    Site_Build* build = (Site_Build*) data;
+    Build_Cache* cache = build->cache;
+    Build_Stats* stats = build->options.stats;
+    trace_name_thread("templates");
+
+    build->template_status = load_template(build->home_path, &build->home_tp, (cache) ? &cache->home : NULL, stats);
+    if (build->template_status == WP_SUCCESS)
+        build->template_status = load_template(build->page_path, &build->page_tp, (cache) ? &cache->page : NULL, stats);
+
+    if (build->template_status == WP_SUCCESS && build->project_path)
+        build->template_status = load_template(build->project_path, &build->project_tp,
+                                               (cache) ? &cache->project : NULL, stats);
+
+    if (build->template_status == WP_SUCCESS && build->skill_path)
+        build->template_status = load_template(build->skill_path, &build->skill_tp,
+                                               (cache) ? &cache->skill : NULL, stats);
+
+    // Asset names aren't known until the whole portfolio is parsed.
+    if (build->template_status == WP_SUCCESS)
+        build->early_render = !build->options.assets && !stages_use_portfolio_lists(build->page_tp.stages);
+}
+
+static void templates_loaded(Site_Build* build)
+{
+    build->templates_state = TEMPLATES_LOADED;
+
+    if (build->options.incremental && build->template_status == WP_SUCCESS)
+    {
+        inputs_add_template(&build->inputs, build->home_path, build->home_tp.content);
+        inputs_add_template(&build->inputs, build->page_path, build->page_tp.content);
+
+        if (build->project_path)
+            inputs_add_template(&build->inputs, build->project_path, build->project_tp.content);
+
+        if (build->skill_path)
+            inputs_add_template(&build->inputs, build->skill_path, build->skill_tp.content);
+
+        inputs_add_option(&build->inputs, "minify", build->options.minify);
+        inputs_add_option(&build->inputs, "assets", build->options.assets);
+    }
+}
+
+// For templates that came after the others in the portfolio, so
+// the template thread didn't know about them.
+static void load_late_template(Site_Build* build, String path, String* build_path,
+                               Template_Parser* tp, Cached_Template* cached)
+{
+    if (build->template_status != WP_SUCCESS || !path || *build_path)
+        return;
+
+    *build_path = path;
+    build->template_status = load_template(path, tp, cached, build->options.stats);
+
+    if (build->options.incremental && build->template_status == WP_SUCCESS)
+        inputs_add_template(&build->inputs, path, tp->content);
+}
+
+static void wait_for_templates(Site_Build* build)
+{
+    if (build->templates_state == TEMPLATES_LOADING)
+    {
+        thread_join(&build->template_thread);
+        templates_loaded(build);
+    }
+}
+
+// Reads the manifest left by the last run and, for incremental
+// builds, hashes any personas that haven't been hashed yet.
+static void prepare_pages(Site_Build* build, Portfolio portfolio)
+{
+    Build_Cache* cache = build->cache;
+
+    if (!build->manifest_loaded && portfolio.outdir)
+    {
+        if (cache && cache->has_manifest && string_cmp(cache->outdir, portfolio.outdir))
+        {
+            build->manifest = cache->manifest;
+            cache->has_manifest = 0;
+        }
+        else
+        {
+            char filepath[256];
+            sprintf(filepath, "%s/" MANIFEST_FILE, portfolio.outdir);
+            build->manifest = manifest_load(filepath);
+        }
+
+        build->manifest_loaded = 1;
+    }
+
+    if (!build->options.incremental)
+        return;
+
+    inputs_add_option(&build->inputs, "page_size", portfolio.page_size);
+
+    int num_personas = da_size(portfolio.personas);
+    for (; build->hashed_personas < num_personas; build->hashed_personas++)
+    {
+        Persona persona = portfolio.personas[build->hashed_personas];
+        inputs_add_persona(&build->inputs, persona);
+
+        da_foreach(Project, project, persona.projects)
+            inputs_add_project(&build->inputs, *project);
+    }
+}
+
+// Saves the new manifest and the list of pages that changed.
+static void save_manifest(Site_Build* build, Portfolio portfolio, Webpage_Status status)
+{
+    Manifest manifest = manifest_make();
+    int outdir_len = strlen(portfolio.outdir);
+
+    char filepath[256];
+    sprintf(filepath, "%s/" CHANGES_FILE, portfolio.outdir);
+    FILE* changes = fopen(filepath, "wb");
+
+    da_foreach(Page_Result*, it, build->results)
+    {
+        Page_Result* result = *it;
+        if (result->status != WP_SUCCESS)
+            continue;
+
+        char* name = result->filename + outdir_len + 1;
+        if (result->skipped)
+            manifest_copy_page(&manifest, manifest_find(&build->manifest, name));
+        else
+            manifest_add_page(&manifest, name, result->hash, result->deps, &build->inputs);
+
+        if (changes && result->change != PAGE_UNCHANGED)
+            fprintf(changes, "%c %s\n", (result->change == PAGE_ADDED) ? 'A' : 'M', name);
+    }
+
+    // Pages from the last run that weren't generated this time are
+    // only removed with --prune, and only if the whole build worked so
+    // a mistake in a template can't make pages go missing. A page that
+    // no longer holds what was written to it has been touched by hand
+    // and is left alone. Pages that stay are kept in the manifest so
+    // they can be removed later.
+    da_foreach(Manifest_Page, page, build->manifest.pages)
+    {
+        if (manifest_find(&manifest, page->path))
+            continue;
+
+        sprintf(filepath, "%s/%s", portfolio.outdir, page->path);
+
+        int exists = file_exists(filepath);
+        int keep = status != WP_SUCCESS;
+
+        if (!keep && exists)
+        {
+            uint64_t hash;
+            keep = !build->options.prune || !hash_file(filepath, &hash) ||
+                   hash != page->hash || !remove_file(filepath);
+        }
+
+        if (keep)
+        {
+            manifest_copy_page(&manifest, page);
+            continue;
+        }
+
+        if (exists)
+            printf("Removed %s\n", filepath);
+
+        for (int i = 0; build->options.prune && i < NUM_ENCODINGS; i++)
+        {
+            sprintf(filepath, "%s/%s%s", portfolio.outdir, page->path, encodings[i].suffix);
+            if (file_exists(filepath))
+                remove_file(filepath);
+        }
+
+        if (changes)
+            fprintf(changes, "D %s\n", page->path);
+    }
+
+    if (changes)
+        fclose(changes);
+
+    sprintf(filepath, "%s/" MANIFEST_FILE, portfolio.outdir);
+    manifest_save(&manifest, filepath);
+
+    Build_Cache* cache = build->cache;
+    if (!cache)
+    {
+        manifest_free(&manifest);
+        return;
+    }
+
+    if (cache->outdir)
+        string_free(&cache->outdir);
+
+    if (cache->has_manifest)
+        manifest_free(&cache->manifest);
+
+    cache->outdir = string_make(portfolio.outdir);
+    cache->manifest = manifest;
+    cache->has_manifest = 1;
+}
+
+Site_Build site_build_make(Webpage_Options options, Build_Cache* cache)
+{
+    Site_Build build = { 0 };
+    build.options = options;
+    build.cache = cache;
+    build.template_status = WP_MISSING_TEMPLATE;
+    build.generator = generator_make(NULL);
+    build.generator.track_deps = options.incremental;
+    build.generator.minify = options.minify;
+    da_make(build.results);
+
+    if (options.stream_size > 0)
+        build.stream = stream_make(-1, options.stream_size);
+
+    return build;
+}
+
+// Generators keep a pointer to the views so they're only
+// made once the build has settled at its final address.
+static void make_views(Site_Build* build)
+{
+    if (build->has_views)
+        return;
+
+    view_cache_make(&build->views);
+    build->has_views = 1;
+    build->generator.views = &build->views;
+}
+
+// The writer thread keeps a pointer to the queue so it's only
+// started once the build has settled at its final address.
+static void start_writer(Site_Build* build)
+{
+    if (build->has_writer || build->writer_failed)
+        return;
+
+    write_queue_make(&build->queue);
+    build->queue.stats = build->options.stats;
+    build->has_writer = thread_create(&build->writer, writer_proc, &build->queue);
+
+    if (!build->has_writer)
+    {
+        write_queue_free(&build->queue);
+        build->writer_failed = 1;
+    }
+}
+
+// Templates that made it into the cache belong to it.
+static void free_template(Template_Parser* tp, Cached_Template* cached)
+{
+    if (!tp->stages)
+        return;
+
+    if (cached && tp->stages == cached->tp.stages)
+        return;
+
+    template_parser_free(tp);
+}
+
+void site_build_free(Site_Build* build)
+{
+    wait_for_templates(build);
+
+    if (build->has_writer)
+    {
+        write_queue_close(&build->queue);
+        thread_join(&build->writer);
+        write_queue_free(&build->queue);
+        build->has_writer = 0;
+    }
+
+    da_foreach(Page_Result*, result, build->results)
+    {
+        if ((*result)->message)
+            string_free(&(*result)->message);
+
+        if ((*result)->deps)
+        {
+            da_foreach(String, key, (*result)->deps)
+                string_free(key);
+            da_free((*result)->deps);
+        }
+
+        if ((*result)->page.number_text)
+            page_info_free(&(*result)->page);
+
+        free(*result);
+    }
+    da_free(build->results);
+
+    Build_Cache* cache = build->cache;
+    free_template(&build->home_tp, (cache) ? &cache->home : NULL);
+    free_template(&build->page_tp, (cache) ? &cache->page : NULL);
+    free_template(&build->project_tp, (cache) ? &cache->project : NULL);
+    free_template(&build->skill_tp, (cache) ? &cache->skill : NULL);
+
+    generator_free(&build->generator);
+
+    if (build->stream.buffer)
+        stream_free(&build->stream);
+
+    inputs_free(&build->inputs);
+
+    if (build->has_assets)
+        asset_map_free(&build->assets);
+
+    if (build->has_skills)
+        skill_map_free(&build->skills);
+
+    if (build->has_views)
+        view_cache_free(&build->views);
+
+    if (build->manifest_loaded)
+        manifest_free(&build->manifest);
+}
+
+// Makes sure the cache has both templates without building
+// anything. Templates are only parsed again if they changed.
+Webpage_Status build_cache_load_templates(Build_Cache* cache, Portfolio portfolio)
+{
+    Template_Parser home_tp = { 0 }, page_tp = { 0 }, project_tp = { 0 }, skill_tp = { 0 };
+
+    Webpage_Status status = load_template(portfolio.home_template, &home_tp, &cache->home, NULL);
+    if (status == WP_SUCCESS)
+        status = load_template(portfolio.page_template, &page_tp, &cache->page, NULL);
+
+    if (status == WP_SUCCESS && portfolio.project_template)
+        status = load_template(portfolio.project_template, &project_tp, &cache->project, NULL);
+
+    if (status == WP_SUCCESS && portfolio.skill_template)
+        status = load_template(portfolio.skill_template, &skill_tp, &cache->skill, NULL);
+
+    free_template(&home_tp, &cache->home);
+    free_template(&page_tp, &cache->page);
+    free_template(&project_tp, &cache->project);
+    free_template(&skill_tp, &cache->skill);
+    return status;
+}
+
+// The project and skill templates are loaded once the portfolio is
+// finished if they come after the home and page templates.
+void site_build_load_templates(Site_Build* build, Portfolio portfolio)
+{
+    if (build->templates_state != TEMPLATES_NOT_LOADED)
+        return;
+
+    build->home_path    = portfolio.home_template;
+    build->page_path    = portfolio.page_template;
+    build->project_path = portfolio.project_template;
+    build->skill_path   = portfolio.skill_template;
+
+    if (thread_create(&build->template_thread, load_templates_proc, build))
+    {
+        build->templates_state = TEMPLATES_LOADING;
+    }
+    else
+    {
+        load_templates_proc(build);
+        templates_loaded(build);
+    }
+}
+
+static Page_Result* add_result(Site_Build* build, Page_Kind kind, int persona_index)
+{
+    Page_Result* result = (Page_Result*) calloc(1, sizeof(Page_Result));
+    hd_assert(result != NULL);
+
+    result->kind    = kind;
+    result->persona = persona_index;
+    result->project = -1;
+    result->skill   = -1;
+    da_push_back(build->results, result);
+    return result;
+}
+
+// Adds results for the home page and every page of
+// the personas that were parsed since the last call.
+static void add_pages(Site_Build* build, Portfolio portfolio)
+{
+    if (da_size(build->results) == 0)
+    {
+        Page_Result* home = add_result(build, PAGE_HOME, -1);
+        home->page = page_info_make(portfolio, -1, 1);
+    }
+
+    int num_personas = da_size(portfolio.personas);
+    for (; build->paged_personas < num_personas; build->paged_personas++)
+    {
+        persona_name_projects(portfolio.personas + build->paged_personas);
+
+        int count = persona_page_count(portfolio, build->paged_personas);
+        for (int number = 1; number <= count; number++)
+        {
+            Page_Result* result = add_result(build, PAGE_PERSONA, build->paged_personas);
+            result->page = page_info_make(portfolio, build->paged_personas, number);
+        }
+    }
+}
+
+// Adds a result for every project and every skill once all the
+// other pages are in. These pages are never split so they don't
+// get page info.
+static void add_project_pages(Site_Build* build, Portfolio portfolio)
+{
+    int num_personas = da_size(portfolio.personas);
+    for (int i = 0; i < num_personas && build->project_path; i++)
+    {
+        int num_projects = da_size(portfolio.personas[i].projects);
+        for (int j = 0; j < num_projects; j++)
+            add_result(build, PAGE_PROJECT, i)->project = j;
+    }
+
+    int num_skills = da_size(build->skills.skills);
+    for (int i = 0; i < num_skills && build->skill_path; i++)
+        add_result(build, PAGE_SKILL, -1)->skill = i;
+}
+
+static uint64_t hash_segments(DArray(Segment) segments)
+{
+    Hash_State state;
+    hash_begin(&state, 0);
+
+    da_foreach(Segment, seg, segments)
+        hash_update(&state, seg->data, seg->length);
+
+    return hash_end(&state);
+}
+
+// Compares a rendered page against the manifest, or against the file
+// on disk when the page isn't in the manifest.
+static Page_Change page_change(Site_Build* build, Page_Result* result, char* name)
+{
+    if (!file_exists(result->filename))
+        return PAGE_ADDED;
+
+    uint64_t hash;
+    Manifest_Page* last_run = manifest_find(&build->manifest, name);
+
+    if (last_run)
+    {
+        hash = last_run->hash;
+    }
+    else
+    {
+        String contents = load_file(result->filename);
+        if (!contents)
+            return PAGE_CHANGED;
+
+        hash = hash_bytes(contents, strlen(contents), 0);
+        string_free(&contents);
+    }
+
+    return (hash == result->hash) ? PAGE_UNCHANGED : PAGE_CHANGED;
+}
+
+// Compressed copies are made for pages that changed and
+// for pages that are missing one.
+static int needs_variants(Site_Build* build, Page_Result* result)
+{
+    if (build->options.compress_level == 0)
+        return 0;
+
+    if (result->change != PAGE_UNCHANGED)
+        return 1;
+
+    for (int i = 0; i < NUM_ENCODINGS; i++)
+    {
+        char filepath[sizeof(result->filename) + 8];
+        sprintf(filepath, "%s%s", result->filename, encodings[i].suffix);
+
+        if (!file_exists(filepath))
+            return 1;
+    }
+
+    return 0;
+}
+
+static void compress_page(Site_Build* build, char* data, size_t length, Compressed* variants)
+{
+    for (int i = 0; i < NUM_ENCODINGS; i++)
+        variants[i] = encodings[i].compress(data, length, build->options.compress_level);
+}
+
+// Renders a page and either streams it to its file or queues it up
+// for the writer thread. Streamed pages go to a temporary file first
+// since they can't be compared with the old page until they're done.
+static void render_page(Site_Build* build, Generator* gen, Stream* stream,
+                        Portfolio portfolio, Page_Result* result)
+{
+    int selected_index = result->persona;
+    Project* project = NULL;
+    Skill* skill = NULL;
+    String template_path = NULL;
+    char page[PAGE_NAME_SIZE];
+
+    switch (result->kind)
+    {
+        case PAGE_HOME:
+        {
+            gen->stages = build->home_tp.stages;
+            template_path = build->home_path;
+            strcpy(page, "index.html");
+        } break;
+
+        case PAGE_PERSONA:
+        {
+            gen->stages = build->page_tp.stages;
+            template_path = build->page_path;
+            page_name(page, portfolio.personas[selected_index], result->page.number);
+        } break;
+
+        case PAGE_PROJECT:
+        {
+            project = portfolio.personas[selected_index].projects + result->project;
+
+            gen->stages = build->project_tp.stages;
+            template_path = build->project_path;
+            strcpy(page, project->page);
+        } break;
+
+        case PAGE_SKILL:
+        {
+            skill = build->skills.skills + result->skill;
+
+            gen->stages = build->skill_tp.stages;
+            template_path = build->skill_path;
+            strcpy(page, skill->page);
+        } break;
+
+        default:
+        {
+            hd_assert(0);
+        } break;
+    }
+
+    // A cut off path would write the page somewhere else.
+    int length = snprintf(result->filename, sizeof(result->filename), "%s/%s", portfolio.outdir, page);
+    if (length < 0 || (size_t) length >= sizeof(result->filename))
+    {
+        char message[PAGE_NAME_SIZE + 64];
+        snprintf(message, sizeof(message), "Error: The path for %s is too long", page);
+
+        result->status  = WP_WRITE_ERROR;
+        result->message = string_make(message);
+        return;
+    }
+
+    char* name = result->filename + strlen(portfolio.outdir) + 1;
+
+    if (build->options.incremental)
+    {
+        Manifest_Page* last_run = manifest_find(&build->manifest, name);
+
+        if (last_run && manifest_page_is_clean(last_run, &build->inputs) &&
+            file_exists(result->filename) && !needs_variants(build, result))
+        {
+            result->status  = WP_SUCCESS;
+            result->skipped = 1;
+            return;
+        }
+    }
+
+    generator_reset(gen);
+    gen->page    = (result->page.number_text) ? &result->page : NULL;
+    gen->project = project;
+    gen->skill   = skill;
+
+    Build_Stats* stats = build->options.stats;
+    Stat_Span span = stats_begin(stats, STAT_RENDER);
+
+    int res = 1;
+    char temp_filename[sizeof(result->filename) + 8];
+    if (build->options.stream_size > 0)
+    {
+        sprintf(temp_filename, "%s.tmp", result->filename);
+
+        int fd = file_open_for_write(temp_filename);
+        if (fd < 0 && make_dirs(temp_filename))
+            fd = file_open_for_write(temp_filename);
+
+        if (fd < 0)
+        {
+            stats_end(stats, span);
+            result->status = WP_WRITE_ERROR;
+            set_write_error(result, temp_filename, errno);
+            return;
+        }
+
+        stream_attach(stream, fd);
+        generate_page_stream(gen, portfolio, selected_index, stream);
+        file_close(fd);
+
+        res = !stream->failed;
+        result->hash = hash_end(&stream->hash);
+    }
+    else
+    {
+        generate_page(gen, portfolio, selected_index);
+        result->hash = hash_segments(gen->segments);
+    }
+
+    stats_end(stats, span);
+
+    if (gen->status == GEN_FAILURE)
+    {
+        if (build->options.stream_size > 0)
+            remove_file(temp_filename);
+
+        result->status  = WP_TEMPLATE_ERROR;
+        result->message = gen->message;
+        gen->message = NULL;
+        return;
+    }
+
+    stats_add_page(stats, gen->output_size);
+    trace_counter("page bytes", (long long) gen->output_size);
+
+    if (gen->track_deps)
+    {
+        char key[DEP_KEY_SIZE];
+        dep_key(key, "template", template_path, NULL);
+
+        result->deps = generator_take_deps(gen);
+        da_push_back(result->deps, string_make(key));
+
+        dep_key(key, "option", "minify", NULL);
+        da_push_back(result->deps, string_make(key));
+
+        dep_key(key, "option", "assets", NULL);
+        da_push_back(result->deps, string_make(key));
+
+        dep_key(key, "option", "page_size", NULL);
+        da_push_back(result->deps, string_make(key));
+
+        if (project)
+        {
+            dep_key(key, "project", project->page, NULL);
+            da_push_back(result->deps, string_make(key));
+        }
+
+        if (skill)
+        {
+            dep_key(key, "skill", skill->page, NULL);
+            da_push_back(result->deps, string_make(key));
+        }
+    }
+
+    result->change = page_change(build, result, name);
+    int compress = needs_variants(build, result);
+
+    // Streamed pages have to be read back to be compressed.
+    if (build->options.stream_size > 0)
+    {
+        if (res && compress)
+        {
+            Write_Job job = { result, NULL, { { 0 } } };
+            String contents = load_file(temp_filename);
+
+            res = contents != NULL;
+            if (res)
+            {
+                compress_page(build, contents, stream->written, job.variants);
+                string_free(&contents);
+                write_jobs(NULL, &job, 1, stats);
+                res = result->status == WP_SUCCESS;
+            }
+        }
+
+        span = stats_begin(stats, STAT_WRITE);
+
+        if (res && result->change != PAGE_UNCHANGED)
+        {
+            res = replace_file(temp_filename, result->filename);
+            if (!res)
+                set_write_error(result, result->filename, errno);
+        }
+        else
+        {
+            remove_file(temp_filename);
+        }
+
+        stats_end(stats, span);
+
+        if (!res)
+            set_write_error(result, temp_filename, EIO);
+
+        result->status = (res) ? WP_SUCCESS : WP_WRITE_ERROR;
+        return;
+    }
+
+    if (result->change == PAGE_UNCHANGED && !compress)
+    {
+        da_clear(gen->segments);
+        result->status = WP_SUCCESS;
+        return;
+    }
+
+    // Compress while the page is still in cache.
+    Write_Job job = { result, NULL, { { 0 } } };
+    if (compress)
+    {
+        String output = generator_output(*gen);
+        compress_page(build, output, gen->output_size, job.variants);
+        string_free(&output);
+    }
+
+    // The writer takes the segments so the generator needs new ones.
+    if (result->change != PAGE_UNCHANGED)
+    {
+        job.segments = gen->segments;
+        gen->segments = NULL;
+        da_make(gen->segments);
+    }
+    else
+    {
+        da_clear(gen->segments);
+    }
+
+    if (build->has_writer)
+    {
+        write_queue_push(&build->queue, job);
+    }
+    else
+    {
+        write_jobs(NULL, &job, 1, stats);
+    }
+}
+
+void site_build_persona_parsed(Site_Build* build, Portfolio portfolio, int persona_index)
+{
+    // Pages only get rendered early if every page before this one was too.
+    // $outdir can come after the personas, in which case they're all
+    // left for site_build_finish.
+    if (build->templates_state == TEMPLATES_NOT_LOADED || !portfolio.outdir ||
+        persona_index != build->early_personas)
+        return;
+
+    wait_for_templates(build);
+
+    if (build->template_status != WP_SUCCESS || !build->early_render)
+        return;
+
+    add_pages(build, portfolio);
+    prepare_pages(build, portfolio);
+    make_views(build);
+
+    if (build->options.stream_size == 0)
+        start_writer(build);
+
+    int num_pages = da_size(build->results);
+    for (int page = build->early_pages + 1; page < num_pages; page++)
+    {
+        Trace_Span span = trace_begin("page");
+        render_page(build, &build->generator, &build->stream, portfolio, build->results[page]);
+        trace_end(span, build->results[page]->filename);
+        build->early_pages++;
+    }
+
+    build->early_personas++;
+}
+
+// Collects every asset the templates and portfolio reference and
+// copies them into the output directory before anything is rendered.
+static int copy_assets(Site_Build* build, Portfolio portfolio, int num_workers)
+{
+    Trace_Span span = trace_begin("assets");
+
+    build->assets = asset_map_make();
+    build->has_assets = 1;
+
+    stages_add_assets(build->home_tp.stages, &build->assets);
+    stages_add_assets(build->page_tp.stages, &build->assets);
+
+    if (build->project_tp.stages)
+        stages_add_assets(build->project_tp.stages, &build->assets);
+
+    if (build->skill_tp.stages)
+        stages_add_assets(build->skill_tp.stages, &build->assets);
+    assets_add_portfolio(&build->assets, portfolio);
+
+    int res = assets_copy(&build->assets, portfolio.outdir, num_workers);
+
+    if (build->options.incremental)
+    {
+        da_foreach(Asset, asset, build->assets.assets)
+            if (asset->fingerprinted)
+                inputs_add_asset(&build->inputs, asset->path, asset->hash);
+    }
+
+    trace_end(span, NULL);
+    return res;
+}
+
+// The index is only written if it's different from the one
+// that's already there. Returns 0 if it couldn't be written.
+static int write_search_index(Site_Build* build, Portfolio portfolio, int num_workers)
+{
+    Trace_Span span = trace_begin("search index");
+    Search_Index index = search_index_make(portfolio, num_workers);
+    DArray(uint8_t) data = search_index_encode(&index, portfolio, build->project_path != NULL);
+    search_index_free(&index);
+
+    char filepath[256];
+    sprintf(filepath, "%s/" SEARCH_FILE, portfolio.outdir);
+
+    int res = 1;
+    uint64_t hash;
+    if (!hash_file(filepath, &hash) || hash != hash_bytes(data, da_size(data), 0))
+    {
+        res = write_file_bytes(filepath, (char*) data, da_size(data));
+
+        if (res)
+            printf("%s\n", filepath);
+        else
+            printf("Error: Couldn't write %s\n", filepath);
+    }
+
+    da_free(data);
+    trace_end(span, filepath);
+    return res;
+}
+
+// Shared by all the workers. Everything except the
+// per worker generators and streams is read only.
+typedef struct
+{
+    Site_Build* build;
+    Portfolio portfolio;
+    Generator* generators;
+    Stream* streams;
+    Page_Result** results;
+} Render_Context;
+
+static void count_page(Build_Stats* stats, Page_Result* result)
+{
+    if (!stats || result->status != WP_SUCCESS)
+        return;
+
+    if (result->skipped)
+        stats->pages_skipped++;
+    else if (result->change == PAGE_UNCHANGED)
+        stats->pages_unchanged++;
+    else
+        stats->pages_written++;
+}
+
+// Job 0 is the home page, the rest are the persona
+// pages that weren't rendered while parsing.
+static void render_page_job(void* data, int worker, int job)
+{
+    Render_Context* ctx = (Render_Context*) data;
+    int page = (job == 0) ? 0 : ctx->build->early_pages + job;
+    Stream* stream = (ctx->streams) ? ctx->streams + worker : NULL;
+
+    Trace_Span span = trace_begin("page");
+    render_page(ctx->build, ctx->generators + worker, stream, ctx->portfolio, ctx->results[page]);
+    trace_end(span, ctx->results[page]->filename);
+}
+
+Webpage_Status site_build_finish(Site_Build* build, Portfolio portfolio)
+{
+    if (build->templates_state == TEMPLATES_NOT_LOADED)
+        site_build_load_templates(build, portfolio);
+
+    wait_for_templates(build);
+
+    Build_Cache* cache = build->cache;
+    load_late_template(build, portfolio.project_template, &build->project_path, &build->project_tp,
+                       (cache) ? &cache->project : NULL);
+    load_late_template(build, portfolio.skill_template, &build->skill_path, &build->skill_tp,
+                       (cache) ? &cache->skill : NULL);
+
+    if (build->template_status != WP_SUCCESS)
+        return build->template_status;
+
+    add_pages(build, portfolio);
+    prepare_pages(build, portfolio);
+
+    if (build->options.stats)
+    {
+        build->options.stats->stages = stages_count(build->home_tp.stages) + stages_count(build->page_tp.stages) +
+                                       stages_count(build->project_tp.stages) + stages_count(build->skill_tp.stages);
+    }
+
+    if (build->options.incremental)
+    {
+        da_foreach(Link, link, portfolio.links)
+            inputs_add_link(&build->inputs, *link);
+
+        inputs_add_lists(&build->inputs, portfolio);
+    }
+
+    // Cheap enough to always have so any template can list skills.
+    build->skills = skill_map_make(portfolio);
+    build->has_skills = 1;
+
+    if (build->options.incremental)
+        inputs_add_skills(&build->inputs, &build->skills, portfolio);
+
+    int num_workers = (build->options.jobs > 1) ? build->options.jobs : 1;
+
+    if (build->options.assets && !copy_assets(build, portfolio, num_workers))
+        return WP_WRITE_ERROR;
+
+    add_project_pages(build, portfolio);
+
+    int num_pages = da_size(build->results);
+    make_views(build);
+
+    if (build->options.stream_size == 0)
+        start_writer(build);
+
+    int num_jobs = num_pages - build->early_pages;
+
+    Render_Context ctx = { build, portfolio, NULL, NULL, build->results };
+    ctx.generators = (Generator*) malloc(num_workers * sizeof(Generator));
+    hd_assert(ctx.generators != NULL);
+
+    if (build->options.stream_size > 0)
+    {
+        ctx.streams = (Stream*) malloc(num_workers * sizeof(Stream));
+        hd_assert(ctx.streams != NULL);
+    }
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        ctx.generators[i] = generator_make(NULL);
+        ctx.generators[i].track_deps = build->options.incremental;
+        ctx.generators[i].minify = build->options.minify;
+        ctx.generators[i].assets = (build->has_assets) ? &build->assets : NULL;
+        ctx.generators[i].skills = &build->skills;
+        ctx.generators[i].views = &build->views;
+
+        if (ctx.streams)
+            ctx.streams[i] = stream_make(-1, build->options.stream_size);
+    }
+
+    Trace_Span span = trace_begin("render pages");
+    jobs_run(num_workers, num_jobs, render_page_job, &ctx);
+    trace_end(span, NULL);
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        generator_free(ctx.generators + i);
+
+        if (ctx.streams)
+            stream_free(ctx.streams + i);
+    }
+
+    free(ctx.generators);
+    free(ctx.streams);
+
+    // Everything has to be on disk before reporting.
+    if (build->has_writer)
+    {
+        span = trace_begin("wait for writer");
+        write_queue_close(&build->queue);
+        thread_join(&build->writer);
+        write_queue_free(&build->queue);
+        build->has_writer = 0;
+        trace_end(span, NULL);
+    }
+
+    // Report in page order so the output doesn't depend on which
+    // worker finished first. Every file that couldn't be written is
+    // listed but a template error stops things at the first page.
+    Webpage_Status status = WP_SUCCESS;
+    for (int i = 0; status != WP_TEMPLATE_ERROR && i < num_pages; i++)
+    {
+        Page_Result* result = build->results[i];
+        count_page(build->options.stats, result);
+
+        switch (result->status)
+        {
+            case WP_SUCCESS:
+            {
+                if (result->change != PAGE_UNCHANGED)
+                    printf("%s\n", result->filename);
+            } break;
+
+            case WP_WRITE_ERROR:
+            {
+                if (result->message)
+                    printf("%s\n", result->message);
+
+                if (status == WP_SUCCESS)
+                    status = WP_WRITE_ERROR;
+            } break;
+
+            default:
+            {
+                if (result->message)
+                    printf("%s\n", result->message);
+
+                status = result->status;
+            } break;
+        }
+    }
+
+    if (status != WP_TEMPLATE_ERROR && build->options.search &&
+        !write_search_index(build, portfolio, num_workers) && status == WP_SUCCESS)
+        status = WP_WRITE_ERROR;
+
+    span = trace_begin("manifest");
+    save_manifest(build, portfolio, status);
+    trace_end(span, NULL);
+
+    return status;
+}
+
+Webpage_Status generate_webpages(Portfolio portfolio, Webpage_Options options)
+{
+    Site_Build build = site_build_make(options, NULL);
+    Webpage_Status status = site_build_finish(&build, portfolio);
+    site_build_free(&build);
+    return status;
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "portfolio.h"
+#include "webpage.h"
+#include "filestuff.h"
+#include "threads.h"
+#include "deps.h"
+#include "compress.h"
+#include "writer.h"
+#include "search.h"
+#include "stats.h"
+#include "containers/string.h"
+#include "containers/darray.h"
+
+typedef struct
+{
+    // Size of the flush buffer pages are streamed through.
+    // With 0 each page is kept as segments and written in one go.
+    size_t stream_size;
+
+    // Number of pages rendered at the same time.
+    int jobs;
+
+    // Only generate pages whose inputs changed since the last run.
+    int incremental;
+
+    // Write compressed copies (.gz and .br if swg was built with
+    // SWG_BROTLI) next to every page. 0 leaves them out.
+    int compress_level;
+
+    // Run pages through the HTML minifier (see minify.h).
+    int minify;
+
+    // Copy referenced files into the output directory under
+    // fingerprinted names (see assets.h).
+    int assets;
+
+    // Write a search index over the projects (see search.h).
+    int search;
+
+    // Delete pages an earlier run generated that aren't generated
+    // any more (see save_manifest).
+    int prune;
+
+    // Where the build's timings and counts go. NULL leaves them out.
+    Build_Stats* stats;
+} Webpage_Options;
+
+#define MANIFEST_FILE ".swg-manifest"
+
+// Lists the pages that were added, changed or removed by the last
+// run, one per line with an A, M or D in front of the path.
+#define CHANGES_FILE ".swg-changes"
+
+#define WP_DEFAULT_STREAM_SIZE (64 * 1024)
+
+typedef enum
+{
+    PAGE_UNCHANGED,
+    PAGE_ADDED,
+    PAGE_CHANGED
+} Page_Change;
+
+typedef enum
+{
+    PAGE_HOME,
+    PAGE_PERSONA,
+    PAGE_PROJECT,
+    PAGE_SKILL
+} Page_Kind;
+
+typedef struct
+{
+    // Persona is -1 for pages that aren't about a persona. Project
+    // is the index of the persona's project for project pages and
+    // skill is the index in the skill map for skill pages.
+    Page_Kind kind;
+    int persona;
+    int project;
+    int skill;
+    Page_Info page;
+
+    // The output directory and the page name.
+    char filename[PAGE_NAME_SIZE + 128];
+    Webpage_Status status;
+    String message;
+
+    // Set when the page was up to date and wasn't generated.
+    int skipped;
+    DArray(String) deps;
+
+    // Pages that come out the same as last time aren't written.
+    uint64_t hash;
+    Page_Change change;
+} Page_Result;
+
+#define MAX_ENCODINGS 2
+
+// A rendered page waiting for the writer thread. Segments are NULL
+// if only the compressed copies of the page need to be written.
+typedef struct
+{
+    Page_Result* result;
+    DArray(Segment) segments;
+    Compressed variants[MAX_ENCODINGS];
+} Write_Job;
+
+// The writer thread takes whatever jobs are waiting
+// and writes all of them at once (see writer.h).
+typedef struct
+{
+    Mutex lock;
+    Cond  not_empty;
+    Cond  not_full;
+    Write_Job* jobs;
+    int head;
+    int count;
+    int cap;
+    int closed;
+    File_Writer writer;
+    Build_Stats* stats;
+} Write_Queue;
+
+typedef struct
+{
+    String path;
+    uint64_t hash;
+    Template_Parser tp;
+} Cached_Template;
+
+/*
+    Things worth keeping between builds when swg stays running in
+    watch mode. Templates are only parsed again once their contents
+    change and the manifest doesn't need to be read back from disk.
+*/
+typedef struct
+{
+    Cached_Template home;
+    Cached_Template page;
+    Cached_Template project;
+    Cached_Template skill;
+
+    String outdir;
+    Manifest manifest;
+    int has_manifest;
+} Build_Cache;
+
+Build_Cache build_cache_make();
+void build_cache_free(Build_Cache* cache);
+Webpage_Status build_cache_load_templates(Build_Cache* cache, Portfolio portfolio);
+
+typedef enum
+{
+    TEMPLATES_NOT_LOADED,
+    TEMPLATES_LOADING,
+    TEMPLATES_LOADED
+} Templates_State;
+
+/*
+    Keeps track of one run of the generator. Templates load on their
+    own thread while the portfolio is parsed, persona pages can be
+    rendered as soon as they are parsed and rendered pages are handed
+    to a writer thread so rendering doesn't wait on the disk.
+*/
+typedef struct
+{
+    Webpage_Options options;
+    Build_Cache* cache;
+
+    String home_path;
+    String page_path;
+    Template_Parser home_tp;
+    Template_Parser page_tp;
+
+    // Only loaded if the portfolio has them.
+    String project_path;
+    Template_Parser project_tp;
+    String skill_path;
+    Template_Parser skill_tp;
+    Webpage_Status template_status;
+    Templates_State templates_state;
+    Thread template_thread;
+
+    // Page 0 is the home page, followed by every page of each
+    // persona in order. Personas can have more than one page.
+    // Project pages and then skill pages come after all of those.
+    DArray(Page_Result*) results;
+    int paged_personas;
+
+    // Persona pages that were rendered while parsing and
+    // the personas they belong to.
+    int early_pages;
+    int early_personas;
+    int early_render;
+
+    Generator generator;
+    Stream stream;
+
+    // What every page looked like after the last run.
+    Manifest manifest;
+    int manifest_loaded;
+
+    // Only used for incremental builds.
+    Input_Hashes inputs;
+    int hashed_personas;
+
+    Asset_Map assets;
+    int has_assets;
+
+    Skill_Map skills;
+    int has_skills;
+
+    // Made once the build has settled at its final address.
+    View_Cache views;
+    int has_views;
+
+    Write_Queue queue;
+    Thread writer;
+    int has_writer;
+    int writer_failed;
+} Site_Build;
+
+Site_Build site_build_make(Webpage_Options options, Build_Cache* cache);
+void site_build_free(Site_Build* build);
+void site_build_load_templates(Site_Build* build, Portfolio portfolio);
+void site_build_persona_parsed(Site_Build* build, Portfolio portfolio, int persona_index);
+Webpage_Status site_build_finish(Site_Build* build, Portfolio portfolio);
+
+Webpage_Status generate_webpages(Portfolio portfolio, Webpage_Options options);
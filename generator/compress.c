@@ -0,0 +1,724 @@
+#include "compress.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "containers/hd_assert.h"
+
+#ifdef SWG_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#define WINDOW_SIZE   32768
+#define WINDOW_MASK   (WINDOW_SIZE - 1)
+#define HASH_BITS     15
+#define HASH_SIZE     (1 << HASH_BITS)
+#define MIN_MATCH     3
+#define MAX_MATCH     258
+#define BLOCK_SYMBOLS 16384
+
+#define NUM_LITLEN    286
+#define NUM_DIST      30
+#define NUM_CLEN      19
+#define MAX_BITS      15
+#define MAX_CLEN_BITS 7
+#define END_OF_BLOCK  256
+
+static const uint16_t length_base[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t length_extra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t dist_base[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t dist_extra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Order the code length code lengths are written in.
+static const uint8_t clen_order[NUM_CLEN] =
+{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// How many earlier positions get checked for a match and how
+// long a match has to be to stop looking. Levels from 4 up also
+// check if starting a byte later gives a longer match.
+static const int level_chain[COMPRESS_MAX_LEVEL + 1] = { 0, 4, 8, 16, 16, 32, 128, 256, 1024, 4096 };
+static const int level_nice[COMPRESS_MAX_LEVEL + 1]  = { 0, 8, 16, 32, 16, 32, 128, 128, 258, 258 };
+
+static const uint32_t crc_table[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t crc32(unsigned char* data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crc_table[crc & 15];
+        crc = (crc >> 4) ^ crc_table[crc & 15];
+    }
+
+    return ~crc;
+}
+
+static void out_reserve(Compressed* out, size_t extra)
+{
+    if (out->length + extra <= out->cap)
+        return;
+
+    size_t cap = (out->cap) ? out->cap : 4096;
+    while (cap < out->length + extra)
+        cap *= 2;
+
+    out->data = (char*) realloc(out->data, cap);
+    hd_assert(out->data != NULL);
+    out->cap = cap;
+}
+
+static void out_bytes(Compressed* out, const void* data, size_t length)
+{
+    out_reserve(out, length);
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+static void out_u32(Compressed* out, uint32_t value)
+{
+    unsigned char bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    out_bytes(out, bytes, 4);
+}
+
+typedef struct
+{
+    Compressed* out;
+    uint64_t bits;
+    int count;
+} Bit_Writer;
+
+static void put_bits(Bit_Writer* bw, uint32_t value, int count)
+{
+    bw->bits  |= (uint64_t) value << bw->count;
+    bw->count += count;
+
+    if (bw->count >= 32)
+    {
+        out_u32(bw->out, (uint32_t) bw->bits);
+        bw->bits >>= 32;
+        bw->count -= 32;
+    }
+}
+
+static void align_bits(Bit_Writer* bw)
+{
+    while (bw->count > 0)
+    {
+        unsigned char byte = (unsigned char) bw->bits;
+        out_bytes(bw->out, &byte, 1);
+        bw->bits >>= 8;
+        bw->count -= 8;
+    }
+
+    bw->bits  = 0;
+    bw->count = 0;
+}
+
+typedef struct
+{
+    uint32_t key;
+    uint16_t sym;
+} Sym_Freq;
+
+static int compare_freqs(const void* a, const void* b)
+{
+    const Sym_Freq* fa = (const Sym_Freq*) a;
+    const Sym_Freq* fb = (const Sym_Freq*) b;
+
+    if (fa->key != fb->key)
+        return (fa->key < fb->key) ? -1 : 1;
+
+    return (int) fa->sym - (int) fb->sym;
+}
+
+// Moffat and Katajainen's in place Huffman code lengths. Takes the
+// symbols sorted by frequency and replaces each key with its length.
+static void minimum_redundancy(Sym_Freq* syms, int n)
+{
+    int root = 0, leaf = 2;
+
+    syms[0].key += syms[1].key;
+    for (int next = 1; next < n - 1; next++)
+    {
+        if (leaf >= n || syms[root].key < syms[leaf].key)
+        {
+            syms[next].key = syms[root].key;
+            syms[root++].key = next;
+        }
+        else
+        {
+            syms[next].key = syms[leaf++].key;
+        }
+
+        if (leaf >= n || (root < next && syms[root].key < syms[leaf].key))
+        {
+            syms[next].key += syms[root].key;
+            syms[root++].key = next;
+        }
+        else
+        {
+            syms[next].key += syms[leaf++].key;
+        }
+    }
+
+    syms[n - 2].key = 0;
+    for (int next = n - 3; next >= 0; next--)
+        syms[next].key = syms[syms[next].key].key + 1;
+
+    int avail = 1, used = 0, depth = 0;
+    root = n - 2;
+    int next = n - 1;
+
+    while (avail > 0)
+    {
+        while (root >= 0 && (int) syms[root].key == depth)
+        {
+            used++;
+            root--;
+        }
+
+        while (avail > used)
+        {
+            syms[next--].key = depth;
+            avail--;
+        }
+
+        avail = 2 * used;
+        depth++;
+        used = 0;
+    }
+}
+
+// Code lengths for the given frequencies, none longer than max_bits.
+static void build_lengths(uint32_t* freqs, int num, int max_bits, uint8_t* lengths)
+{
+    Sym_Freq syms[NUM_LITLEN];
+    int used = 0;
+
+    memset(lengths, 0, num);
+    for (int i = 0; i < num; i++)
+    {
+        if (freqs[i])
+        {
+            syms[used].key = freqs[i];
+            syms[used].sym = i;
+            used++;
+        }
+    }
+
+    if (used == 0)
+        return;
+
+    if (used == 1)
+    {
+        lengths[syms[0].sym] = 1;
+        return;
+    }
+
+    qsort(syms, used, sizeof(Sym_Freq), compare_freqs);
+    minimum_redundancy(syms, used);
+
+    int counts[64] = { 0 };
+    for (int i = 0; i < used; i++)
+        counts[(syms[i].key < 63) ? syms[i].key : 63]++;
+
+    // Codes that are too long get moved up to max_bits, which
+    // oversubscribes the tree, so shorter codes get split until
+    // it adds up again.
+    for (int i = max_bits + 1; i < 64; i++)
+    {
+        counts[max_bits] += counts[i];
+        counts[i] = 0;
+    }
+
+    uint32_t total = 0;
+    for (int i = max_bits; i > 0; i--)
+        total += (uint32_t) counts[i] << (max_bits - i);
+
+    while (total != (1u << max_bits))
+    {
+        counts[max_bits]--;
+        for (int i = max_bits - 1; i > 0; i--)
+        {
+            if (counts[i])
+            {
+                counts[i]--;
+                counts[i + 1] += 2;
+                break;
+            }
+        }
+
+        total--;
+    }
+
+    // The most frequent symbols are at the end and get the shortest codes.
+    int j = used;
+    for (int len = 1; len <= max_bits; len++)
+        for (int k = counts[len]; k > 0; k--)
+            lengths[syms[--j].sym] = len;
+}
+
+// Canonical codes, bit reversed since deflate writes them
+// starting from the most significant bit.
+static void build_codes(uint8_t* lengths, int num, uint16_t* codes)
+{
+    int counts[MAX_BITS + 1] = { 0 };
+    uint32_t next[MAX_BITS + 1] = { 0 };
+
+    for (int i = 0; i < num; i++)
+        counts[lengths[i]]++;
+    counts[0] = 0;
+
+    uint32_t code = 0;
+    for (int bits = 1; bits <= MAX_BITS; bits++)
+    {
+        code = (code + counts[bits - 1]) << 1;
+        next[bits] = code;
+    }
+
+    for (int i = 0; i < num; i++)
+    {
+        int len = lengths[i];
+        if (!len)
+            continue;
+
+        uint32_t c = next[len]++, reversed = 0;
+        for (int b = 0; b < len; b++)
+            reversed |= ((c >> b) & 1) << (len - 1 - b);
+
+        codes[i] = (uint16_t) reversed;
+    }
+}
+
+static int length_code(int length)
+{
+    int i = 28;
+    while (length_base[i] > length)
+        i--;
+    return i;
+}
+
+static int dist_code(int dist)
+{
+    int i = 29;
+    while (dist_base[i] > dist)
+        i--;
+    return i;
+}
+
+// Symbols found since the last block was written.
+typedef struct
+{
+    uint16_t litlen[BLOCK_SYMBOLS];
+    uint16_t dist[BLOCK_SYMBOLS];
+    int count;
+
+    uint32_t litlen_freqs[NUM_LITLEN];
+    uint32_t dist_freqs[NUM_DIST];
+
+    size_t start;
+} Block;
+
+static void write_stored(Bit_Writer* bw, unsigned char* data, size_t length, int final)
+{
+    do
+    {
+        size_t chunk = (length > 65535) ? 65535 : length;
+        int last = chunk == length;
+
+        put_bits(bw, final && last, 1);
+        put_bits(bw, 0, 2);
+        align_bits(bw);
+
+        unsigned char header[4] = { chunk, chunk >> 8, ~chunk, (~chunk) >> 8 };
+        out_bytes(bw->out, header, 4);
+        out_bytes(bw->out, data, chunk);
+
+        data   += chunk;
+        length -= chunk;
+    } while (length > 0);
+}
+
+// Writes the block with its own Huffman codes, or stores it
+// as is if that would be smaller.
+static void write_block(Bit_Writer* bw, Block* block, unsigned char* data, size_t end, int final)
+{
+    uint8_t  lit_lengths[NUM_LITLEN], dist_lengths[NUM_DIST], clen_lengths[NUM_CLEN];
+    uint16_t lit_codes[NUM_LITLEN],   dist_codes[NUM_DIST],   clen_codes[NUM_CLEN];
+
+    block->litlen_freqs[END_OF_BLOCK]++;
+    build_lengths(block->litlen_freqs, NUM_LITLEN, MAX_BITS, lit_lengths);
+    build_lengths(block->dist_freqs, NUM_DIST, MAX_BITS, dist_lengths);
+
+    // There always has to be at least one distance code.
+    int num_dist = NUM_DIST;
+    while (num_dist > 1 && dist_lengths[num_dist - 1] == 0)
+        num_dist--;
+
+    if (dist_lengths[0] == 0 && num_dist == 1)
+        dist_lengths[0] = 1;
+
+    int num_lit = NUM_LITLEN;
+    while (num_lit > 257 && lit_lengths[num_lit - 1] == 0)
+        num_lit--;
+
+    build_codes(lit_lengths, NUM_LITLEN, lit_codes);
+    build_codes(dist_lengths, NUM_DIST, dist_codes);
+
+    // Run length encode both sets of lengths together.
+    uint8_t all[NUM_LITLEN + NUM_DIST];
+    memcpy(all, lit_lengths, num_lit);
+    memcpy(all + num_lit, dist_lengths, num_dist);
+
+    uint8_t rle[NUM_LITLEN + NUM_DIST], rle_extra[NUM_LITLEN + NUM_DIST];
+    uint32_t clen_freqs[NUM_CLEN] = { 0 };
+    int num_rle = 0, total = num_lit + num_dist;
+
+    for (int i = 0; i < total;)
+    {
+        int len = all[i], run = 1;
+        while (i + run < total && all[i + run] == len)
+            run++;
+
+        if (len == 0 && run >= 3)
+        {
+            int n = (run > 138) ? 138 : run;
+            rle[num_rle] = (n >= 11) ? 18 : 17;
+            rle_extra[num_rle] = (n >= 11) ? n - 11 : n - 3;
+            clen_freqs[rle[num_rle++]]++;
+            i += n;
+        }
+        else if (len != 0 && run >= 4)
+        {
+            rle[num_rle] = len;
+            rle_extra[num_rle] = 0;
+            clen_freqs[rle[num_rle++]]++;
+
+            int n = (run - 1 > 6) ? 6 : run - 1;
+            rle[num_rle] = 16;
+            rle_extra[num_rle] = n - 3;
+            clen_freqs[rle[num_rle++]]++;
+            i += n + 1;
+        }
+        else
+        {
+            rle[num_rle] = len;
+            rle_extra[num_rle] = 0;
+            clen_freqs[rle[num_rle++]]++;
+            i++;
+        }
+    }
+
+    build_lengths(clen_freqs, NUM_CLEN, MAX_CLEN_BITS, clen_lengths);
+    build_codes(clen_lengths, NUM_CLEN, clen_codes);
+
+    int num_clen = NUM_CLEN;
+    while (num_clen > 4 && clen_lengths[clen_order[num_clen - 1]] == 0)
+        num_clen--;
+
+    // Compare sizes before writing anything.
+    static const int rle_extra_bits[NUM_CLEN] = { [16] = 2, [17] = 3, [18] = 7 };
+    uint64_t bits = 3 + 5 + 5 + 4 + 3 * num_clen;
+
+    for (int i = 0; i < num_rle; i++)
+        bits += clen_lengths[rle[i]] + rle_extra_bits[rle[i]];
+
+    for (int i = 0; i < NUM_LITLEN; i++)
+        bits += (uint64_t) block->litlen_freqs[i] * (lit_lengths[i] + ((i > END_OF_BLOCK) ? length_extra[i - 257] : 0));
+
+    for (int i = 0; i < NUM_DIST; i++)
+        bits += (uint64_t) block->dist_freqs[i] * (dist_lengths[i] + dist_extra[i]);
+
+    size_t raw = end - block->start;
+    uint64_t stored_bits = (raw + 5 * (raw / 65535 + 1)) * 8;
+
+    if (stored_bits < bits)
+    {
+        write_stored(bw, data + block->start, raw, final);
+    }
+    else
+    {
+        put_bits(bw, final, 1);
+        put_bits(bw, 2, 2);
+        put_bits(bw, num_lit - 257, 5);
+        put_bits(bw, num_dist - 1, 5);
+        put_bits(bw, num_clen - 4, 4);
+
+        for (int i = 0; i < num_clen; i++)
+            put_bits(bw, clen_lengths[clen_order[i]], 3);
+
+        for (int i = 0; i < num_rle; i++)
+        {
+            put_bits(bw, clen_codes[rle[i]], clen_lengths[rle[i]]);
+            if (rle_extra_bits[rle[i]])
+                put_bits(bw, rle_extra[i], rle_extra_bits[rle[i]]);
+        }
+
+        for (int i = 0; i < block->count; i++)
+        {
+            int value = block->litlen[i], dist = block->dist[i];
+            if (!dist)
+            {
+                put_bits(bw, lit_codes[value], lit_lengths[value]);
+                continue;
+            }
+
+            int lc = length_code(value);
+            put_bits(bw, lit_codes[257 + lc], lit_lengths[257 + lc]);
+            put_bits(bw, value - length_base[lc], length_extra[lc]);
+
+            int dc = dist_code(dist);
+            put_bits(bw, dist_codes[dc], dist_lengths[dc]);
+            put_bits(bw, dist - dist_base[dc], dist_extra[dc]);
+        }
+
+        put_bits(bw, lit_codes[END_OF_BLOCK], lit_lengths[END_OF_BLOCK]);
+    }
+
+    block->count = 0;
+    block->start = end;
+    memset(block->litlen_freqs, 0, sizeof(block->litlen_freqs));
+    memset(block->dist_freqs, 0, sizeof(block->dist_freqs));
+}
+
+typedef struct
+{
+    unsigned char* data;
+    size_t length;
+    int* head;
+    int* prev;
+    int chain;
+    int nice;
+} Matcher;
+
+static uint32_t hash3(unsigned char* p)
+{
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void insert(Matcher* m, size_t pos)
+{
+    if (pos + MIN_MATCH > m->length)
+        return;
+
+    uint32_t h = hash3(m->data + pos);
+    m->prev[pos & WINDOW_MASK] = m->head[h];
+    m->head[h] = (int) pos;
+}
+
+// Longest earlier match for the bytes at pos, 0 if there isn't one.
+static int find_match(Matcher* m, size_t pos, int* match_dist)
+{
+    if (pos + MIN_MATCH > m->length)
+        return 0;
+
+    unsigned char* cur = m->data + pos;
+    size_t max_len = m->length - pos;
+    if (max_len > MAX_MATCH)
+        max_len = MAX_MATCH;
+
+    long long limit = (long long) pos - WINDOW_SIZE;
+    int best = 0, chain = m->chain;
+    int candidate = m->head[hash3(cur)];
+
+    while (candidate >= 0 && candidate > limit && chain-- > 0)
+    {
+        unsigned char* prev = m->data + candidate;
+
+        if (prev[best] == cur[best] && prev[0] == cur[0] && prev[1] == cur[1])
+        {
+            int len = 2;
+            while (len < (int) max_len && prev[len] == cur[len])
+                len++;
+
+            if (len > best)
+            {
+                best = len;
+                *match_dist = (int) (pos - candidate);
+
+                if (len >= m->nice || len == (int) max_len)
+                    break;
+            }
+        }
+
+        int next = m->prev[candidate & WINDOW_MASK];
+        if (next >= candidate)
+            break;
+
+        candidate = next;
+    }
+
+    return (best >= MIN_MATCH) ? best : 0;
+}
+
+static void add_literal(Bit_Writer* bw, Block* block, unsigned char* data, size_t pos)
+{
+    block->litlen[block->count] = data[pos];
+    block->dist[block->count] = 0;
+    block->litlen_freqs[data[pos]]++;
+    block->count++;
+
+    if (block->count == BLOCK_SYMBOLS)
+        write_block(bw, block, data, pos + 1, 0);
+}
+
+static void add_match(Bit_Writer* bw, Block* block, unsigned char* data, size_t pos, int len, int dist)
+{
+    block->litlen[block->count] = len;
+    block->dist[block->count] = dist;
+    block->litlen_freqs[257 + length_code(len)]++;
+    block->dist_freqs[dist_code(dist)]++;
+    block->count++;
+
+    if (block->count == BLOCK_SYMBOLS)
+        write_block(bw, block, data, pos + len, 0);
+}
+
+Compressed gzip_compress(char* data, size_t length, int level)
+{
+    if (level < 1)
+        level = 1;
+    if (level > COMPRESS_MAX_LEVEL)
+        level = COMPRESS_MAX_LEVEL;
+
+    Compressed out = { 0 };
+    out_reserve(&out, length / 4 + 64);
+
+    // Deflate, no flags, no mtime, unix
+    static const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+    out_bytes(&out, header, sizeof(header));
+
+    Block* block = (Block*) calloc(1, sizeof(Block));
+    hd_assert(block != NULL);
+
+    Matcher m = { (unsigned char*) data, length };
+    m.head  = (int*) malloc(HASH_SIZE * sizeof(int));
+    m.prev  = (int*) malloc(WINDOW_SIZE * sizeof(int));
+    m.chain = level_chain[level];
+    m.nice  = level_nice[level];
+    hd_assert(m.head != NULL && m.prev != NULL);
+    memset(m.head, 0xff, HASH_SIZE * sizeof(int));
+
+    Bit_Writer bw = { &out, 0, 0 };
+    int lazy = level >= 4;
+    size_t pos = 0;
+
+    while (pos < length)
+    {
+        int dist = 0;
+        int len = find_match(&m, pos, &dist);
+
+        // A longer match one byte later is worth a literal.
+        if (lazy && len && len < m.nice)
+        {
+            int next_dist = 0;
+            insert(&m, pos);
+            int next_len = find_match(&m, pos + 1, &next_dist);
+
+            if (next_len > len)
+            {
+                add_literal(&bw, block, m.data, pos);
+                pos++;
+                len  = next_len;
+                dist = next_dist;
+                insert(&m, pos);
+            }
+
+            add_match(&bw, block, m.data, pos, len, dist);
+            for (int i = 1; i < len; i++)
+                insert(&m, pos + i);
+
+            pos += len;
+            continue;
+        }
+
+        insert(&m, pos);
+
+        if (len)
+        {
+            add_match(&bw, block, m.data, pos, len, dist);
+            for (int i = 1; i < len; i++)
+                insert(&m, pos + i);
+
+            pos += len;
+        }
+        else
+        {
+            add_literal(&bw, block, m.data, pos);
+            pos++;
+        }
+    }
+
+    write_block(&bw, block, m.data, length, 1);
+    align_bits(&bw);
+
+    out_u32(&out, crc32(m.data, length));
+    out_u32(&out, (uint32_t) length);
+
+    free(block);
+    free(m.head);
+    free(m.prev);
+    return out;
+}
+
+#ifdef SWG_BROTLI
+Compressed brotli_compress(char* data, size_t length, int level)
+{
+    Compressed out = { 0 };
+
+    size_t size = BrotliEncoderMaxCompressedSize(length);
+    if (size == 0)
+        size = length + 1024;
+
+    out.data = (char*) malloc(size);
+    out.cap  = size;
+    hd_assert(out.data != NULL);
+
+    int quality = (level + 2 > BROTLI_MAX_QUALITY) ? BROTLI_MAX_QUALITY : level + 2;
+    if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, length,
+                               (const uint8_t*) data, &size, (uint8_t*) out.data))
+    {
+        compressed_free(&out);
+        return out;
+    }
+
+    out.length = size;
+    return out;
+}
+#endif
+
+void compressed_free(Compressed* compressed)
+{
+    if (compressed->data)
+        free(compressed->data);
+
+    compressed->data = NULL;
+    compressed->length = compressed->cap = 0;
+}
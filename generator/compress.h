@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+#define COMPRESS_DEFAULT_LEVEL 6
+#define COMPRESS_MAX_LEVEL     9
+
+typedef struct
+{
+    char*  data;
+    size_t length;
+    size_t cap;
+} Compressed;
+
+/*
+    Small deflate encoder so precompressed pages don't need zlib.
+    Matches are found with hash chains that get searched further
+    the higher the level (1 to 9) and every block gets its own
+    Huffman codes, falling back to storing data that won't shrink.
+*/
+Compressed gzip_compress(char* data, size_t length, int level);
+
+#ifdef SWG_BROTLI
+// Needs libbrotlienc. Levels 1 to 9 map onto brotli's qualities 3 to 11.
+Compressed brotli_compress(char* data, size_t length, int level);
+#endif
+
+void compressed_free(Compressed* compressed);
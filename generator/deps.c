@@ -0,0 +1,353 @@
+#include "deps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "filestuff.h"
+#include "containers/hd_assert.h"
+
+#define MANIFEST_HEADER "swg-manifest 3"
+
+void dep_key(char* key, char* kind, String owner, char* field)
+{
+    if (!owner)
+        snprintf(key, DEP_KEY_SIZE, "%s", kind);
+    else if (!field)
+        snprintf(key, DEP_KEY_SIZE, "%s:%s", kind, owner);
+    else
+        snprintf(key, DEP_KEY_SIZE, "%s:%s.%s", kind, owner, field);
+}
+
+static uint64_t hash_string(String str)
+{
+    // Missing values shouldn't hash the same as empty ones
+    if (!str)
+        return hash_bytes("", 0, 1);
+
+    return hash_bytes(str, strlen(str), 0);
+}
+
+static void hash_update_string(Hash_State* state, String str)
+{
+    if (str)
+        hash_update(state, str, strlen(str) + 1);
+    else
+        hash_update(state, "\x01", 1);
+}
+
+static uint64_t hash_string_list(DArray(String) list)
+{
+    Hash_State state;
+    hash_begin(&state, 0);
+
+    da_foreach(String, str, list)
+        hash_update_string(&state, *str);
+
+    return hash_end(&state);
+}
+
+static void hash_update_project(Hash_State* state, Project* pj)
+{
+    hash_update_string(state, pj->name);
+    hash_update_string(state, pj->date);
+    hash_update_string(state, pj->link);
+    hash_update_string(state, pj->description);
+
+    hash_update(state, "\x02", 1);
+    da_foreach(String, skill, pj->skills)
+        hash_update_string(state, *skill);
+
+    hash_update(state, "\x02", 1);
+    da_foreach(String, image, pj->images)
+        hash_update_string(state, *image);
+}
+
+static uint64_t hash_projects(DArray(Project) projects)
+{
+    Hash_State state;
+    hash_begin(&state, 0);
+
+    da_foreach(Project, pj, projects)
+        hash_update_project(&state, pj);
+
+    return hash_end(&state);
+}
+
+static void put_input(Input_Hashes* inputs, char* kind, String owner, char* field, uint64_t hash)
+{
+    char key[DEP_KEY_SIZE];
+    dep_key(key, kind, owner, field);
+    dict_put((*inputs), key, hash);
+}
+
+void inputs_add_persona(Input_Hashes* inputs, Persona persona)
+{
+    put_input(inputs, "persona", persona.name, "name",      hash_string(persona.name));
+    put_input(inputs, "persona", persona.name, "color",     hash_string(persona.color));
+    put_input(inputs, "persona", persona.name, "image",     hash_string(persona.image));
+    put_input(inputs, "persona", persona.name, "icon",      hash_string(persona.icon));
+    put_input(inputs, "persona", persona.name, "blurb",     hash_string(persona.blurb));
+    put_input(inputs, "persona", persona.name, "abilities", hash_string_list(persona.abilities));
+    put_input(inputs, "persona", persona.name, "projects",  hash_projects(persona.projects));
+}
+
+// Projects are named by their page so projects with the same name
+// don't share a key. Only projects that have a page can be added.
+void inputs_add_project(Input_Hashes* inputs, Project project)
+{
+    Hash_State state;
+    hash_begin(&state, 0);
+    hash_update_project(&state, &project);
+
+    put_input(inputs, "project", project.page, NULL, hash_end(&state));
+}
+
+void inputs_add_link(Input_Hashes* inputs, Link link)
+{
+    put_input(inputs, "link", link.name, "name",  hash_string(link.name));
+    put_input(inputs, "link", link.name, "link",  hash_string(link.link));
+    put_input(inputs, "link", link.name, "icon",  hash_string(link.icon));
+    put_input(inputs, "link", link.name, "color", hash_string(link.color));
+}
+
+// Skills are named by their page like projects. A skill changes if
+// its name does or if it's used by different projects.
+void inputs_add_skills(Input_Hashes* inputs, Skill_Map* map, Portfolio portfolio)
+{
+    Hash_State list_state;
+    hash_begin(&list_state, 0);
+
+    da_foreach(Skill, skill, map->skills)
+    {
+        hash_update_string(&list_state, skill->name);
+        hash_update_string(&list_state, skill->page);
+
+        Hash_State state;
+        hash_begin(&state, 0);
+        hash_update_string(&state, skill->name);
+
+        da_foreach(Project_Ref, ref, skill->projects)
+            hash_update_string(&state, portfolio.personas[ref->persona].projects[ref->project].page);
+
+        put_input(inputs, "skill", skill->page, NULL, hash_end(&state));
+    }
+
+    put_input(inputs, "skills", NULL, NULL, hash_end(&list_state));
+}
+
+void inputs_add_lists(Input_Hashes* inputs, Portfolio portfolio)
+{
+    Hash_State state;
+
+    hash_begin(&state, 0);
+    da_foreach(Persona, persona, portfolio.personas)
+        hash_update_string(&state, persona->name);
+    put_input(inputs, "personas", NULL, NULL, hash_end(&state));
+
+    hash_begin(&state, 0);
+    da_foreach(Link, link, portfolio.links)
+        hash_update_string(&state, link->name);
+    put_input(inputs, "links", NULL, NULL, hash_end(&state));
+}
+
+void inputs_add_template(Input_Hashes* inputs, String path, String content)
+{
+    put_input(inputs, "template", path, NULL, hash_string(content));
+}
+
+void inputs_add_option(Input_Hashes* inputs, char* name, uint64_t value)
+{
+    put_input(inputs, "option", name, NULL, hash_bytes(&value, sizeof(value), 0));
+}
+
+void inputs_add_asset(Input_Hashes* inputs, String path, uint64_t hash)
+{
+    put_input(inputs, "asset", path, NULL, hash);
+}
+
+// Keys that don't exist (like unknown properties) all get the
+// same hash so they don't make a page look changed every run.
+uint64_t inputs_get(Input_Hashes* inputs, String key)
+{
+    Dict_Bkt(uint64_t) bkt = dict_find((*inputs), key);
+    if (bkt == dict_end((*inputs)))
+        return 0;
+
+    return bkt->value;
+}
+
+void inputs_free(Input_Hashes* inputs)
+{
+    dict_foreach(uint64_t, bkt, (*inputs))
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free((*inputs));
+}
+
+Manifest manifest_make()
+{
+    Manifest m = { 0 };
+    da_make(m.pages);
+    dict_make(m.index);
+    return m;
+}
+
+static void manifest_page_free(Manifest_Page* page)
+{
+    string_free(&page->path);
+
+    da_foreach(Manifest_Dep, dep, page->deps)
+        string_free(&dep->key);
+    da_free(page->deps);
+}
+
+void manifest_free(Manifest* manifest)
+{
+    da_foreach(Manifest_Page, page, manifest->pages)
+        manifest_page_free(page);
+    da_free(manifest->pages);
+
+    dict_foreach(int, bkt, manifest->index)
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free(manifest->index);
+}
+
+// Returns the index of the page since pushing more
+// pages can move the existing ones.
+static int push_page(Manifest* manifest, String path, uint64_t hash)
+{
+    Manifest_Page page = { string_make(path), hash, NULL };
+    da_make(page.deps);
+
+    int page_index = da_size(manifest->pages);
+    da_push_back(manifest->pages, page);
+    dict_put(manifest->index, path, page_index);
+
+    return page_index;
+}
+
+// A missing or broken manifest just means every page is out of date.
+Manifest manifest_load(String filepath)
+{
+    Manifest manifest = manifest_make();
+
+    String contents = load_file(filepath);
+    if (!contents)
+        return manifest;
+
+    char* line = contents;
+    if (strncmp(line, MANIFEST_HEADER "\n", sizeof(MANIFEST_HEADER)) != 0)
+    {
+        string_free(&contents);
+        return manifest;
+    }
+
+    int page = -1;
+    while (*line)
+    {
+        char* end = strchr(line, '\n');
+        if (!end)
+            break;
+
+        *end = '\0';
+
+        if (strncmp(line, "page ", 5) == 0)
+        {
+            char* path = NULL;
+            uint64_t hash = strtoull(line + 5, &path, 16);
+
+            page = (*path == ' ') ? push_page(&manifest, path + 1, hash) : -1;
+        }
+        else if (page >= 0 && strncmp(line, "dep ", 4) == 0)
+        {
+            char* key = NULL;
+            Manifest_Dep dep = { 0 };
+            dep.hash = strtoull(line + 4, &key, 16);
+
+            if (*key == ' ')
+            {
+                dep.key = string_make(key + 1);
+                da_push_back(manifest.pages[page].deps, dep);
+            }
+        }
+
+        line = end + 1;
+    }
+
+    string_free(&contents);
+    return manifest;
+}
+
+int manifest_save(Manifest* manifest, String filepath)
+{
+    FILE* file = fopen(filepath, "wb");
+    if (!file)
+        return 0;
+
+    fprintf(file, MANIFEST_HEADER "\n");
+
+    da_foreach(Manifest_Page, page, manifest->pages)
+    {
+        fprintf(file, "page %016llx %s\n", (unsigned long long) page->hash, page->path);
+
+        da_foreach(Manifest_Dep, dep, page->deps)
+            fprintf(file, "dep %016llx %s\n", (unsigned long long) dep->hash, dep->key);
+    }
+
+    fclose(file);
+    return 1;
+}
+
+Manifest_Page* manifest_find(Manifest* manifest, String path)
+{
+    Dict_Bkt(int) bkt = dict_find(manifest->index, path);
+    if (bkt == dict_end(manifest->index))
+        return NULL;
+
+    return manifest->pages + bkt->value;
+}
+
+void manifest_add_page(Manifest* manifest, String path, uint64_t hash, DArray(String) keys, Input_Hashes* inputs)
+{
+    int index = push_page(manifest, path, hash);
+    Manifest_Page* page = manifest->pages + index;
+
+    if (!keys)
+        return;
+
+    da_foreach(String, key, keys)
+    {
+        Manifest_Dep dep = { string_make(*key), inputs_get(inputs, *key) };
+        da_push_back(page->deps, dep);
+    }
+}
+
+void manifest_copy_page(Manifest* manifest, Manifest_Page* page)
+{
+    int index = push_page(manifest, page->path, page->hash);
+    Manifest_Page* copy = manifest->pages + index;
+
+    da_foreach(Manifest_Dep, dep, page->deps)
+    {
+        Manifest_Dep dep_copy = { string_make(dep->key), dep->hash };
+        da_push_back(copy->deps, dep_copy);
+    }
+}
+
+// Pages always depend on their template so a page without any
+// deps came from a run that wasn't incremental.
+int manifest_page_is_clean(Manifest_Page* page, Input_Hashes* inputs)
+{
+    if (da_size(page->deps) == 0)
+        return 0;
+
+    da_foreach(Manifest_Dep, dep, page->deps)
+    {
+        if (inputs_get(inputs, dep->key) != dep->hash)
+            return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include "portfolio.h"
+#include "skills.h"
+#include "containers/string.h"
+#include "containers/darray.h"
+#include "containers/dictionary.h"
+
+/*
+    Inputs a page can read are named with keys like:
+        persona:<name>.<field>
+        link:<name>.<field>
+        project:<page>            (everything about the project with that page)
+        skill:<page>              (the skill's name and which projects have it)
+        personas, links, skills   (which items are in the lists and their order)
+        template:<path>
+        option:<name>             (build options that change the output)
+        asset:<path>              (contents of a file that got fingerprinted)
+    Every key maps to a hash of its current value. A page only
+    needs to be generated again if one of the keys it read has a
+    different hash than it did on the last run.
+*/
+
+#define DEP_KEY_SIZE 512
+
+typedef Dict(uint64_t) Input_Hashes;
+
+void dep_key(char* key, char* kind, String owner, char* field);
+
+void     inputs_add_persona(Input_Hashes* inputs, Persona persona);
+void     inputs_add_project(Input_Hashes* inputs, Project project);
+void     inputs_add_link(Input_Hashes* inputs, Link link);
+void     inputs_add_lists(Input_Hashes* inputs, Portfolio portfolio);
+void     inputs_add_skills(Input_Hashes* inputs, Skill_Map* map, Portfolio portfolio);
+void     inputs_add_template(Input_Hashes* inputs, String path, String content);
+void     inputs_add_option(Input_Hashes* inputs, char* name, uint64_t value);
+void     inputs_add_asset(Input_Hashes* inputs, String path, uint64_t hash);
+uint64_t inputs_get(Input_Hashes* inputs, String key);
+void     inputs_free(Input_Hashes* inputs);
+
+typedef struct
+{
+    String key;
+    uint64_t hash;
+} Manifest_Dep;
+
+// The hash is of the page's output. Deps are only
+// recorded by incremental builds.
+typedef struct
+{
+    String path;
+    uint64_t hash;
+    DArray(Manifest_Dep) deps;
+} Manifest_Page;
+
+// Pages are stored relative to the output directory.
+typedef struct
+{
+    DArray(Manifest_Page) pages;
+    Dict(int) index;
+} Manifest;
+
+Manifest manifest_make();
+void     manifest_free(Manifest* manifest);
+Manifest manifest_load(String filepath);
+int      manifest_save(Manifest* manifest, String filepath);
+
+Manifest_Page* manifest_find(Manifest* manifest, String path);
+void manifest_add_page(Manifest* manifest, String path, uint64_t hash, DArray(String) keys, Input_Hashes* inputs);
+void manifest_copy_page(Manifest* manifest, Manifest_Page* page);
+int  manifest_page_is_clean(Manifest_Page* page, Input_Hashes* inputs);
@@ -0,0 +1,340 @@
+#include "escape.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ESCAPE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define ESCAPE_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static char lower(char ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+static int is_letter(char ch)
+{
+    ch = lower(ch);
+    return ch >= 'a' && ch <= 'z';
+}
+
+static int is_ws(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\f';
+}
+
+Html_Scanner html_scanner_make()
+{
+    Html_Scanner scanner = { 0 };
+    scanner.state = HTML_TEXT;
+    return scanner;
+}
+
+static void end_tag(Html_Scanner* scanner)
+{
+    scanner->tag[scanner->tag_length] = '\0';
+
+    if (!scanner->closing &&
+        (strcmp(scanner->tag, "script") == 0 || strcmp(scanner->tag, "style") == 0))
+    {
+        strcpy(scanner->raw, scanner->tag);
+        scanner->state = HTML_RAW;
+        return;
+    }
+
+    scanner->state = HTML_TEXT;
+}
+
+static void feed_char(Html_Scanner* scanner, char ch)
+{
+    switch (scanner->state)
+    {
+        case HTML_TEXT:
+        {
+            if (ch == '<')
+                scanner->state = HTML_LT;
+        } break;
+
+        case HTML_LT:
+        {
+            scanner->tag_length = 0;
+            scanner->closing = ch == '/';
+
+            if (ch == '!')
+                scanner->state = HTML_BANG;
+            else if (ch == '/')
+                scanner->state = HTML_TAG_NAME;
+            else if (is_letter(ch))
+            {
+                scanner->tag[scanner->tag_length++] = lower(ch);
+                scanner->state = HTML_TAG_NAME;
+            }
+            else if (ch != '<')
+                scanner->state = HTML_TEXT;
+        } break;
+
+        case HTML_BANG:
+        {
+            if (ch == '-')
+                scanner->state = HTML_BANG_DASH;
+            else
+                scanner->state = (ch == '>') ? HTML_TEXT : HTML_TAG;
+        } break;
+
+        case HTML_BANG_DASH:
+        {
+            scanner->dashes = 0;
+
+            if (ch == '-')
+                scanner->state = HTML_COMMENT;
+            else
+                scanner->state = (ch == '>') ? HTML_TEXT : HTML_TAG;
+        } break;
+
+        case HTML_COMMENT:
+        {
+            if (ch == '-')
+            {
+                scanner->dashes++;
+                break;
+            }
+
+            if (ch == '>' && scanner->dashes >= 2)
+                scanner->state = HTML_TEXT;
+
+            scanner->dashes = 0;
+        } break;
+
+        case HTML_TAG_NAME:
+        {
+            if (is_letter(ch) || (ch >= '0' && ch <= '9'))
+            {
+                if (scanner->tag_length + 1 < HTML_TAG_SIZE)
+                    scanner->tag[scanner->tag_length++] = lower(ch);
+
+                break;
+            }
+
+            scanner->state = HTML_TAG;
+            feed_char(scanner, ch);
+        } break;
+
+        case HTML_TAG:
+        {
+            if (ch == '"' || ch == '\'')
+            {
+                scanner->quote = ch;
+                scanner->state = HTML_QUOTED;
+            }
+            else if (ch == '>')
+            {
+                end_tag(scanner);
+            }
+        } break;
+
+        case HTML_QUOTED:
+        {
+            if (ch == scanner->quote)
+                scanner->state = HTML_TAG;
+        } break;
+
+        case HTML_RAW:
+        {
+            if (ch == '<')
+                scanner->state = HTML_RAW_LT;
+        } break;
+
+        case HTML_RAW_LT:
+        {
+            scanner->matched = 0;
+
+            if (ch == '/')
+                scanner->state = HTML_RAW_END;
+            else if (ch != '<')
+                scanner->state = HTML_RAW;
+        } break;
+
+        // Only the end tag of the element gets out of raw text.
+        case HTML_RAW_END:
+        {
+            int raw_length = (int) strlen(scanner->raw);
+
+            if (scanner->matched < raw_length && lower(ch) == scanner->raw[scanner->matched])
+            {
+                scanner->matched++;
+            }
+            else if (scanner->matched == raw_length && (is_ws(ch) || ch == '>' || ch == '/'))
+            {
+                scanner->closing = 1;
+                scanner->tag_length = 0;
+                scanner->state = HTML_TAG;
+                feed_char(scanner, ch);
+            }
+            else
+            {
+                scanner->state = HTML_RAW;
+                feed_char(scanner, ch);
+            }
+        } break;
+    }
+}
+
+void html_scanner_feed(Html_Scanner* scanner, char* html, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+        feed_char(scanner, html[i]);
+}
+
+// Anywhere that isn't plain text or raw text gets the stricter
+// attribute escaping, including unquoted values.
+Escape_Context html_scanner_context(Html_Scanner* scanner)
+{
+    switch (scanner->state)
+    {
+        case HTML_TEXT:
+        case HTML_COMMENT:
+            return ESCAPE_TEXT;
+
+        case HTML_RAW:
+        case HTML_RAW_LT:
+        case HTML_RAW_END:
+            return ESCAPE_NONE;
+
+        default:
+            return ESCAPE_ATTRIBUTE;
+    }
+}
+
+static int needs_escape(char ch, int attribute)
+{
+    return ch == '&' || ch == '<' || ch == '>' ||
+           (attribute && (ch == '"' || ch == '\''));
+}
+
+#if defined(ESCAPE_SSE2) || defined(ESCAPE_AVX2)
+static int first_bit(unsigned int mask)
+{
+    #ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int) index;
+    #else
+    return __builtin_ctz(mask);
+    #endif
+}
+#endif
+
+// Returns the offset of the first byte that has to be escaped,
+// or length if there isn't one. In text the quotes are checked
+// against & again, which doesn't find anything new.
+static size_t find_special(char* str, size_t length, int attribute)
+{
+    size_t i = 0;
+    char quote      = (attribute) ? '"'  : '&';
+    char apostrophe = (attribute) ? '\'' : '&';
+
+    #ifdef ESCAPE_AVX2
+    {
+        __m256i amp  = _mm256_set1_epi8('&');
+        __m256i lt   = _mm256_set1_epi8('<');
+        __m256i gt   = _mm256_set1_epi8('>');
+        __m256i quot = _mm256_set1_epi8(quote);
+        __m256i apos = _mm256_set1_epi8(apostrophe);
+
+        for (; i + 32 <= length; i += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256((__m256i*) (str + i));
+            __m256i found = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, amp),
+                                                            _mm256_cmpeq_epi8(chunk, lt)),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, gt),
+                                                            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quot),
+                                                                            _mm256_cmpeq_epi8(chunk, apos))));
+
+            unsigned int mask = (unsigned int) _mm256_movemask_epi8(found);
+            if (mask)
+                return i + first_bit(mask);
+        }
+    }
+    #endif
+
+    #ifdef ESCAPE_SSE2
+    {
+        __m128i amp  = _mm_set1_epi8('&');
+        __m128i lt   = _mm_set1_epi8('<');
+        __m128i gt   = _mm_set1_epi8('>');
+        __m128i quot = _mm_set1_epi8(quote);
+        __m128i apos = _mm_set1_epi8(apostrophe);
+
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128((__m128i*) (str + i));
+            __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, amp),
+                                                      _mm_cmpeq_epi8(chunk, lt)),
+                                         _mm_or_si128(_mm_cmpeq_epi8(chunk, gt),
+                                                      _mm_or_si128(_mm_cmpeq_epi8(chunk, quot),
+                                                                   _mm_cmpeq_epi8(chunk, apos))));
+
+            unsigned int mask = (unsigned int) _mm_movemask_epi8(found);
+            if (mask)
+                return i + first_bit(mask);
+        }
+    }
+    #endif
+
+    for (; i < length; i++)
+        if (needs_escape(str[i], attribute))
+            return i;
+
+    return length;
+}
+
+static char* entity(char ch)
+{
+    switch (ch)
+    {
+        case '&':  return "&amp;";
+        case '<':  return "&lt;";
+        case '>':  return "&gt;";
+        case '"':  return "&quot;";
+        case '\'': return "&#39;";
+    }
+
+    return "";
+}
+
+void escape_html(char* str, size_t length, Escape_Context context, Escape_Output output, void* data)
+{
+    if (context == ESCAPE_NONE)
+    {
+        if (length > 0)
+            output(data, str, length);
+
+        return;
+    }
+
+    int attribute = context == ESCAPE_ATTRIBUTE;
+    size_t start = 0;
+
+    while (start < length)
+    {
+        size_t next = start + find_special(str + start, length - start, attribute);
+        if (next > start)
+            output(data, str + start, next - start);
+
+        if (next == length)
+            break;
+
+        char* replacement = entity(str[next]);
+        output(data, replacement, strlen(replacement));
+        start = next + 1;
+    }
+}
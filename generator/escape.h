@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+
+typedef enum
+{
+    // Inside <script> and <style>, where entities mean nothing.
+    ESCAPE_NONE,
+
+    // Between tags. &, < and > are escaped.
+    ESCAPE_TEXT,
+
+    // Inside a tag, usually in an attribute value. Quotes
+    // are escaped as well.
+    ESCAPE_ATTRIBUTE
+} Escape_Context;
+
+typedef enum
+{
+    HTML_TEXT,
+    HTML_LT,
+    HTML_BANG,
+    HTML_BANG_DASH,
+    HTML_COMMENT,
+    HTML_TAG_NAME,
+    HTML_TAG,
+    HTML_QUOTED,
+    HTML_RAW,
+    HTML_RAW_LT,
+    HTML_RAW_END
+} Html_State;
+
+// Longest tag name that's looked at, enough for script and style.
+#define HTML_TAG_SIZE 8
+
+/*
+    Follows the html of a template as it's parsed to find out what
+    context each property ends up in. Only as much of HTML as it
+    takes to tell text, tags and raw text elements apart.
+*/
+typedef struct
+{
+    Html_State state;
+    char quote;
+    int dashes;
+
+    // Name of the tag being read and of the raw text
+    // element (script or style) the scanner is in.
+    char tag[HTML_TAG_SIZE];
+    int tag_length;
+    int closing;
+    char raw[HTML_TAG_SIZE];
+    int matched;
+} Html_Scanner;
+
+Html_Scanner html_scanner_make();
+void html_scanner_feed(Html_Scanner* scanner, char* html, size_t length);
+Escape_Context html_scanner_context(Html_Scanner* scanner);
+
+typedef void (*Escape_Output)(void* data, char* chunk, size_t length);
+
+// Passes runs of text that don't need escaping to output as they
+// are and entities for the rest. Entities are static strings so
+// the output can point into them. Runs are found 16 (or 32 with
+// AVX2) bytes at a time where SSE2 is available.
+void escape_html(char* str, size_t length, Escape_Context context, Escape_Output output, void* data);
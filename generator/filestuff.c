@@ -1,8 +1,36 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For copy_file_range
+#endif
+
 #include "filestuff.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include "containers/hd_assert.h"
 #include "containers/string.h"
+#include "containers/darray.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#endif
+
+#define FILE_CHUNK_SIZE (64 * 1024)
 
 String load_file(const String filepath)
 {
@@ -25,6 +53,16 @@ String load_file(const String filepath)
     return contents;
 }
 
+int file_exists(const String filepath)
+{
+    FILE* file = fopen(filepath, "rb");
+    if (!file)
+        return 0;
+
+    fclose(file);
+    return 1;
+}
+
 int write_file(const String filepath, String contents)
 {
     FILE* file = fopen(filepath, "wb");
@@ -35,4 +73,379 @@ int write_file(const String filepath, String contents)
 
     fclose(file);
     return 1;
-}
\ No newline at end of file
+}
+
+int write_file_bytes(const String filepath, char* data, size_t length)
+{
+    FILE* file = fopen(filepath, "wb");
+    if (!file)
+        return 0;
+
+    size_t written = fwrite(data, 1, length, file);
+
+    fclose(file);
+    return written == length;
+}
+
+#ifdef _WIN32
+
+int write_segments(const String filepath, Segment* segments, size_t num_segments)
+{
+    FILE* file = fopen(filepath, "wb");
+    if (!file)
+        return 0;
+
+    int res = 1;
+    for (size_t i = 0; i < num_segments; i++)
+    {
+        if (fwrite(segments[i].data, sizeof(char), segments[i].length, file) != segments[i].length)
+        {
+            res = 0;
+            break;
+        }
+    }
+
+    fclose(file);
+    return res;
+}
+
+#else
+
+// Number of segments handed to a single writev call.
+#define WRITEV_BATCH 1024
+
+int write_segments(const String filepath, Segment* segments, size_t num_segments)
+{
+    int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return 0;
+
+    struct iovec iov[WRITEV_BATCH];
+    size_t next = 0;
+    int res = 1;
+
+    while (res && next < num_segments)
+    {
+        int count = 0;
+        while (count < WRITEV_BATCH && next < num_segments)
+        {
+            iov[count].iov_base = segments[next].data;
+            iov[count].iov_len  = segments[next].length;
+            count++;
+            next++;
+        }
+
+        // writev is allowed to stop short so keep going
+        // from wherever it left off.
+        struct iovec* cur = iov;
+        while (count > 0)
+        {
+            ssize_t written = writev(fd, cur, count);
+            if (written < 0 && errno == EINTR)
+                continue;
+
+            if (written < 0)
+            {
+                res = 0;
+                break;
+            }
+
+            while (count > 0 && (size_t) written >= cur->iov_len)
+            {
+                written -= cur->iov_len;
+                cur++;
+                count--;
+            }
+
+            if (count > 0)
+            {
+                cur->iov_base = (char*) cur->iov_base + written;
+                cur->iov_len -= written;
+            }
+        }
+    }
+
+    close(fd);
+    return res;
+}
+
+#undef WRITEV_BATCH
+
+#endif // _WIN32
+
+int write_file_segments(const String filepath, DArray(Segment) segments)
+{
+    return write_segments(filepath, segments, da_size(segments));
+}
+
+// Moves a file over another one, replacing it if it exists.
+int replace_file(const String from, const String to)
+{
+    #ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+    #else
+    return rename(from, to) == 0;
+    #endif
+}
+
+int remove_file(const String filepath)
+{
+    return remove(filepath) == 0;
+}
+
+// Hashes a file without reading all of it into memory.
+int hash_file(const String filepath, uint64_t* hash)
+{
+    FILE* file = fopen(filepath, "rb");
+    if (!file)
+        return 0;
+
+    char buffer[FILE_CHUNK_SIZE];
+    Hash_State state;
+    hash_begin(&state, 0);
+
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        hash_update(&state, buffer, count);
+
+    int res = !ferror(file);
+    fclose(file);
+
+    *hash = hash_end(&state);
+    return res;
+}
+
+// Creates every directory leading up to a file.
+int make_dirs(const String filepath)
+{
+    char path[1024];
+    size_t length = strlen(filepath);
+    if (length >= sizeof(path))
+        return 0;
+
+    memcpy(path, filepath, length + 1);
+
+    for (size_t i = 1; i < length; i++)
+    {
+        char separator = path[i];
+        if (separator != '/' && separator != '\\')
+            continue;
+
+        path[i] = '\0';
+
+        #ifdef _WIN32
+        int res = _mkdir(path) == 0 || errno == EEXIST;
+        #else
+        int res = mkdir(path, 0755) == 0 || errno == EEXIST;
+        #endif
+
+        path[i] = separator;
+        if (!res)
+            return 0;
+    }
+
+    return 1;
+}
+
+int file_open_for_write(const String filepath)
+{
+    #ifdef _WIN32
+    return _open(filepath, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    #else
+    return open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    #endif
+}
+
+void file_close(int fd)
+{
+    #ifdef _WIN32
+    _close(fd);
+    #else
+    close(fd);
+    #endif
+}
+
+// Pipes and sockets can be non-blocking, in which case this waits
+// until they can take more instead of giving up.
+static int write_all(int fd, char* data, size_t length)
+{
+    while (length > 0)
+    {
+        #ifdef _WIN32
+        int written = _write(fd, data, (unsigned int) length);
+        #else
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+                return 0;
+
+            continue;
+        }
+        #endif
+
+        // Nothing written for a non-empty write means the file can't
+        // take any more, trying again would never finish.
+        if (written <= 0)
+            return 0;
+
+        data   += written;
+        length -= written;
+    }
+
+    return 1;
+}
+
+Stream stream_make(int fd, size_t cap)
+{
+    Stream s = { 0 };
+    s.fd     = fd;
+    s.cap    = cap;
+    s.buffer = (char*) malloc(cap);
+    hd_assert(s.buffer != NULL);
+    hash_begin(&s.hash, 0);
+    return s;
+}
+
+void stream_free(Stream* stream)
+{
+    if (stream->buffer)
+        free(stream->buffer);
+
+    stream->buffer = NULL;
+    stream->cap = stream->used = 0;
+}
+
+// Reuses the buffer for another file descriptor.
+void stream_attach(Stream* stream, int fd)
+{
+    stream->fd      = fd;
+    stream->used    = 0;
+    stream->written = 0;
+    stream->failed  = 0;
+    hash_begin(&stream->hash, 0);
+}
+
+void stream_write(Stream* stream, char* data, size_t length)
+{
+    if (stream->failed)
+        return;
+
+    hash_update(&stream->hash, data, length);
+
+    if (stream->used + length > stream->cap)
+        stream_flush(stream);
+
+    // Anything that wouldn't fit anyway skips the buffer.
+    if (length >= stream->cap)
+    {
+        if (!write_all(stream->fd, data, length))
+            stream->failed = 1;
+        else
+            stream->written += length;
+
+        return;
+    }
+
+    memcpy(stream->buffer + stream->used, data, length);
+    stream->used += length;
+}
+
+int stream_flush(Stream* stream)
+{
+    if (stream->failed)
+        return 0;
+
+    if (stream->used > 0)
+    {
+        if (!write_all(stream->fd, stream->buffer, stream->used))
+            stream->failed = 1;
+        else
+            stream->written += stream->used;
+
+        stream->used = 0;
+    }
+
+    return !stream->failed;
+}
+
+#ifdef _WIN32
+
+int copy_file(const String from, const String to)
+{
+    return CopyFileA(from, to, FALSE) != 0;
+}
+
+#else
+
+// Lets the kernel do the copy when it can. Filesystems that support
+// it share the data between both files (a reflink), otherwise
+// copy_file_range still copies without going through user space.
+// Falls back to reading and writing everything else.
+static int copy_fd(int in, int out)
+{
+    #ifdef __linux__
+    #ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0)
+        return 1;
+    #endif
+
+    struct stat st;
+    if (fstat(in, &st) != 0)
+        return 0;
+
+    off_t remaining = st.st_size;
+    while (remaining > 0)
+    {
+        ssize_t copied = copy_file_range(in, NULL, out, NULL, remaining, 0);
+        if (copied <= 0)
+            break;
+
+        remaining -= copied;
+    }
+
+    if (remaining == 0)
+        return 1;
+
+    // Nothing got copied, so it's safe to start over the slow way.
+    if (remaining != st.st_size)
+        return 0;
+    #endif
+
+    char buffer[FILE_CHUNK_SIZE];
+    ssize_t count;
+    while ((count = read(in, buffer, sizeof(buffer))) > 0)
+    {
+        if (!write_all(out, buffer, count))
+            return 0;
+    }
+
+    return count == 0;
+}
+
+int copy_file(const String from, const String to)
+{
+    int in = open(from, O_RDONLY);
+    if (in < 0)
+        return 0;
+
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+    {
+        close(in);
+        return 0;
+    }
+
+    int res = copy_fd(in, out);
+
+    close(in);
+    res &= close(out) == 0;
+    return res;
+}
+
+#endif // _WIN32
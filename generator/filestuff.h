@@ -1,6 +1,51 @@
 #pragma once
 
+#include <stddef.h>
+#include "hash.h"
 #include "containers/string.h"
+#include "containers/darray.h"
+
+// A piece of output that points into memory owned by someone
+// else (templates or the portfolio). Nothing is copied until
+// the segments are written out.
+typedef struct
+{
+    char*  data;
+    size_t length;
+} Segment;
+
+// Fixed size buffer in front of a file descriptor. Output is
+// flushed whenever the buffer fills up so memory use doesn't
+// depend on how much gets written through it. Everything written
+// since the stream was attached is hashed on the way through.
+typedef struct
+{
+    int    fd;
+    char*  buffer;
+    size_t used;
+    size_t cap;
+    size_t written;
+    int    failed;
+    Hash_State hash;
+} Stream;
 
 String load_file(const String filepath);
-int write_file(const String filepath, String contents);
\ No newline at end of file
+int file_exists(const String filepath);
+int write_file(const String filepath, String contents);
+int write_file_bytes(const String filepath, char* data, size_t length);
+int write_file_segments(const String filepath, DArray(Segment) segments);
+int write_segments(const String filepath, Segment* segments, size_t num_segments);
+int replace_file(const String from, const String to);
+int remove_file(const String filepath);
+int copy_file(const String from, const String to);
+int make_dirs(const String filepath);
+int hash_file(const String filepath, uint64_t* hash);
+
+int  file_open_for_write(const String filepath);
+void file_close(int fd);
+
+Stream stream_make(int fd, size_t cap);
+void   stream_free(Stream* stream);
+void   stream_attach(Stream* stream, int fd);
+void   stream_write(Stream* stream, char* data, size_t length);
+int    stream_flush(Stream* stream);
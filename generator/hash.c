@@ -0,0 +1,158 @@
+#include "hash.h"
+
+#include <string.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc  = rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+static uint64_t merge_round(uint64_t acc, uint64_t val)
+{
+    val  = xxh_round(0, val);
+    acc ^= val;
+    acc  = acc * PRIME64_1 + PRIME64_4;
+    return acc;
+}
+
+void hash_begin(Hash_State* state, uint64_t seed)
+{
+    state->v[0] = seed + PRIME64_1 + PRIME64_2;
+    state->v[1] = seed + PRIME64_2;
+    state->v[2] = seed;
+    state->v[3] = seed - PRIME64_1;
+    state->total = 0;
+    state->mem_size = 0;
+    state->seed = seed;
+}
+
+void hash_update(Hash_State* state, const void* data, size_t length)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    const unsigned char* end = p + length;
+
+    state->total += length;
+
+    // Not enough for a full stripe yet
+    if (state->mem_size + length < 32)
+    {
+        memcpy(state->mem + state->mem_size, p, length);
+        state->mem_size += length;
+        return;
+    }
+
+    if (state->mem_size > 0)
+    {
+        size_t fill = 32 - state->mem_size;
+        memcpy(state->mem + state->mem_size, p, fill);
+        p += fill;
+
+        for (int i = 0; i < 4; i++)
+            state->v[i] = xxh_round(state->v[i], read64(state->mem + i * 8));
+
+        state->mem_size = 0;
+    }
+
+    while (p + 32 <= end)
+    {
+        state->v[0] = xxh_round(state->v[0], read64(p));
+        state->v[1] = xxh_round(state->v[1], read64(p + 8));
+        state->v[2] = xxh_round(state->v[2], read64(p + 16));
+        state->v[3] = xxh_round(state->v[3], read64(p + 24));
+        p += 32;
+    }
+
+    if (p < end)
+    {
+        memcpy(state->mem, p, end - p);
+        state->mem_size = end - p;
+    }
+}
+
+uint64_t hash_end(Hash_State* state)
+{
+    uint64_t h;
+
+    if (state->total >= 32)
+    {
+        h = rotl64(state->v[0], 1) + rotl64(state->v[1], 7) +
+            rotl64(state->v[2], 12) + rotl64(state->v[3], 18);
+
+        for (int i = 0; i < 4; i++)
+            h = merge_round(h, state->v[i]);
+    }
+    else
+    {
+        h = state->seed + PRIME64_5;
+    }
+
+    h += state->total;
+
+    const unsigned char* p = state->mem;
+    const unsigned char* end = p + state->mem_size;
+
+    while (p + 8 <= end)
+    {
+        h ^= xxh_round(0, read64(p));
+        h  = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= (uint64_t) read32(p) * PRIME64_1;
+        h  = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end)
+    {
+        h ^= (*p) * PRIME64_5;
+        h  = rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed)
+{
+    Hash_State state;
+    hash_begin(&state, seed);
+    hash_update(&state, data, length);
+    return hash_end(&state);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64. Fast non-cryptographic hash used to tell if inputs
+// or outputs changed between runs.
+typedef struct
+{
+    uint64_t v[4];
+    uint64_t total;
+    unsigned char mem[32];
+    size_t mem_size;
+    uint64_t seed;
+} Hash_State;
+
+void     hash_begin(Hash_State* state, uint64_t seed);
+void     hash_update(Hash_State* state, const void* data, size_t length);
+uint64_t hash_end(Hash_State* state);
+
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed);
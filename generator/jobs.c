@@ -0,0 +1,156 @@
+#include "jobs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "threads.h"
+#include "trace.h"
+#include "containers/hd_assert.h"
+
+/*
+    Every worker starts with a contiguous block of job indices.
+    It takes jobs from the front of its own block and once it runs
+    out it steals from the back of the other workers' blocks. Jobs
+    are never added while running so a worker is done as soon as
+    it can't find anything to steal.
+*/
+
+typedef struct
+{
+    Mutex lock;
+    int head;
+    int tail;
+} Job_Deque;
+
+typedef struct
+{
+    Job_Proc proc;
+    void* data;
+    int worker_count;
+    Job_Deque* deques;
+
+    // Workers are named after the thread that started them.
+    const char* owner;
+} Job_Pool;
+
+typedef struct
+{
+    Job_Pool* pool;
+    int worker;
+} Job_Worker;
+
+static int take_own(Job_Deque* deque, int* job)
+{
+    int found = 0;
+
+    mutex_lock(&deque->lock);
+    if (deque->head < deque->tail)
+    {
+        *job = deque->head++;
+        found = 1;
+    }
+    mutex_unlock(&deque->lock);
+
+    return found;
+}
+
+static int steal(Job_Deque* deque, int* job)
+{
+    int found = 0;
+
+    mutex_lock(&deque->lock);
+    if (deque->head < deque->tail)
+    {
+        *job = --deque->tail;
+        found = 1;
+    }
+    mutex_unlock(&deque->lock);
+
+    return found;
+}
+
+static void worker_proc(void* data)
+{
+    Job_Worker* worker = (Job_Worker*) data;
+    Job_Pool* pool = worker->pool;
+
+    if (worker->worker > 0 && trace_enabled())
+    {
+        char name[TRACE_NAME_SIZE];
+        snprintf(name, sizeof(name), "%s worker %d", pool->owner, worker->worker);
+        trace_name_thread(name);
+    }
+
+    while (1)
+    {
+        int job;
+        int found = take_own(&pool->deques[worker->worker], &job);
+
+        for (int i = 1; !found && i < pool->worker_count; i++)
+        {
+            int victim = (worker->worker + i) % pool->worker_count;
+            found = steal(&pool->deques[victim], &job);
+        }
+
+        if (!found)
+            break;
+
+        pool->proc(pool->data, worker->worker, job);
+    }
+}
+
+void jobs_run(int worker_count, int job_count, Job_Proc proc, void* data)
+{
+    if (worker_count > job_count)
+        worker_count = job_count;
+
+    if (worker_count <= 1)
+    {
+        for (int i = 0; i < job_count; i++)
+            proc(data, 0, i);
+
+        return;
+    }
+
+    Job_Pool pool = { proc, data, worker_count, NULL, trace_thread_name() };
+    pool.deques = (Job_Deque*) malloc(worker_count * sizeof(Job_Deque));
+    hd_assert(pool.deques != NULL);
+
+    Job_Worker* workers = (Job_Worker*) malloc(worker_count * sizeof(Job_Worker));
+    hd_assert(workers != NULL);
+
+    Thread* threads = (Thread*) malloc(worker_count * sizeof(Thread));
+    hd_assert(threads != NULL);
+
+    for (int i = 0; i < worker_count; i++)
+    {
+        mutex_make(&pool.deques[i].lock);
+        pool.deques[i].head = (int) ((long long) job_count * i / worker_count);
+        pool.deques[i].tail = (int) ((long long) job_count * (i + 1) / worker_count);
+
+        workers[i].pool = &pool;
+        workers[i].worker = i;
+    }
+
+    // The calling thread works as worker 0.
+    int* started = (int*) calloc(worker_count, sizeof(int));
+    hd_assert(started != NULL);
+
+    for (int i = 1; i < worker_count; i++)
+        started[i] = thread_create(&threads[i], worker_proc, &workers[i]);
+
+    worker_proc(&workers[0]);
+
+    for (int i = 1; i < worker_count; i++)
+    {
+        if (started[i])
+            thread_join(&threads[i]);
+    }
+
+    for (int i = 0; i < worker_count; i++)
+        mutex_free(&pool.deques[i].lock);
+
+    free(started);
+    free(threads);
+    free(workers);
+    free(pool.deques);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Called once for every job index. worker is in [0, worker_count)
+// and can be used to pick per thread state.
+typedef void (*Job_Proc)(void* data, int worker, int job);
+
+void jobs_run(int worker_count, int job_count, Job_Proc proc, void* data);
@@ -0,0 +1,599 @@
+#include "minify.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "containers/hd_assert.h"
+
+// Written out for whitespace that got collapsed and quotes that had
+// to stay. They never move so they can be passed on like the input.
+static char space_string[]   = " ";
+static char newline_string[] = "\n";
+static char semicolon_string[] = ";";
+
+static int is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static char to_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static int is_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '-' || c == ':';
+}
+
+// Values with any of these need their quotes, see the HTML spec's
+// unquoted attribute value syntax.
+static int is_unquoted_safe(char c)
+{
+    return !is_space(c) && c != '"' && c != '\'' && c != '=' &&
+           c != '<' && c != '>' && c != '`';
+}
+
+// CSS characters that whitespace on either side of can go.
+static int is_css_punct(char c)
+{
+    return c == '{' || c == '}' || c == ';' || c == ',' || c == '>' || c == ':';
+}
+
+void minifier_make(Minifier* m)
+{
+    memset(m, 0, sizeof(*m));
+    da_make(m->pending);
+}
+
+void minifier_free(Minifier* m)
+{
+    if (m->pending)
+        da_free(m->pending);
+    m->pending = NULL;
+}
+
+void minifier_reset(Minifier* m, Minify_Output output, void* data)
+{
+    DArray(Segment) pending = m->pending;
+    memset(m, 0, sizeof(*m));
+
+    m->pending = pending;
+    da_clear(m->pending);
+    m->output = output;
+    m->data = data;
+}
+
+static void flush_run(Minifier* m)
+{
+    if (m->run.length)
+        m->output(m->data, m->run.data, m->run.length);
+    m->run.length = 0;
+}
+
+static void put(Minifier* m, char* data, size_t length)
+{
+    if (m->deferring)
+    {
+        size_t count = da_size(m->pending);
+        Segment* last = count ? &m->pending[count - 1] : NULL;
+
+        if (last && last->data + last->length == data)
+        {
+            last->length += length;
+        }
+        else
+        {
+            Segment seg = { data, length };
+            da_push_back(m->pending, seg);
+        }
+        return;
+    }
+
+    if (m->run.length && m->run.data + m->run.length == data)
+    {
+        m->run.length += length;
+        return;
+    }
+
+    m->started = 1;
+    flush_run(m);
+    m->run.data = data;
+    m->run.length = length;
+}
+
+static void flush_space(Minifier* m)
+{
+    if (m->space && m->started)
+    {
+        put(m, m->space == '\n' ? newline_string : space_string, 1);
+    }
+    m->space = 0;
+}
+
+static void defer(Minifier* m)
+{
+    m->deferring = 1;
+    da_clear(m->pending);
+}
+
+// Passes on everything held back since defer().
+static void put_pending(Minifier* m)
+{
+    m->deferring = 0;
+
+    da_foreach(Segment, seg, m->pending)
+        put(m, seg->data, seg->length);
+    da_clear(m->pending);
+}
+
+// Writes anything held back after the whitespace before it.
+static void commit(Minifier* m)
+{
+    m->deferring = 0;
+    flush_space(m);
+    put_pending(m);
+}
+
+static void drop(Minifier* m)
+{
+    m->deferring = 0;
+    da_clear(m->pending);
+}
+
+static void start_end_tag(Minifier* m, char* name)
+{
+    m->end_len = strlen(name);
+    memcpy(m->end_tag, name, m->end_len);
+    m->end_match = 0;
+}
+
+// Matches the content of raw elements against "</" end_tag.
+static int match_end_tag(Minifier* m, char c)
+{
+    char expected = (m->end_match == 0) ? '<' :
+                    (m->end_match == 1) ? '/' : m->end_tag[m->end_match - 2];
+
+    if (to_lower(c) == expected)
+        m->end_match++;
+    else
+        m->end_match = (c == '<') ? 1 : 0;
+
+    return m->end_match == m->end_len + 2;
+}
+
+static void end_of_tag(Minifier* m)
+{
+    m->tag[m->tag_len] = '\0';
+    m->tag_space = 0;
+    m->state = MIN_TEXT;
+
+    if (m->closing)
+        return;
+
+    if (!strcmp(m->tag, "pre") || !strcmp(m->tag, "textarea") || !strcmp(m->tag, "script"))
+    {
+        start_end_tag(m, m->tag);
+        m->state = MIN_RAW;
+    }
+    else if (!strcmp(m->tag, "style"))
+    {
+        start_end_tag(m, m->tag);
+        m->css_last = '{';
+        m->css_semi = 0;
+        m->state = MIN_CSS;
+    }
+}
+
+// Once the end tag of a raw element has been written the rest is
+// read like any other tag.
+static void enter_end_tag(Minifier* m)
+{
+    memcpy(m->tag, m->end_tag, m->end_len);
+    m->tag_len = m->end_len;
+    m->closing = 1;
+    m->tag_space = 0;
+    m->state = MIN_TAG;
+}
+
+// Decides what happens to a held back ';' and whitespace once the
+// next CSS character is known.
+static void css_resolve(Minifier* m, char c)
+{
+    if (m->css_semi)
+    {
+        m->css_semi = 0;
+        if (c != '}')
+        {
+            m->space = 0;
+            put(m, semicolon_string, 1);
+            m->css_last = ';';
+        }
+    }
+
+    if (m->space && (is_css_punct(m->css_last) || (is_css_punct(c) && c != ':')))
+    {
+        m->space = 0;
+    }
+}
+
+static void close_value(Minifier* m, char* quote)
+{
+    m->deferring = 0;
+
+    if (m->value_len && m->value_safe && m->value_last != '/')
+    {
+        put_pending(m);
+        m->unquoted = 1;
+    }
+    else
+    {
+        put(m, m->quote, 1);
+        put_pending(m);
+        put(m, quote, 1);
+        m->unquoted = 0;
+    }
+}
+
+// Starts reading a tag that can't be a comment.
+static void start_tag(Minifier* m, int closing)
+{
+    commit(m);
+    m->tag_len = 0;
+    m->closing = closing;
+    m->unquoted = 0;
+    m->state = MIN_TAG;
+}
+
+void minify_write(Minifier* m, char* data, size_t length)
+{
+    size_t i = 0;
+
+    while (i < length)
+    {
+        char* p = data + i;
+        char c = *p;
+
+        // Set when the state changed before c was used, so it's read
+        // again in the new state.
+        int reread = 0;
+
+        switch (m->state)
+        {
+            case MIN_TEXT:
+            {
+                if (is_space(c))
+                {
+                    m->space = (c == '\n' || m->space == '\n') ? '\n' : ' ';
+                }
+                else if (c == '<')
+                {
+                    defer(m);
+                    put(m, p, 1);
+                    m->state = MIN_LT;
+                }
+                else
+                {
+                    flush_space(m);
+                    put(m, p, 1);
+                }
+            } break;
+
+            case MIN_LT:
+            {
+                if (c == '!')
+                {
+                    put(m, p, 1);
+                    m->state = MIN_LT_BANG;
+                }
+                else
+                {
+                    commit(m);
+                    m->tag_len = 0;
+                    m->unquoted = 0;
+                    m->state = MIN_TEXT;
+
+                    if (c == '/' || is_name_char(c))
+                    {
+                        m->closing = (c == '/');
+                        m->state = MIN_TAG_NAME;
+                    }
+
+                    // Only the '/' of an end tag is used up here.
+                    if (c == '/')
+                        put(m, p, 1);
+                    else
+                        reread = 1;
+                }
+            } break;
+
+            case MIN_LT_BANG:
+            {
+                if (c == '-')
+                {
+                    put(m, p, 1);
+                    m->state = MIN_LT_BANG_DASH;
+                }
+                else
+                {
+                    start_tag(m, 1);
+                    reread = 1;
+                }
+            } break;
+
+            case MIN_LT_BANG_DASH:
+            {
+                if (c == '-')
+                {
+                    // Comments count as whitespace, so whatever whitespace
+                    // came before is still waiting to be written.
+                    drop(m);
+                    m->end_match = 0;
+                    m->state = MIN_COMMENT;
+                }
+                else
+                {
+                    start_tag(m, 1);
+                    reread = 1;
+                }
+            } break;
+
+            case MIN_COMMENT:
+            {
+                if (c == '>' && m->end_match >= 2)
+                    m->state = MIN_TEXT;
+                else
+                    m->end_match = (c == '-') ? m->end_match + 1 : 0;
+            } break;
+
+            case MIN_TAG_NAME:
+            {
+                if (is_name_char(c))
+                {
+                    if (m->tag_len < sizeof(m->tag) - 1)
+                        m->tag[m->tag_len++] = to_lower(c);
+                    put(m, p, 1);
+                }
+                else
+                {
+                    m->state = MIN_TAG;
+                    reread = 1;
+                }
+            } break;
+
+            case MIN_TAG:
+            {
+                if (is_space(c))
+                {
+                    m->tag_space = 1;
+                }
+                else if (c == '>')
+                {
+                    put(m, p, 1);
+                    end_of_tag(m);
+                }
+                else if (c == '/')
+                {
+                    // "a=b/>" would make the slash part of the value.
+                    if (m->unquoted)
+                        put(m, space_string, 1);
+                    put(m, p, 1);
+                    m->tag_space = 0;
+                    m->unquoted = 0;
+                }
+                else if (c == '=')
+                {
+                    put(m, p, 1);
+                    m->tag_space = 0;
+                    m->state = MIN_VALUE_START;
+                }
+                else
+                {
+                    if (m->tag_space)
+                        put(m, space_string, 1);
+                    put(m, p, 1);
+                    m->tag_space = 0;
+                    m->unquoted = 0;
+                }
+            } break;
+
+            case MIN_VALUE_START:
+            {
+                if (c == '"' || c == '\'')
+                {
+                    m->quote = p;
+                    m->value_len = 0;
+                    m->value_safe = 1;
+                    m->value_last = 0;
+                    defer(m);
+                    m->state = MIN_QUOTED;
+                }
+                else if (c == '>')
+                {
+                    put(m, p, 1);
+                    end_of_tag(m);
+                }
+                else if (!is_space(c))
+                {
+                    put(m, p, 1);
+                    m->unquoted = 1;
+                    m->state = MIN_VALUE;
+                }
+            } break;
+
+            case MIN_VALUE:
+            {
+                if (is_space(c))
+                {
+                    m->tag_space = 1;
+                    m->state = MIN_TAG;
+                }
+                else if (c == '>')
+                {
+                    put(m, p, 1);
+                    end_of_tag(m);
+                }
+                else
+                {
+                    put(m, p, 1);
+                }
+            } break;
+
+            case MIN_QUOTED:
+            {
+                if (c == *m->quote)
+                {
+                    close_value(m, p);
+                    m->state = MIN_TAG;
+                }
+                else
+                {
+                    put(m, p, 1);
+                    m->value_len++;
+                    m->value_last = c;
+                    if (!is_unquoted_safe(c))
+                        m->value_safe = 0;
+                }
+            } break;
+
+            case MIN_RAW:
+            {
+                put(m, p, 1);
+                if (match_end_tag(m, c))
+                    enter_end_tag(m);
+            } break;
+
+            case MIN_CSS:
+            {
+                if (is_space(c))
+                {
+                    m->space = ' ';
+                }
+                else if (c == ';')
+                {
+                    // Held back in case it's the last one before a '}'.
+                    css_resolve(m, c);
+                    m->space = 0;
+                    m->css_semi = 1;
+                }
+                else if (c == '/' || c == '<')
+                {
+                    // Either a comment or the end tag, or neither and it's
+                    // written like anything else.
+                    m->end_match = (c == '<') ? 1 : 0;
+                    defer(m);
+                    put(m, p, 1);
+                    m->state = (c == '<') ? MIN_CSS_END_TAG : MIN_CSS_SLASH;
+                }
+                else
+                {
+                    css_resolve(m, c);
+                    flush_space(m);
+                    put(m, p, 1);
+                    m->css_last = c;
+
+                    if (c == '"' || c == '\'')
+                    {
+                        m->css_quote = c;
+                        m->css_escape = 0;
+                        m->state = MIN_CSS_STRING;
+                    }
+                }
+            } break;
+
+            case MIN_CSS_SLASH:
+            {
+                if (c == '*')
+                {
+                    drop(m);
+                    m->state = MIN_CSS_COMMENT;
+                }
+                else
+                {
+                    css_resolve(m, '/');
+                    commit(m);
+                    m->css_last = '/';
+                    m->state = MIN_CSS;
+                    reread = 1;
+                }
+            } break;
+
+            case MIN_CSS_COMMENT:
+            {
+                if (c == '*')
+                    m->state = MIN_CSS_COMMENT_STAR;
+            } break;
+
+            case MIN_CSS_COMMENT_STAR:
+            {
+                if (c == '/')
+                    m->state = MIN_CSS;
+                else if (c != '*')
+                    m->state = MIN_CSS_COMMENT;
+            } break;
+
+            case MIN_CSS_STRING:
+            {
+                put(m, p, 1);
+
+                if (m->css_escape)
+                    m->css_escape = 0;
+                else if (c == '\\')
+                    m->css_escape = 1;
+                else if (c == m->css_quote)
+                    m->state = MIN_CSS;
+            } break;
+
+            case MIN_CSS_END_TAG:
+            {
+                if (match_end_tag(m, c))
+                {
+                    put(m, p, 1);
+                    m->css_semi = 0;
+                    m->space = 0;
+                    commit(m);
+                    enter_end_tag(m);
+                }
+                else if (m->end_match > 1)
+                {
+                    put(m, p, 1);
+                }
+                else
+                {
+                    // Not the end tag after all, so the '<' and whatever
+                    // matched so far are just CSS.
+                    css_resolve(m, '<');
+                    commit(m);
+                    m->css_last = '<';
+                    m->state = MIN_CSS;
+                    reread = 1;
+                }
+            } break;
+        }
+
+        if (!reread)
+            i++;
+    }
+}
+
+void minify_finish(Minifier* m)
+{
+    if (m->state == MIN_QUOTED)
+    {
+        // The page ended inside a value, leave it as it was.
+        m->value_safe = 0;
+        m->deferring = 0;
+        put(m, m->quote, 1);
+        put_pending(m);
+    }
+    else if (m->deferring)
+    {
+        if (m->css_semi)
+            put(m, semicolon_string, 1);
+        m->css_semi = 0;
+        commit(m);
+    }
+
+    flush_run(m);
+    m->state = MIN_TEXT;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include "filestuff.h"
+#include "containers/darray.h"
+
+typedef void (*Minify_Output)(void* data, char* chunk, size_t length);
+
+typedef enum
+{
+    MIN_TEXT,
+    MIN_LT,
+    MIN_LT_BANG,
+    MIN_LT_BANG_DASH,
+    MIN_COMMENT,
+    MIN_TAG_NAME,
+    MIN_TAG,
+    MIN_VALUE_START,
+    MIN_VALUE,
+    MIN_QUOTED,
+    MIN_RAW,
+    MIN_CSS,
+    MIN_CSS_SLASH,
+    MIN_CSS_COMMENT,
+    MIN_CSS_COMMENT_STAR,
+    MIN_CSS_STRING,
+    MIN_CSS_END_TAG
+} Minify_State;
+
+/*
+    Single pass HTML minifier that sits between the generator and
+    the output. It drops comments, collapses whitespace outside of
+    <pre>, <textarea> and <script>, drops quotes that attribute
+    values don't need and squeezes the CSS in <style> blocks.
+
+    Everything passed in has to stay around until the page is done
+    (like the templates and portfolio do) since the output is made
+    of pieces of the input instead of a copy of it. Only whitespace
+    and quotes that might get dropped are held back.
+*/
+typedef struct
+{
+    Minify_State state;
+    Minify_Output output;
+    void* data;
+
+    // Output that's been decided on but not passed on yet. Pieces
+    // of input that follow each other get merged into one.
+    Segment run;
+
+    // Output that could still get dropped or wrapped, like a '<'
+    // that might start a comment or a value that might not need
+    // its quotes.
+    DArray(Segment) pending;
+    int deferring;
+
+    // Collapsed whitespace waiting to be written (' ' or '\n').
+    char space;
+    int started;
+
+    char tag[16];
+    size_t tag_len;
+    int closing;
+    int tag_space;
+    int unquoted;
+
+    char* quote;
+    size_t value_len;
+    int value_safe;
+    char value_last;
+
+    // <pre>, <textarea>, <script> and <style> end at "</" end_tag.
+    char end_tag[16];
+    size_t end_len;
+    size_t end_match;
+
+    char css_quote;
+    char css_last;
+    int css_semi;
+    int css_escape;
+} Minifier;
+
+void minifier_make(Minifier* m);
+void minifier_free(Minifier* m);
+void minifier_reset(Minifier* m, Minify_Output output, void* data);
+void minify_write(Minifier* m, char* data, size_t length);
+void minify_finish(Minifier* m);
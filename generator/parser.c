@@ -1,6 +1,7 @@
 #include "parser.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "containers/hd_assert.h"
 
@@ -10,6 +11,9 @@
 #define DARRAY_IMPL
 #include "containers/darray.h"
 
+#define ALLOC_IMPL
+#include "containers/alloc.h"
+
 #include "portfolio.h"
 
 Lexer lexer_make(String contents)
@@ -62,135 +66,173 @@ static char consume(Lexer* lexer)
     return lexer->contents[lexer->index++];
 }
 
-void lexer_lex(Lexer* lexer)
-{
-    #define LEX_ERROR(m) \
-        do {                                                  \
-            lexer->status = LEXER_FAILURE;                    \
-            lexer->message = string_make("Lexer Error: "m);   \
-            char lineString[32];                              \
-            sprintf(lineString, " (%d)", lexer->currentLine); \
-            string_append(&lexer->message, lineString);       \
-        } while (0)
+#define LEX_ERROR(m) \
+    do {                                                  \
+        lexer->status = LEXER_FAILURE;                    \
+        lexer->message = string_make("Lexer Error: "m);   \
+        char lineString[32];                              \
+        sprintf(lineString, " (%d)", lexer->currentLine); \
+        string_append(&lexer->message, lineString);       \
+    } while (0)
 
-    // Just in case
-    lexer->index = 0;
-    lexer->status = LEXER_NO_LEX;
-    lexer->currentLine = 1;
+// Lexes whatever starts at the current character. This
+// can push at most one token.
+static void lex_next(Lexer* lexer)
+{
+    char ch = peek(lexer, 0);
 
-    int len = string_length(lexer->contents);
-    while (lexer->status != LEXER_FAILURE && lexer->index < len)
+    switch (ch)
     {
-        char ch = peek(lexer, 0);
-
-        switch (ch)
-        {
-            // Single character tokens
-            case TOKEN_DOLLAR:
-            case TOKEN_L_BRACKET:
-            case TOKEN_R_BRACKET:
-            case TOKEN_L_BRACE:
-            case TOKEN_R_BRACE:
-            case TOKEN_COLON:
-            case TOKEN_SEMI_COLON:
-            case TOKEN_COMMA:
+        // Single character tokens
+        case TOKEN_DOLLAR:
+        case TOKEN_L_BRACKET:
+        case TOKEN_R_BRACKET:
+        case TOKEN_L_BRACE:
+        case TOKEN_R_BRACE:
+        case TOKEN_COLON:
+        case TOKEN_SEMI_COLON:
+        case TOKEN_COMMA:
+        {
+            Token t = { ch, NULL , lexer->currentLine};
+            da_push_back(lexer->tokens, t);
+            consume(lexer);
+        } break;
+
+        case '`':       // @Todo: Change this so that the string actually
+                        //        gets formatted.
+        case '"':
+        {
+            // @Todo: Change this after implementing format
+            //        strings
+            char end_char = ch;
+
+            consume(lexer);
+            int start_index = lexer->index;
+            int end_index = start_index;
+
+            int string_is_valid = 1;
+            while (peek(lexer, 0) != end_char)
             {
-                Token t = { ch, NULL , lexer->currentLine};
-                da_push_back(lexer->tokens, t);
+                if (peek(lexer, 0) == '\0')
+                {
+                    string_is_valid = 0;
+                    break;
+                }
+
                 consume(lexer);
-            } break;
+                end_index++;
+            }
 
-            case '`':       // @Todo: Change this so that the string actually
-                            //        gets formatted.
-            case '"':
+            if (string_is_valid)
             {
-                // @Todo: Change this after implementing format
-                //        strings
-                char end_char = ch;
-
+                int length = end_index - start_index;
+                String str = string_make_till_n(lexer->contents + start_index, length);
+                Token t = { TOKEN_STRING, str, lexer->currentLine };
+                da_push_back(lexer->tokens, t);
                 consume(lexer);
-                int start_index = lexer->index;
-                int end_index = start_index;
+            }
+            else
+                LEX_ERROR("Couldn't find closing '\"' for string");
+        } break;
 
-                int string_is_valid = 1;
-                while (peek(lexer, 0) != end_char)
+        case '/':
+        {
+            // Comments aren't pushed as tokens
+            // to reduce confusion
+            if (peek(lexer, 1) == '/')
+            {
+                // Ignore the rest of the line
+                while (peek(lexer, 0) && peek(lexer, 0) != '\n')
+                    consume(lexer);
+            }
+            else if (peek(lexer, 1) == '*')
+            {
+                // Ignore till */ is encoutered
+                int comment_is_valid = 0;
+                while (peek(lexer, 0))
                 {
-                    if (peek(lexer, 0) == '\0')
+                    if (peek(lexer, 0) == '*' && peek(lexer, 1) == '/')
                     {
-                        string_is_valid = 0;
+                        consume(lexer); consume(lexer);
+                        comment_is_valid = 1;
                         break;
                     }
 
                     consume(lexer);
-                    end_index++;
                 }
 
-                if (string_is_valid)
-                {
-                    int length = end_index - start_index;
-                    String str = string_make_till_n(lexer->contents + start_index, length);
-                    Token t = { TOKEN_STRING, str, lexer->currentLine };
-                    da_push_back(lexer->tokens, t);
-                    consume(lexer);
-                }
-                else
-                    LEX_ERROR("Couldn't find closing '\"' for string");
-            } break;
+                if (!comment_is_valid)
+                    LEX_ERROR("Block comment doesn't end");
+            }
+            else
+                LEX_ERROR("Expected 2 '/'s for comment. Got single '/'");
+        } break;
 
-            case '/':
+        default:
+        {
+            // Identifiers
+            if (is_alpha_or_us(ch))
             {
-                // Comments aren't pushed as tokens
-                // to reduce confusion
-                if (peek(lexer, 1) == '/')
+                int start_index = lexer->index;
+                int end_index = start_index;
+
+                while (is_alpha_or_us(peek(lexer, 0)))
                 {
-                    // Ignore the rest of the line
-                    while (peek(lexer, 0) && peek(lexer, 0) != '\n')
-                        consume(lexer);
+                    end_index++;
+                    consume(lexer);
                 }
-                else if (peek(lexer, 1) == '*')
-                {
-                    // Ignore till */ is encoutered
-                    int comment_is_valid = 0;
-                    while (peek(lexer, 0))
-                    {
-                        if (peek(lexer, 0) == '*' && peek(lexer, 1) == '/')
-                        {
-                            consume(lexer); consume(lexer);
-                            comment_is_valid = 1;
-                            break;
-                        }
-
-                        consume(lexer);
-                    }
 
-                    if (!comment_is_valid)
-                        LEX_ERROR("Block comment doesn't end");
-                }
-                else
-                    LEX_ERROR("Expected 2 '/'s for comment. Got single '/'");
-            } break;
+                int length = end_index - start_index;
+                String str = string_make_till_n(lexer->contents + start_index, length);
+                Token t = { TOKEN_INDENTIFIER, str, lexer->currentLine };
+                da_push_back(lexer->tokens, t);
+            }
+            else consume(lexer);
+        } break;
+    }
+}
 
-            default:
-            {
-                // Identifiers
-                if (is_alpha_or_us(ch))
-                {
-                    int start_index = lexer->index;
-                    int end_index = start_index;
+#undef LEX_ERROR
 
-                    while (is_alpha_or_us(peek(lexer, 0)))
-                    {
-                        end_index++;
-                        consume(lexer);
-                    }
+void lexer_lex(Lexer* lexer)
+{
+    // Just in case
+    lexer->index = 0;
+    lexer->status = LEXER_NO_LEX;
+    lexer->currentLine = 1;
 
-                    int length = end_index - start_index;
-                    String str = string_make_till_n(lexer->contents + start_index, length);
-                    Token t = { TOKEN_INDENTIFIER, str, lexer->currentLine };
-                    da_push_back(lexer->tokens, t);
-                }
-                else consume(lexer);
-            } break;
+    int len = string_length(lexer->contents);
+    while (lexer->status != LEXER_FAILURE && lexer->index < len)
+        lex_next(lexer);
+
+    if (lexer->status != LEXER_FAILURE)
+    {
+        lexer->status = LEXER_SUCCESS;
+        lexer->message = NULL;
+    }
+}
+
+// Lexes up to and including the '$' that starts the next statement
+// so the parser always has one token to look ahead at. Returns 0
+// once the whole file has been lexed (or lexing failed).
+int lexer_lex_step(Lexer* lexer)
+{
+    if (lexer->status == LEXER_FAILURE || lexer->status == LEXER_SUCCESS)
+        return 0;
+
+    if (lexer->index == 0)
+        lexer->currentLine = 1;
+
+    int len = string_length(lexer->contents);
+    while (lexer->status != LEXER_FAILURE && lexer->index < len)
+    {
+        int num_tokens = da_size(lexer->tokens);
+        lex_next(lexer);
+
+        if (da_size(lexer->tokens) > num_tokens && num_tokens > 0 &&
+            lexer->tokens[num_tokens].type == TOKEN_DOLLAR)
+        {
+            return 1;
         }
     }
 
@@ -200,7 +242,7 @@ void lexer_lex(Lexer* lexer)
         lexer->message = NULL;
     }
 
-    #undef LEX_ERROR
+    return 0;
 }
 
 Parser parser_make(DArray(Token) tokens)
@@ -228,11 +270,6 @@ void parser_free(Parser* parser)
     parser->status = PARSER_NO_PARSE;
 }
 
-static int expect_next_token(Parser* parser, Token_Type type)
-{
-    return parser->tokens[parser->current_token_idx + 1].type == type;
-}
-
 static int curr_token_is_type(Parser* parser, Token_Type type)
 {
     return parser->tokens[parser->current_token_idx].type == type;
@@ -265,11 +302,35 @@ static void advance_token(Parser* parser)
             advance_token(parser);                          \
     } while (0)
 
+// Strings in the array starting at the current token, up to
+// the ']' or the end of the tokens if it was never closed.
+static int count_array_strings(Parser* parser)
+{
+    int count = 0;
+    int num_tokens = da_size(parser->tokens);
+
+    for (int i = parser->current_token_idx; i < num_tokens; i++)
+    {
+        Token_Type type = parser->tokens[i].type;
+        if (type == TOKEN_R_BRACKET)
+            break;
+
+        if (type == TOKEN_STRING)
+            count++;
+    }
+
+    return count;
+}
+
 static void fill_string_array(Parser* parser, DArray(String)* arr)
 {
     // Checked for '[' in parse_persona()
     advance_token(parser);
     int num_tokens = da_size(parser->tokens);
+
+    // Most of these only have a handful of strings, counting them
+    // first means the array grows once instead of every other push.
+    da_reserve((*arr), da_size(*arr) + count_array_strings(parser));
     while (parser->status != PARSER_FAILURE)
     {
         if (parser->current_token_idx >= num_tokens)
@@ -356,6 +417,7 @@ static Project parser_project(Parser* parser)
             }
 
             project.date = string_make(curr_token(parser).value);
+            project.date_key = parse_date(project.date);
             advance_token(parser);
 
             CHECK_STATEMENT_END();
@@ -701,84 +763,126 @@ static Link parse_link(Parser* parser)
     return link;
 }
 
-Portfolio parser_parse(Parser* parser)
+// Parses a single $ statement into the portfolio.
+Parse_Step parser_parse_step(Parser* parser, Portfolio* portfolio)
 {
-    Portfolio portfolio = portfolio_make();
+    if (!curr_token_is_type(parser, TOKEN_DOLLAR))
+    {
+        PARSE_ERROR("Expected a '$' property");
+        return PARSE_STEP_NONE;
+    }
 
-    // Just in case
-    parser->current_token_idx = 0;
-    parser->status = PARSER_NO_PARSE;
+    advance_token(parser);
+    if (!curr_token_is_type(parser, TOKEN_INDENTIFIER))
+    {
+        PARSE_ERROR("Expected an identifier after '$'");
+        return PARSE_STEP_NONE;
+    }
 
-    int num_tokens = da_size(parser->tokens);
-    while (parser->status != PARSER_FAILURE && parser->current_token_idx < num_tokens)
+    String i_name = curr_token(parser).value;
+    advance_token(parser);
+
+    if (!curr_token_is_type(parser, TOKEN_STRING))
     {
-        if (curr_token_is_type(parser, TOKEN_DOLLAR))
-        {
-            advance_token(parser);
-            if (!curr_token_is_type(parser, TOKEN_INDENTIFIER))
-            {
-                PARSE_ERROR("Expected an identifier after '$'");
-                continue;
-            }
+        PARSE_ERROR("Expected a string after $ property");
+        return PARSE_STEP_NONE;
+    }
 
-            String i_name = curr_token(parser).value;
-            advance_token(parser);
+    if (string_cmp(i_name, "home_template"))
+    {
+        portfolio->home_template = string_make(curr_token(parser).value);
+        advance_token(parser);
+        return PARSE_STEP_SETTING;
+    }
 
-            if (!curr_token_is_type(parser, TOKEN_STRING))
-            {
-                PARSE_ERROR("Expected a string after $ property");
-                continue;
-            }
+    if (string_cmp(i_name, "page_template"))
+    {
+        portfolio->page_template = string_make(curr_token(parser).value);
+        advance_token(parser);
+        return PARSE_STEP_SETTING;
+    }
 
-            if (string_cmp(i_name, "home_template"))
-            {
-                portfolio.home_template = string_make(curr_token(parser).value);
-                advance_token(parser);
-                continue;
-            }
+    if (string_cmp(i_name, "project_template"))
+    {
+        portfolio->project_template = string_make(curr_token(parser).value);
+        advance_token(parser);
+        return PARSE_STEP_SETTING;
+    }
 
-            if (string_cmp(i_name, "page_template"))
-            {
-                portfolio.page_template = string_make(curr_token(parser).value);
-                advance_token(parser);
-                continue;
-            }
+    if (string_cmp(i_name, "skill_template"))
+    {
+        portfolio->skill_template = string_make(curr_token(parser).value);
+        advance_token(parser);
+        return PARSE_STEP_SETTING;
+    }
 
-            if (string_cmp(i_name, "outdir"))
-            {
-                portfolio.outdir = string_make(curr_token(parser).value);
-                advance_token(parser);
-                continue;
-            }
+    if (string_cmp(i_name, "outdir"))
+    {
+        portfolio->outdir = string_make(curr_token(parser).value);
+        advance_token(parser);
+        return PARSE_STEP_SETTING;
+    }
 
-            if (string_cmp(i_name, "persona"))
-            {
-                Persona persona = parse_persona(parser);
+    if (string_cmp(i_name, "page_size"))
+    {
+        // Persona pages may already have been generated by then.
+        if (da_size(portfolio->personas) > 0)
+        {
+            PARSE_ERROR("$page_size has to be set before any personas");
+            return PARSE_STEP_NONE;
+        }
 
-                if (parser->status != PARSER_FAILURE)
-                    da_push_back(portfolio.personas, persona);
-                else
-                    persona_free(&persona);
+        int page_size = atoi(curr_token(parser).value);
+        if (page_size < 0)
+        {
+            PARSE_ERROR("$page_size can't be negative");
+            return PARSE_STEP_NONE;
+        }
 
-                continue;
-            }
+        portfolio->page_size = page_size;
+        advance_token(parser);
+        return PARSE_STEP_SETTING;
+    }
 
-            if (string_cmp(i_name, "link"))
-            {
-                Link link = parse_link(parser);
-                
-                if (parser->status != PARSER_FAILURE)
-                    da_push_back(portfolio.links, link);
-                else
-                    link_free(&link);
+    if (string_cmp(i_name, "persona"))
+    {
+        Persona persona = parse_persona(parser);
 
-                continue;
-            }
+        if (parser->status != PARSER_FAILURE)
+            da_push_back(portfolio->personas, persona);
+        else
+            persona_free(&persona);
 
-        } else
-            PARSE_ERROR("Expected a '$' property");
+        return PARSE_STEP_PERSONA;
     }
 
+    if (string_cmp(i_name, "link"))
+    {
+        Link link = parse_link(parser);
+        
+        if (parser->status != PARSER_FAILURE)
+            da_push_back(portfolio->links, link);
+        else
+            link_free(&link);
+
+        return PARSE_STEP_LINK;
+    }
+
+    return PARSE_STEP_NONE;
+}
+
+Portfolio parser_parse(Parser* parser)
+{
+    Portfolio portfolio = portfolio_make();
+
+    // Just in case
+    parser->current_token_idx = 0;
+    parser->status = PARSER_NO_PARSE;
+
+    int num_tokens = da_size(parser->tokens);
+    while (parser->status != PARSER_FAILURE && parser->current_token_idx < num_tokens)
+        parser_parse_step(parser, &portfolio);
+
     if (parser->status != PARSER_FAILURE)
     {
         parser->status = PARSER_SUCCESS;
@@ -49,6 +49,7 @@ typedef struct
 Lexer lexer_make(String contents);
 void lexer_free(Lexer* lexer);
 void lexer_lex(Lexer* lexer);
+int  lexer_lex_step(Lexer* lexer);
 
 typedef enum
 {
@@ -65,6 +66,15 @@ typedef struct
     String message;
 } Parser;
 
+typedef enum
+{
+    PARSE_STEP_NONE,
+    PARSE_STEP_SETTING,
+    PARSE_STEP_LINK,
+    PARSE_STEP_PERSONA
+} Parse_Step;
+
 Parser parser_make(DArray(Token) tokens);
 void parser_free(Parser* parser);
-Portfolio parser_parse(Parser* parser);
\ No newline at end of file
+Portfolio parser_parse(Parser* parser);
+Parse_Step parser_parse_step(Parser* parser, Portfolio* portfolio);
\ No newline at end of file
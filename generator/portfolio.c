@@ -34,6 +34,123 @@ void project_free(Project* project)
     da_foreach(String, image, project->images)
         string_free(image);
     da_free(project->images);    
+
+    if (project->page)
+        string_free(&project->page);
+}
+
+static int lower(char ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+static int is_letter(char ch)
+{
+    ch = lower(ch);
+    return ch >= 'a' && ch <= 'z';
+}
+
+static int is_digit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+// Months are told apart by their first three letters, so Sept,
+// September and sep are all the same month.
+static int parse_month(char* word, int length)
+{
+    static const char* months[] = {
+        "jan", "feb", "mar", "apr", "may", "jun",
+        "jul", "aug", "sep", "oct", "nov", "dec"
+    };
+
+    if (length < 3)
+        return 0;
+
+    for (int i = 0; i < 12; i++)
+    {
+        if (lower(word[0]) == months[i][0] &&
+            lower(word[1]) == months[i][1] &&
+            lower(word[2]) == months[i][2])
+            return i + 1;
+    }
+
+    return 0;
+}
+
+int parse_date(String date)
+{
+    int year = 0, month = 0, day = 0;
+    int year_first = 0;
+
+    // Numbers that aren't years, in the order they come in.
+    int numbers[2];
+    int num_numbers = 0;
+
+    for (char* c = date; c && *c;)
+    {
+        if (is_digit(*c))
+        {
+            int value = 0, digits = 0;
+            for (; is_digit(*c); c++, digits++)
+                value = (value < 100000) ? value * 10 + (*c - '0') : value;
+
+            if (digits == 4 && !year)
+            {
+                year = value;
+                year_first = num_numbers == 0 && !month;
+            }
+            else if (num_numbers < 2)
+            {
+                numbers[num_numbers++] = value;
+            }
+
+            // Skips suffixes like st, nd, rd and th.
+            while (is_letter(*c))
+                c++;
+
+            continue;
+        }
+
+        if (is_letter(*c))
+        {
+            char* word = c;
+            while (is_letter(*c))
+                c++;
+
+            if (!month)
+                month = parse_month(word, (int) (c - word));
+
+            continue;
+        }
+
+        c++;
+    }
+
+    if (!year)
+        return 0;
+
+    if (month)
+    {
+        day = (num_numbers > 0) ? numbers[0] : 0;
+    }
+    else if (num_numbers == 2)
+    {
+        month = (year_first) ? numbers[0] : numbers[1];
+        day   = (year_first) ? numbers[1] : numbers[0];
+    }
+    else if (num_numbers == 1)
+    {
+        month = numbers[0];
+    }
+
+    if (month < 1 || month > 12)
+        month = 0;
+
+    if (day < 1 || day > 31)
+        day = 0;
+
+    return year * 10000 + month * 100 + day;
 }
 
 Persona persona_make()
@@ -104,6 +221,12 @@ void portfolio_free(Portfolio* portfolio)
     if (portfolio->outdir)
         string_free(&portfolio->outdir);
 
+    if (portfolio->project_template)
+        string_free(&portfolio->project_template);
+
+    if (portfolio->skill_template)
+        string_free(&portfolio->skill_template);
+
     da_foreach(Link, link, portfolio->links)
         link_free(link);
     da_free(portfolio->links);
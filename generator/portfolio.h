@@ -11,11 +11,25 @@ typedef struct
     String description;
     DArray(String) skills;
     DArray(String) images;
+
+    // Name of the project's own page, set when the build gets to
+    // the project's persona. Unique within the persona.
+    String page;
+
+    // The date as yyyymmdd so projects can be sorted by it. Parts
+    // that aren't in the date are 0, and so is the whole key if
+    // there's no year in it.
+    int date_key;
 } Project;
 
 Project project_make();
 void project_free(Project* project);
 
+// Reads dates like "3rd July 2019", "Sept 2020" or "2019-07-03".
+// Day and month numbers are taken to be in that order unless the
+// year comes first.
+int parse_date(String date);
+
 typedef struct
 {
     String name;
@@ -46,6 +60,18 @@ typedef struct
     String home_template;
     String page_template;
     String outdir;
+
+    // Optional. Every project gets a page of its own if it's set.
+    String project_template;
+
+    // Optional. Every skill used by a project gets a page listing
+    // the projects that use it if it's set.
+    String skill_template;
+
+    // Most projects on one persona page. Personas with more get
+    // extra pages, 0 puts all of them on one page.
+    int page_size;
+
     DArray(Link) links;
     DArray(Persona) personas;
 } Portfolio;
@@ -0,0 +1,346 @@
+#include "search.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jobs.h"
+#include "containers/hd_assert.h"
+
+// Longest skill name that's indexed, longer ones are cut off.
+#define SEARCH_SKILL_SIZE 256
+
+static Search_Index search_chunk_make()
+{
+    Search_Index index = { 0 };
+    da_make(index.words);
+    da_make(index.skills);
+    return index;
+}
+
+static void free_lookup(Search_Lookup* lookup)
+{
+    dict_foreach(int, bkt, (*lookup))
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free((*lookup));
+}
+
+static void free_terms(DArray(Search_Term) terms)
+{
+    da_foreach(Search_Term, term, terms)
+    {
+        string_free(&term->name);
+        da_free(term->projects);
+    }
+    da_free(terms);
+}
+
+void search_index_free(Search_Index* index)
+{
+    free_terms(index->words);
+    free_lookup(&index->word_index);
+
+    free_terms(index->skills);
+    free_lookup(&index->skill_index);
+}
+
+static Search_Term* get_term(DArray(Search_Term)* terms, Search_Lookup* lookup, char* name)
+{
+    Dict_Bkt(int) bkt = dict_find((*lookup), name);
+    if (bkt != dict_end((*lookup)))
+        return (*terms) + bkt->value;
+
+    Search_Term term = { string_make(name), NULL };
+    da_make(term.projects);
+
+    int term_index = da_size(*terms);
+    da_push_back((*terms), term);
+    dict_put((*lookup), name, term_index);
+
+    return (*terms) + term_index;
+}
+
+// Projects are added in order so each one only has to be
+// checked against the last one in the list.
+static void add_term(DArray(Search_Term)* terms, Search_Lookup* lookup, char* name, uint32_t project)
+{
+    Search_Term* term = get_term(terms, lookup, name);
+
+    int count = da_size(term->projects);
+    if (count == 0 || term->projects[count - 1] != project)
+        da_push_back(term->projects, project);
+}
+
+static char lower(char ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+static int is_word_char(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') || (unsigned char) ch >= 0x80;
+}
+
+// Words are runs of letters and digits. Anything outside of ASCII
+// counts as a letter so words in other scripts stay together.
+// Single letters aren't worth indexing.
+static void add_words(Search_Index* chunk, String text, uint32_t project)
+{
+    if (!text)
+        return;
+
+    char word[SEARCH_TOKEN_SIZE];
+    size_t length = 0;
+
+    for (char* c = text; ; c++)
+    {
+        char ch = lower(*c);
+        if (is_word_char(ch))
+        {
+            if (length + 1 < SEARCH_TOKEN_SIZE)
+                word[length++] = ch;
+
+            continue;
+        }
+
+        if (length > 1)
+        {
+            word[length] = '\0';
+            add_term(&chunk->words, &chunk->word_index, word, project);
+        }
+
+        length = 0;
+
+        if (*c == '\0')
+            break;
+    }
+}
+
+static void add_skill(Search_Index* chunk, String skill, uint32_t project)
+{
+    char name[SEARCH_SKILL_SIZE];
+    size_t length = 0;
+
+    for (char* c = skill; *c && length + 1 < SEARCH_SKILL_SIZE; c++)
+        name[length++] = lower(*c);
+
+    name[length] = '\0';
+    add_term(&chunk->skills, &chunk->skill_index, name, project);
+}
+
+typedef struct
+{
+    Project** projects;
+    int num_projects;
+    Search_Index* chunks;
+} Tokenize_Context;
+
+static void tokenize_job(void* data, int worker, int job)
+{
+    Tokenize_Context* ctx = (Tokenize_Context*) data;
+    Search_Index* chunk = ctx->chunks + job;
+
+    int first = job * SEARCH_CHUNK_SIZE;
+    int end   = first + SEARCH_CHUNK_SIZE;
+    if (end > ctx->num_projects)
+        end = ctx->num_projects;
+
+    for (int i = first; i < end; i++)
+    {
+        Project* project = ctx->projects[i];
+
+        add_words(chunk, project->name, i);
+        add_words(chunk, project->description, i);
+
+        da_foreach(String, skill, project->skills)
+        {
+            add_words(chunk, *skill, i);
+            add_skill(chunk, *skill, i);
+        }
+    }
+}
+
+// Chunks are merged in order so every list of projects
+// stays sorted without having to sort it.
+static void merge_terms(DArray(Search_Term)* terms, Search_Lookup* lookup, DArray(Search_Term) from)
+{
+    da_foreach(Search_Term, from_term, from)
+    {
+        Search_Term* term = get_term(terms, lookup, from_term->name);
+
+        da_foreach(uint32_t, project, from_term->projects)
+            da_push_back(term->projects, *project);
+    }
+}
+
+static int compare_terms(const void* a, const void* b)
+{
+    return strcmp(((Search_Term*) a)->name, ((Search_Term*) b)->name);
+}
+
+Search_Index search_index_make(Portfolio portfolio, int worker_count)
+{
+    Search_Index index = search_chunk_make();
+
+    int num_projects = 0;
+    da_foreach(Persona, persona, portfolio.personas)
+        num_projects += da_size(persona->projects);
+
+    index.num_projects = num_projects;
+    if (num_projects == 0)
+        return index;
+
+    Project** projects = (Project**) malloc(num_projects * sizeof(Project*));
+    hd_assert(projects != NULL);
+
+    int next = 0;
+    da_foreach(Persona, persona, portfolio.personas)
+        da_foreach(Project, project, persona->projects)
+            projects[next++] = project;
+
+    int num_chunks = (num_projects + SEARCH_CHUNK_SIZE - 1) / SEARCH_CHUNK_SIZE;
+    Search_Index* chunks = (Search_Index*) malloc(num_chunks * sizeof(Search_Index));
+    hd_assert(chunks != NULL);
+
+    for (int i = 0; i < num_chunks; i++)
+        chunks[i] = search_chunk_make();
+
+    if (worker_count > num_chunks)
+        worker_count = num_chunks;
+
+    Tokenize_Context ctx = { projects, num_projects, chunks };
+    jobs_run(worker_count, num_chunks, tokenize_job, &ctx);
+
+    for (int i = 0; i < num_chunks; i++)
+    {
+        merge_terms(&index.words, &index.word_index, chunks[i].words);
+        merge_terms(&index.skills, &index.skill_index, chunks[i].skills);
+        search_index_free(chunks + i);
+    }
+
+    free(chunks);
+    free(projects);
+
+    // The lookups point into the lists by position so
+    // they're no use once the lists are sorted.
+    qsort(index.words, da_size(index.words), sizeof(Search_Term), compare_terms);
+    qsort(index.skills, da_size(index.skills), sizeof(Search_Term), compare_terms);
+
+    free_lookup(&index.word_index);
+    free_lookup(&index.skill_index);
+
+    return index;
+}
+
+static void put_varint(DArray(uint8_t)* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        uint8_t byte = (value & 0x7f) | 0x80;
+        da_push_back((*out), byte);
+        value >>= 7;
+    }
+
+    uint8_t byte = value;
+    da_push_back((*out), byte);
+}
+
+static void put_bytes(DArray(uint8_t)* out, char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t byte = data[i];
+        da_push_back((*out), byte);
+    }
+}
+
+// Missing strings are written as empty ones.
+static void put_string(DArray(uint8_t)* out, String str)
+{
+    size_t length = (str) ? strlen(str) : 0;
+    put_varint(out, length);
+    put_bytes(out, str, length);
+}
+
+static void put_terms(DArray(uint8_t)* out, DArray(Search_Term) terms)
+{
+    put_varint(out, da_size(terms));
+
+    da_foreach(Search_Term, term, terms)
+    {
+        put_string(out, term->name);
+        put_varint(out, da_size(term->projects));
+
+        uint32_t last = 0;
+        da_foreach(uint32_t, project, term->projects)
+        {
+            put_varint(out, *project - last);
+            last = *project;
+        }
+    }
+}
+
+// Skills from first to end all start with the same depth bytes.
+static void put_trie(DArray(uint8_t)* out, DArray(Search_Term) skills, int first, int end, int depth)
+{
+    int ends_here = first < end && skills[first].name[depth] == '\0';
+    put_varint(out, (ends_here) ? first + 1 : 0);
+
+    if (ends_here)
+        first++;
+
+    int num_children = 0;
+    for (int i = first; i < end; num_children++)
+    {
+        char byte = skills[i].name[depth];
+        while (i < end && skills[i].name[depth] == byte)
+            i++;
+    }
+
+    put_varint(out, num_children);
+
+    for (int i = first; i < end;)
+    {
+        char byte = skills[i].name[depth];
+
+        int child_end = i;
+        while (child_end < end && skills[child_end].name[depth] == byte)
+            child_end++;
+
+        put_bytes(out, &byte, 1);
+        put_trie(out, skills, i, child_end, depth + 1);
+        i = child_end;
+    }
+}
+
+DArray(uint8_t) search_index_encode(Search_Index* index, Portfolio portfolio, int with_pages)
+{
+    DArray(uint8_t) out = NULL;
+    da_make(out);
+
+    put_bytes(&out, SEARCH_MAGIC, 4);
+
+    uint8_t version = SEARCH_VERSION;
+    da_push_back(out, version);
+
+    put_varint(&out, da_size(portfolio.personas));
+    da_foreach(Persona, persona, portfolio.personas)
+        put_string(&out, persona->name);
+
+    put_varint(&out, index->num_projects);
+    for (int i = 0; i < da_size(portfolio.personas); i++)
+    {
+        da_foreach(Project, project, portfolio.personas[i].projects)
+        {
+            put_varint(&out, i);
+            put_string(&out, project->name);
+            put_string(&out, (with_pages) ? project->page : NULL);
+        }
+    }
+
+    put_terms(&out, index->words);
+    put_terms(&out, index->skills);
+    put_trie(&out, index->skills, 0, da_size(index->skills), 0);
+
+    return out;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include "portfolio.h"
+#include "containers/string.h"
+#include "containers/darray.h"
+#include "containers/dictionary.h"
+
+#define SEARCH_FILE "search.idx"
+#define SEARCH_MAGIC "SWGS"
+#define SEARCH_VERSION 1
+
+// Longest word that's indexed, longer ones are cut off.
+#define SEARCH_TOKEN_SIZE 64
+
+// Projects tokenized by one job.
+#define SEARCH_CHUNK_SIZE 256
+
+/*
+    A search index for the site, small enough to be downloaded and
+    searched by a script on the page. Projects are numbered in the
+    order they're in the portfolio.
+
+    Numbers are unsigned LEB128 varints and strings are a varint
+    length followed by that many bytes. The file is:
+
+        "SWGS", u8 version
+        personas:  count, then each name
+        projects:  count, then for each its persona, name and page
+                   (empty if there are no project pages)
+        words:     count, then sorted by word, each word followed by
+                   the projects it's in (see below)
+        skills:    count, then sorted, each skill in lower case
+                   followed by the projects that have it
+        skill trie
+
+    Words come from project names, descriptions and skills, in lower
+    case. Lists of projects are a count and then the gaps between the
+    project numbers, in increasing order, so the first gap is the
+    first project.
+
+    The trie is over the lower case skill names, one byte at each
+    step. A node is the skill that ends there plus one (0 if none),
+    the number of children and then each child as its byte followed
+    by its node.
+*/
+
+typedef struct
+{
+    String name;
+    DArray(uint32_t) projects;
+} Search_Term;
+
+// Where each term is in its list while the index is being built.
+typedef Dict(int) Search_Lookup;
+
+typedef struct
+{
+    DArray(Search_Term) words;
+    Search_Lookup word_index;
+
+    DArray(Search_Term) skills;
+    Search_Lookup skill_index;
+
+    int num_projects;
+} Search_Index;
+
+// Projects are tokenized on worker_count threads.
+Search_Index search_index_make(Portfolio portfolio, int worker_count);
+void search_index_free(Search_Index* index);
+
+// Serializes the index. Project pages are only listed if with_pages
+// is set. The caller owns the returned buffer.
+DArray(uint8_t) search_index_encode(Search_Index* index, Portfolio portfolio, int with_pages);
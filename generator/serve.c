@@ -0,0 +1,726 @@
+#include "serve.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+
+int serve_site(String portfolio_path, int port)
+{
+    printf("Error: --serve isn't supported on Windows yet\n");
+    return 0;
+}
+
+#else
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "build.h"
+#include "parser.h"
+#include "portfolio.h"
+#include "watch.h"
+#include "webpage.h"
+#include "filestuff.h"
+#include "assets.h"
+#include "containers/hd_assert.h"
+
+typedef struct
+{
+    int page;
+    int number;
+    int project;
+    int skill;
+    String output;
+    size_t length;
+    unsigned long long last_used;
+} Cached_Page;
+
+typedef struct
+{
+    String portfolio_path;
+    Portfolio portfolio;
+    Skill_Map skills;
+    View_Cache views;
+    Build_Cache templates;
+    Generator generator;
+    Watcher watcher;
+
+    // Directories (ending in '/') and files outside the output that
+    // the templates and portfolio reference, like res/ for res/hero.png.
+    // Static files aren't served from anywhere else.
+    DArray(String) static_paths;
+
+    // Set when the sources changed since they were last loaded.
+    int stale;
+    int loaded;
+
+    Cached_Page pages[SERVE_CACHE_PAGES];
+    unsigned long long tick;
+} Preview;
+
+static void clear_pages(Preview* preview)
+{
+    for (int i = 0; i < SERVE_CACHE_PAGES; i++)
+    {
+        if (preview->pages[i].output)
+            string_free(&preview->pages[i].output);
+
+        preview->pages[i].page = -1;
+    }
+}
+
+static void clear_static_paths(Preview* preview)
+{
+    da_foreach(String, path, preview->static_paths)
+        string_free(path);
+
+    da_clear(preview->static_paths);
+}
+
+static void add_static_path(Preview* preview, char* path, size_t length)
+{
+    String str = string_make_till_n(path, length);
+
+    da_foreach(String, it, preview->static_paths)
+    {
+        if (string_cmp(*it, str))
+        {
+            string_free(&str);
+            return;
+        }
+    }
+
+    da_push_back(preview->static_paths, str);
+}
+
+// Collects where the files the pages reference live. Files in a
+// directory allow the whole directory, files at the top only allow
+// themselves so the portfolio and templates next to them aren't served.
+static void find_static_paths(Preview* preview)
+{
+    Asset_Map assets = asset_map_make();
+    Build_Cache* templates = &preview->templates;
+
+    stages_add_assets(templates->home.tp.stages, &assets);
+    stages_add_assets(templates->page.tp.stages, &assets);
+
+    if (templates->project.tp.stages)
+        stages_add_assets(templates->project.tp.stages, &assets);
+
+    if (templates->skill.tp.stages)
+        stages_add_assets(templates->skill.tp.stages, &assets);
+
+    assets_add_portfolio(&assets, preview->portfolio);
+
+    da_foreach(Asset, asset, assets.assets)
+    {
+        char* path = asset->path;
+        if (strncmp(path, "./", 2) == 0)
+            path += 2;
+
+        char* slash = strrchr(path, '/');
+        size_t length = (slash) ? (size_t) (slash - path) + 1 : strlen(path);
+        add_static_path(preview, path, length);
+    }
+
+    asset_map_free(&assets);
+}
+
+// Loads the portfolio and templates again. Returns 0 and
+// leaves the preview empty if anything is wrong with them.
+static int load_sources(Preview* preview)
+{
+    clear_pages(preview);
+    clear_static_paths(preview);
+
+    if (preview->loaded)
+    {
+        // Views point into the portfolio.
+        view_cache_free(&preview->views);
+        view_cache_make(&preview->views);
+
+        skill_map_free(&preview->skills);
+        portfolio_free(&preview->portfolio);
+    }
+
+    preview->loaded = 0;
+    preview->stale  = 0;
+
+    String contents = load_file(preview->portfolio_path);
+    if (!contents)
+    {
+        printf("Error: Couldn't read %s\n", preview->portfolio_path);
+        return 0;
+    }
+
+    Lexer lexer = lexer_make(contents);
+    lexer_lex(&lexer);
+
+    Parser parser = parser_make(lexer.tokens);
+    Portfolio portfolio;
+
+    if (lexer.status == LEXER_FAILURE)
+    {
+        printf("%s\n", lexer.message);
+        portfolio = portfolio_make();
+    }
+    else
+    {
+        portfolio = parser_parse(&parser);
+    }
+
+    if (parser.status == PARSER_FAILURE)
+        printf("%s\n", parser.message);
+
+    int res = lexer.status != LEXER_FAILURE && parser.status != PARSER_FAILURE;
+
+    // The tokens belong to the lexer.
+    parser.tokens = NULL;
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    if (res && (!portfolio.home_template || !portfolio.page_template))
+    {
+        printf("Template not found.\n");
+        res = 0;
+    }
+
+    if (res)
+    {
+        watcher_add(&preview->watcher, portfolio.home_template);
+        watcher_add(&preview->watcher, portfolio.page_template);
+
+        if (portfolio.project_template)
+            watcher_add(&preview->watcher, portfolio.project_template);
+
+        if (portfolio.skill_template)
+            watcher_add(&preview->watcher, portfolio.skill_template);
+
+        Webpage_Status status = build_cache_load_templates(&preview->templates, portfolio);
+        if (status == WP_MISSING_TEMPLATE)
+            printf("Template not found.\n");
+
+        res = status == WP_SUCCESS;
+    }
+
+    if (!res)
+    {
+        portfolio_free(&portfolio);
+        return 0;
+    }
+
+    da_foreach(Persona, persona, portfolio.personas)
+        persona_name_projects(persona);
+
+    preview->portfolio = portfolio;
+    preview->skills = skill_map_make(portfolio);
+    preview->generator.skills = &preview->skills;
+    preview->loaded = 1;
+
+    find_static_paths(preview);
+    return 1;
+}
+
+// Page 0 is the home page, page i is for persona i - 1 and number
+// is which of the persona's pages it is. Project is set to the
+// persona's project for project pages and skill to the skill for
+// skill pages, they're -1 otherwise. Skill pages are page 0 as
+// they aren't about a persona. Returns -1 if the name isn't a page.
+static int find_page(Preview* preview, char* name, int* number, int* project, int* skill)
+{
+    *number  = 1;
+    *project = -1;
+    *skill   = -1;
+
+    if (strcmp(name, "index.html") == 0)
+        return 0;
+
+    size_t len = strlen(name);
+    if (len < 5 || strcmp(name + len - 5, ".html") != 0)
+        return -1;
+
+    for (int i = 0; i < da_size(preview->portfolio.personas); i++)
+    {
+        int count = persona_page_count(preview->portfolio, i);
+        for (int j = 1; j <= count; j++)
+        {
+            char page[PAGE_NAME_SIZE];
+            page_name(page, preview->portfolio.personas[i], j);
+
+            if (strcmp(page, name) == 0)
+            {
+                *number = j;
+                return i + 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < da_size(preview->portfolio.personas) && preview->portfolio.project_template; i++)
+    {
+        DArray(Project) projects = preview->portfolio.personas[i].projects;
+        for (int j = 0; j < da_size(projects); j++)
+        {
+            if (strcmp(projects[j].page, name) == 0)
+            {
+                *project = j;
+                return i + 1;
+            }
+        }
+    }
+
+    Skill* found = (preview->portfolio.skill_template) ? skill_map_find_page(&preview->skills, name) : NULL;
+    if (found)
+    {
+        *skill = found - preview->skills.skills;
+        return 0;
+    }
+
+    return -1;
+}
+
+// Returns the cached page, rendering it first if it isn't
+// cached yet. Returns NULL if the page failed to render.
+static Cached_Page* get_page(Preview* preview, int page, int number, int project, int skill)
+{
+    Cached_Page* slot = preview->pages;
+    preview->tick++;
+
+    for (int i = 0; i < SERVE_CACHE_PAGES; i++)
+    {
+        Cached_Page* cached = preview->pages + i;
+        if (cached->page == page && cached->number == number && cached->project == project &&
+            cached->skill == skill)
+        {
+            cached->last_used = preview->tick;
+            return cached;
+        }
+
+        if (cached->page < 0 || (slot->page >= 0 && cached->last_used < slot->last_used))
+            slot = cached;
+    }
+
+    Generator* gen = &preview->generator;
+    gen->stages = (page == 0) ? preview->templates.home.tp.stages : preview->templates.page.tp.stages;
+
+    // The output is copied out before the page info goes away.
+    Page_Info info = page_info_make(preview->portfolio, page - 1, number);
+
+    generator_reset(gen);
+    gen->page = &info;
+
+    if (project >= 0)
+    {
+        gen->stages  = preview->templates.project.tp.stages;
+        gen->page    = NULL;
+        gen->project = preview->portfolio.personas[page - 1].projects + project;
+    }
+
+    if (skill >= 0)
+    {
+        gen->stages = preview->templates.skill.tp.stages;
+        gen->page   = NULL;
+        gen->skill  = preview->skills.skills + skill;
+    }
+
+    generate_page(gen, preview->portfolio, page - 1);
+    gen->page    = NULL;
+    gen->project = NULL;
+    gen->skill   = NULL;
+
+    if (gen->status == GEN_FAILURE)
+    {
+        page_info_free(&info);
+        printf("%s\n", gen->message);
+        return NULL;
+    }
+
+    if (slot->output)
+        string_free(&slot->output);
+
+    slot->page      = page;
+    slot->number    = number;
+    slot->project   = project;
+    slot->skill     = skill;
+    slot->output    = generator_output(*gen);
+    slot->length    = gen->output_size;
+    slot->last_used = preview->tick;
+
+    page_info_free(&info);
+    return slot;
+}
+
+static int send_all(int fd, char* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t sent = send(fd, data, length, 0);
+        if (sent < 0 && errno == EINTR)
+            continue;
+
+        if (sent <= 0)
+            return 0;
+
+        data   += sent;
+        length -= sent;
+    }
+
+    return 1;
+}
+
+static int send_file(int fd, int file, size_t length)
+{
+    #ifdef __linux__
+    off_t offset = 0;
+    while (offset < (off_t) length)
+    {
+        ssize_t sent = sendfile(fd, file, &offset, length - offset);
+        if (sent < 0 && errno == EINTR)
+            continue;
+
+        if (sent <= 0)
+            return 0;
+    }
+
+    return 1;
+    #else
+    char buffer[16 * 1024];
+    ssize_t len;
+    while ((len = read(file, buffer, sizeof(buffer))) > 0)
+        if (!send_all(fd, buffer, len))
+            return 0;
+
+    return len == 0;
+    #endif
+}
+
+static void send_headers(int fd, char* status, char* type, size_t length)
+{
+    char headers[512];
+    int len = snprintf(headers, sizeof(headers),
+                       "HTTP/1.1 %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "Content-Length: %zu\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Connection: close\r\n"
+                       "\r\n",
+                       status, type, length);
+
+    send_all(fd, headers, len);
+}
+
+static void send_error(int fd, char* status, int head)
+{
+    send_headers(fd, status, "text/plain", strlen(status) + 1);
+
+    if (!head)
+    {
+        send_all(fd, status, strlen(status));
+        send_all(fd, "\n", 1);
+    }
+}
+
+static char* content_type(char* path)
+{
+    static char* types[][2] =
+    {
+        { ".html", "text/html; charset=utf-8" },
+        { ".css",  "text/css" },
+        { ".js",   "text/javascript" },
+        { ".json", "application/json" },
+        { ".svg",  "image/svg+xml" },
+        { ".png",  "image/png" },
+        { ".jpg",  "image/jpeg" },
+        { ".jpeg", "image/jpeg" },
+        { ".gif",  "image/gif" },
+        { ".webp", "image/webp" },
+        { ".ico",  "image/x-icon" },
+        { ".woff", "font/woff" },
+        { ".woff2", "font/woff2" },
+        { ".txt",  "text/plain; charset=utf-8" },
+        { ".pdf",  "application/pdf" },
+    };
+
+    char* ext = strrchr(path, '.');
+    if (!ext || strchr(ext, '/'))
+        return "application/octet-stream";
+
+    for (int i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+        if (strcasecmp(ext, types[i][0]) == 0)
+            return types[i][1];
+
+    return "application/octet-stream";
+}
+
+static int hex_value(char ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Decodes %XX escapes in place and cuts off the query string.
+// Returns 0 for paths that try to leave the served directories,
+// including ones like //etc/hostname that decode to absolute paths.
+static int decode_path(char* path)
+{
+    char* out = path;
+    for (char* in = path; *in && *in != '?' && *in != '#'; in++)
+    {
+        if (*in == '%' && hex_value(in[1]) >= 0 && hex_value(in[2]) >= 0)
+        {
+            *out++ = (char) (hex_value(in[1]) * 16 + hex_value(in[2]));
+            in += 2;
+        }
+        else
+        {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+
+    return path[0] == '/' && path[1] != '/' && !strstr(path, "..") && !strchr(path, '\\') &&
+           (size_t) (out - path) == strlen(path);
+}
+
+// Only files the pages reference are served from outside the output.
+static int is_static_path(Preview* preview, char* name)
+{
+    da_foreach(String, path, preview->static_paths)
+    {
+        size_t length = strlen(*path);
+
+        if ((*path)[length - 1] == '/')
+        {
+            if (strncmp(name, *path, length) == 0)
+                return 1;
+        }
+        else if (strcmp(name, *path) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Static files come from the output directory if it has them,
+// otherwise from where the pages reference them.
+static int serve_static(Preview* preview, int fd, char* name, int head)
+{
+    if (!preview->loaded || name[0] == '\0' || name[0] == '/')
+        return 0;
+
+    char filepath[1024];
+    int file = -1;
+
+    if (preview->portfolio.outdir)
+    {
+        snprintf(filepath, sizeof(filepath), "%s/%s", preview->portfolio.outdir, name);
+        file = open(filepath, O_RDONLY);
+    }
+
+    if (file < 0 && is_static_path(preview, name))
+        file = open(name, O_RDONLY);
+
+    struct stat st;
+    if (file < 0 || fstat(file, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        if (file >= 0)
+            close(file);
+
+        return 0;
+    }
+
+    send_headers(fd, "200 OK", content_type(name), st.st_size);
+    if (!head)
+        send_file(fd, file, st.st_size);
+
+    close(file);
+    return 1;
+}
+
+static void handle_request(Preview* preview, int fd)
+{
+    char request[SERVE_REQUEST_SIZE];
+    size_t used = 0;
+
+    // Only the request line matters, so headers past the
+    // size of the buffer just get ignored.
+    while (used < sizeof(request) - 1)
+    {
+        ssize_t len = recv(fd, request + used, sizeof(request) - 1 - used, 0);
+        if (len < 0 && errno == EINTR)
+            continue;
+
+        if (len <= 0)
+            break;
+
+        used += len;
+        request[used] = '\0';
+
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+            break;
+    }
+    request[used] = '\0';
+
+    char method[16], path[2048];
+    if (sscanf(request, "%15s %2047s", method, path) != 2)
+    {
+        send_error(fd, "400 Bad Request", 0);
+        return;
+    }
+
+    int head = strcmp(method, "HEAD") == 0;
+    if (!head && strcmp(method, "GET") != 0)
+    {
+        send_error(fd, "405 Method Not Allowed", 0);
+        return;
+    }
+
+    if (!decode_path(path))
+    {
+        send_error(fd, "404 Not Found", head);
+        return;
+    }
+
+    char* name = (strcmp(path, "/") == 0) ? "index.html" : path + 1;
+
+    if (preview->stale || !preview->loaded)
+        load_sources(preview);
+
+    int number, project, skill;
+    int page = (preview->loaded) ? find_page(preview, name, &number, &project, &skill) : -1;
+    if (page >= 0)
+    {
+        Cached_Page* cached = get_page(preview, page, number, project, skill);
+        if (!cached)
+        {
+            send_error(fd, "500 Internal Server Error", head);
+            return;
+        }
+
+        send_headers(fd, "200 OK", "text/html; charset=utf-8", cached->length);
+        if (!head)
+            send_all(fd, cached->output, cached->length);
+
+        return;
+    }
+
+    if (!serve_static(preview, fd, name, head))
+    {
+        int broken = !preview->loaded && strcmp(name, "index.html") == 0;
+        send_error(fd, (broken) ? "500 Internal Server Error" : "404 Not Found", head);
+    }
+}
+
+int serve_site(String portfolio_path, int port)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        printf("Error: Couldn't create a socket\n");
+        return 0;
+    }
+
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listener, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(listener, 16) != 0)
+    {
+        printf("Error: Couldn't listen on port %d\n", port);
+        close(listener);
+        return 0;
+    }
+
+    // Browsers hang up all the time, that shouldn't end the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    Preview preview = { 0 };
+    preview.portfolio_path = portfolio_path;
+    preview.templates = build_cache_make();
+    preview.generator = generator_make(NULL);
+    view_cache_make(&preview.views);
+    preview.generator.views = &preview.views;
+    preview.watcher = watcher_make();
+    watcher_add(&preview.watcher, portfolio_path);
+    da_make(preview.static_paths);
+
+    clear_pages(&preview);
+    load_sources(&preview);
+
+    printf("Serving on http://localhost:%d/\n", port);
+    fflush(stdout);
+
+    while (1)
+    {
+        struct pollfd fds[2] = { { listener, POLLIN, 0 }, { preview.watcher.fd, POLLIN, 0 } };
+        int num_fds = (preview.watcher.fd >= 0) ? 2 : 1;
+        int timeout = (preview.watcher.fd >= 0) ? -1 : WATCH_POLL_MS;
+
+        int res = poll(fds, num_fds, timeout);
+        if (res < 0 && errno != EINTR)
+            break;
+
+        if (watcher_check(&preview.watcher) && !preview.stale)
+        {
+            preview.stale = 1;
+            printf("Sources changed, pages will be rendered again\n");
+            fflush(stdout);
+        }
+
+        if (res > 0 && (fds[0].revents & POLLIN))
+        {
+            int fd = accept(listener, NULL, NULL);
+            if (fd < 0)
+                continue;
+
+            // Don't let a client that never sends anything hang the server.
+            struct timeval tv = { 5, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+            handle_request(&preview, fd);
+            close(fd);
+            fflush(stdout);
+        }
+    }
+
+    close(listener);
+    clear_pages(&preview);
+    if (preview.loaded)
+    {
+        skill_map_free(&preview.skills);
+        portfolio_free(&preview.portfolio);
+    }
+    view_cache_free(&preview.views);
+    generator_free(&preview.generator);
+    watcher_free(&preview.watcher);
+    build_cache_free(&preview.templates);
+
+    clear_static_paths(&preview);
+    da_free(preview.static_paths);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "containers/string.h"
+
+#define SERVE_DEFAULT_PORT 8080
+
+// Number of rendered pages kept in memory. The least
+// recently used one is dropped to make room for more.
+#define SERVE_CACHE_PAGES 64
+
+#define SERVE_REQUEST_SIZE (8 * 1024)
+
+/*
+    Serves a preview of the site on localhost. Pages are rendered
+    when they're asked for, straight from the portfolio and templates
+    in memory, and nothing is ever written to the output directory.
+    Anything that isn't a page is sent from disk, either from the
+    output directory or the current one. Whenever the portfolio or a
+    template changes everything is loaded again on the next request.
+    Returns 0 if the server couldn't be started.
+*/
+int serve_site(String portfolio_path, int port);
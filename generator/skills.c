@@ -0,0 +1,122 @@
+#include "skills.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "webpage.h"
+#include "containers/hd_assert.h"
+
+// Longest skill name that's told apart from others.
+#define SKILL_KEY_SIZE 256
+
+static void make_key(char* key, String name)
+{
+    size_t length = 0;
+    for (char* c = name; *c && length + 1 < SKILL_KEY_SIZE; c++)
+        key[length++] = (*c >= 'A' && *c <= 'Z') ? *c + ('a' - 'A') : *c;
+
+    key[length] = '\0';
+}
+
+// Pages are named skill--<slug>.html. Skills whose names come out
+// the same get numbers after the first.
+static void name_pages(Skill_Map* map)
+{
+    Dict(int) taken = { 0 };
+
+    da_foreach(Skill, skill, map->skills)
+    {
+        char slug[PAGE_NAME_SIZE - 24];
+        if (name_slug(slug, sizeof(slug), skill->name) == 0)
+            strcpy(slug, "skill");
+
+        char name[PAGE_NAME_SIZE];
+        sprintf(name, "skill--%s.html", slug);
+
+        for (int n = 2; dict_find(taken, name) != dict_end(taken); n++)
+            sprintf(name, "skill--%s-%d.html", slug, n);
+
+        skill->page = string_make(name);
+        dict_put(taken, skill->page, 1);
+    }
+
+    dict_foreach(int, bkt, taken)
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free(taken);
+}
+
+Skill_Map skill_map_make(Portfolio portfolio)
+{
+    Skill_Map map = { 0 };
+    da_make(map.skills);
+
+    char key[SKILL_KEY_SIZE];
+    int num_personas = da_size(portfolio.personas);
+
+    for (int i = 0; i < num_personas; i++)
+    {
+        DArray(Project) projects = portfolio.personas[i].projects;
+        int num_projects = da_size(projects);
+
+        for (int j = 0; j < num_projects; j++)
+        {
+            Project_Ref ref = { i, j };
+
+            da_foreach(String, name, projects[j].skills)
+            {
+                make_key(key, *name);
+
+                Skill* skill;
+                Dict_Bkt(int) bkt = dict_find(map.lookup, key);
+                if (bkt != dict_end(map.lookup))
+                {
+                    skill = map.skills + bkt->value;
+                }
+                else
+                {
+                    Skill new_skill = { string_make(*name), NULL, NULL };
+                    da_make(new_skill.projects);
+
+                    int skill_index = da_size(map.skills);
+                    da_push_back(map.skills, new_skill);
+                    dict_put(map.lookup, key, skill_index);
+                    skill = map.skills + skill_index;
+                }
+
+                // Projects that list a skill twice only go in once.
+                int count = da_size(skill->projects);
+                Project_Ref* last = skill->projects + count - 1;
+                if (count == 0 || last->persona != i || last->project != j)
+                    da_push_back(skill->projects, ref);
+            }
+        }
+    }
+
+    name_pages(&map);
+    return map;
+}
+
+void skill_map_free(Skill_Map* map)
+{
+    da_foreach(Skill, skill, map->skills)
+    {
+        string_free(&skill->name);
+        string_free(&skill->page);
+        da_free(skill->projects);
+    }
+    da_free(map->skills);
+
+    dict_foreach(int, bkt, map->lookup)
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free(map->lookup);
+}
+
+Skill* skill_map_find_page(Skill_Map* map, char* page)
+{
+    da_foreach(Skill, skill, map->skills)
+        if (strcmp(skill->page, page) == 0)
+            return skill;
+
+    return NULL;
+}
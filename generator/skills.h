@@ -0,0 +1,42 @@
+#pragma once
+
+#include "portfolio.h"
+#include "containers/string.h"
+#include "containers/darray.h"
+#include "containers/dictionary.h"
+
+// Where a project is in the portfolio, so projects
+// can be listed without copying them.
+typedef struct
+{
+    int persona;
+    int project;
+} Project_Ref;
+
+typedef struct
+{
+    // Spelled the way it was first seen. Skills that only differ
+    // in case are the same skill.
+    String name;
+    String page;
+    DArray(Project_Ref) projects;
+} Skill;
+
+typedef Dict(int) Skill_Lookup;
+
+/*
+    Every distinct skill across all personas with the projects that
+    use it, in the order they first show up. Built in one pass over
+    the skills of every project, with a hash table from the lower
+    case name to the skill.
+*/
+typedef struct
+{
+    DArray(Skill) skills;
+    Skill_Lookup lookup;
+} Skill_Map;
+
+Skill_Map skill_map_make(Portfolio portfolio);
+void skill_map_free(Skill_Map* map);
+
+Skill* skill_map_find_page(Skill_Map* map, char* page);
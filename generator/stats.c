@@ -0,0 +1,247 @@
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+static const char* phase_names[NUM_STAT_PHASES] = {
+    "load",
+    "lex",
+    "parse",
+    "templates",
+    "render",
+    "write"
+};
+
+#ifdef _WIN32
+
+static double filetime_seconds(FILETIME time)
+{
+    ULARGE_INTEGER value;
+    value.LowPart  = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    return value.QuadPart / 1e7;
+}
+
+static double thread_cpu_now()
+{
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user))
+        return 0;
+
+    return filetime_seconds(kernel) + filetime_seconds(user);
+}
+
+static double process_cpu_now()
+{
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+        return 0;
+
+    return filetime_seconds(kernel) + filetime_seconds(user);
+}
+
+// In KB.
+static long peak_rss()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return (long) (counters.PeakWorkingSetSize / 1024);
+}
+
+#else
+
+static double clock_seconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double thread_cpu_now()
+{
+    return clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+}
+
+static double process_cpu_now()
+{
+    return clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+static long peak_rss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    // Bytes on macOS, KB everywhere else.
+    #ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+    #else
+    return usage.ru_maxrss;
+    #endif
+}
+
+#endif // _WIN32
+
+void stats_make(Build_Stats* stats)
+{
+    mutex_make(&stats->lock);
+    stats_reset(stats);
+}
+
+void stats_free(Build_Stats* stats)
+{
+    mutex_free(&stats->lock);
+}
+
+void stats_reset(Build_Stats* stats)
+{
+    memset(stats->phases, 0, sizeof(stats->phases));
+    stats->started     = time_now();
+    stats->cpu_started = process_cpu_now();
+
+    stats->tokens = 0;
+    stats->stages = 0;
+
+    stats->pages_rendered  = 0;
+    stats->pages_written   = 0;
+    stats->pages_unchanged = 0;
+    stats->pages_skipped   = 0;
+    stats->bytes_rendered  = 0;
+    stats->largest_page    = 0;
+}
+
+Stat_Span stats_begin(Build_Stats* stats, Stat_Phase phase)
+{
+    Stat_Span span = { 0 };
+    span.phase = phase;
+    span.trace = trace_begin(phase_names[phase]);
+
+    if (!stats)
+        return span;
+
+    mutex_lock(&stats->lock);
+
+    Phase_Stats* p = stats->phases + phase;
+    if (p->active++ == 0)
+        p->entered = time_now();
+
+    mutex_unlock(&stats->lock);
+
+    span.cpu = thread_cpu_now();
+    return span;
+}
+
+void stats_end(Build_Stats* stats, Stat_Span span)
+{
+    trace_end(span.trace, NULL);
+
+    if (!stats)
+        return;
+
+    double cpu = thread_cpu_now() - span.cpu;
+
+    mutex_lock(&stats->lock);
+
+    Phase_Stats* p = stats->phases + span.phase;
+    p->cpu += cpu;
+
+    if (--p->active == 0)
+        p->wall += time_now() - p->entered;
+
+    mutex_unlock(&stats->lock);
+}
+
+void stats_add_page(Build_Stats* stats, size_t bytes)
+{
+    if (!stats)
+        return;
+
+    mutex_lock(&stats->lock);
+
+    stats->pages_rendered++;
+    stats->bytes_rendered += bytes;
+
+    if (bytes > stats->largest_page)
+        stats->largest_page = bytes;
+
+    mutex_unlock(&stats->lock);
+}
+
+static int write_json(Build_Stats* stats, char* path, double wall, double cpu, long rss)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return 0;
+
+    fprintf(file, "{\n    \"phases\": {\n");
+    for (int i = 0; i < NUM_STAT_PHASES; i++)
+    {
+        fprintf(file, "        \"%s\": { \"wall_ms\": %.3f, \"cpu_ms\": %.3f }%s\n",
+                phase_names[i], stats->phases[i].wall * 1000, stats->phases[i].cpu * 1000,
+                (i + 1 < NUM_STAT_PHASES) ? "," : "");
+    }
+    fprintf(file, "    },\n");
+
+    size_t average = (stats->pages_rendered) ? stats->bytes_rendered / stats->pages_rendered : 0;
+
+    fprintf(file, "    \"total\": { \"wall_ms\": %.3f, \"cpu_ms\": %.3f },\n", wall * 1000, cpu * 1000);
+    fprintf(file, "    \"tokens\": %zu,\n", stats->tokens);
+    fprintf(file, "    \"stages\": %zu,\n", stats->stages);
+    fprintf(file, "    \"pages\": { \"rendered\": %d, \"written\": %d, \"unchanged\": %d, \"skipped\": %d },\n",
+            stats->pages_rendered, stats->pages_written, stats->pages_unchanged, stats->pages_skipped);
+    fprintf(file, "    \"bytes_rendered\": %zu,\n", stats->bytes_rendered);
+    fprintf(file, "    \"bytes_per_page\": %zu,\n", average);
+    fprintf(file, "    \"largest_page\": %zu,\n", stats->largest_page);
+    fprintf(file, "    \"peak_rss_kb\": %ld\n", rss);
+    fprintf(file, "}\n");
+
+    int res = !ferror(file);
+    return fclose(file) == 0 && res;
+}
+
+int stats_report(Build_Stats* stats, char* json_path)
+{
+    double wall = time_now() - stats->started;
+    double cpu  = process_cpu_now() - stats->cpu_started;
+    long rss = peak_rss();
+
+    printf("Stats:\n");
+    printf("    %-10s %10s %10s\n", "phase", "wall ms", "cpu ms");
+
+    for (int i = 0; i < NUM_STAT_PHASES; i++)
+        printf("    %-10s %10.2f %10.2f\n", phase_names[i], stats->phases[i].wall * 1000, stats->phases[i].cpu * 1000);
+
+    printf("    %-10s %10.2f %10.2f\n", "total", wall * 1000, cpu * 1000);
+
+    printf("    %zu tokens, %zu stages\n", stats->tokens, stats->stages);
+    printf("    %d pages rendered, %d written, %d unchanged, %d skipped\n",
+           stats->pages_rendered, stats->pages_written, stats->pages_unchanged, stats->pages_skipped);
+
+    if (stats->pages_rendered > 0)
+    {
+        printf("    %.1f KB rendered, %.1f KB per page, %.1f KB largest\n",
+               stats->bytes_rendered / 1024.0,
+               stats->bytes_rendered / 1024.0 / stats->pages_rendered,
+               stats->largest_page / 1024.0);
+    }
+
+    printf("    %ld KB peak memory\n", rss);
+
+    if (json_path && !write_json(stats, json_path, wall, cpu, rss))
+    {
+        printf("Error: Couldn't write %s\n", json_path);
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include "threads.h"
+#include "trace.h"
+
+typedef enum
+{
+    STAT_LOAD,
+    STAT_LEX,
+    STAT_PARSE,
+    STAT_TEMPLATES,
+    STAT_RENDER,
+    STAT_WRITE,
+    NUM_STAT_PHASES
+} Stat_Phase;
+
+typedef struct
+{
+    // Wall is how long at least one thread was in the phase, so
+    // phases that run on several threads at once aren't counted
+    // twice. CPU is the time every thread spent in it added up.
+    double wall;
+    double cpu;
+
+    int active;
+    double entered;
+} Phase_Stats;
+
+/*
+    Where a build spent its time and how much it got through, for
+    --stats. Phases overlap (templates parse while the portfolio is
+    still being read and pages are written while others render) so
+    the phase times don't add up to the total. Any thread can add to
+    it so everything goes through the lock.
+*/
+typedef struct
+{
+    Mutex lock;
+    Phase_Stats phases[NUM_STAT_PHASES];
+    double started;
+    double cpu_started;
+
+    size_t tokens;
+    size_t stages;
+
+    int pages_rendered;
+    int pages_written;
+    int pages_unchanged;
+    int pages_skipped;
+    size_t bytes_rendered;
+    size_t largest_page;
+} Build_Stats;
+
+typedef struct
+{
+    Stat_Phase phase;
+    double cpu;
+    Trace_Span trace;
+} Stat_Span;
+
+// The stats can't be moved once they're made.
+void stats_make(Build_Stats* stats);
+void stats_free(Build_Stats* stats);
+
+// Clears everything for the next build in watch mode.
+void stats_reset(Build_Stats* stats);
+
+// Spans are timed on the calling thread. Stats can be NULL,
+// in which case nothing is timed. Spans also go in the trace
+// under the phase's name when tracing is on.
+Stat_Span stats_begin(Build_Stats* stats, Stat_Phase phase);
+void stats_end(Build_Stats* stats, Stat_Span span);
+
+void stats_add_page(Build_Stats* stats, size_t bytes);
+
+// Prints the stats and writes them as JSON to json_path if it
+// isn't NULL. Returns 0 if the JSON couldn't be written.
+int stats_report(Build_Stats* stats, char* json_path);
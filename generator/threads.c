@@ -0,0 +1,192 @@
+#include "threads.h"
+
+#include <stdlib.h>
+#include "trace.h"
+#include "containers/hd_assert.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// Both APIs want a different signature for the thread
+// function so the actual proc gets passed along in here.
+typedef struct
+{
+    Thread_Proc proc;
+    void* data;
+} Thread_Start;
+
+#ifdef _WIN32
+
+static DWORD WINAPI thread_start(LPVOID param)
+{
+    Thread_Start start = *(Thread_Start*) param;
+    free(param);
+    start.proc(start.data);
+    trace_thread_done();
+    return 0;
+}
+
+int thread_create(Thread* thread, Thread_Proc proc, void* data)
+{
+    Thread_Start* start = (Thread_Start*) malloc(sizeof(Thread_Start));
+    hd_assert(start != NULL);
+    start->proc = proc;
+    start->data = data;
+
+    thread->handle = CreateThread(NULL, 0, thread_start, start, 0, NULL);
+    if (!thread->handle)
+    {
+        free(start);
+        return 0;
+    }
+
+    return 1;
+}
+
+void thread_join(Thread* thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+void mutex_make(Mutex* mutex)
+{
+    InitializeSRWLock((PSRWLOCK) &mutex->srw);
+}
+
+void mutex_free(Mutex* mutex)
+{
+    // SRW locks don't need to be destroyed
+}
+
+void mutex_lock(Mutex* mutex)
+{
+    AcquireSRWLockExclusive((PSRWLOCK) &mutex->srw);
+}
+
+void mutex_unlock(Mutex* mutex)
+{
+    ReleaseSRWLockExclusive((PSRWLOCK) &mutex->srw);
+}
+
+void cond_make(Cond* cond)
+{
+    InitializeConditionVariable((PCONDITION_VARIABLE) &cond->cv);
+}
+
+void cond_free(Cond* cond)
+{
+    // Condition variables don't need to be destroyed either
+}
+
+void cond_wait(Cond* cond, Mutex* mutex)
+{
+    SleepConditionVariableSRW((PCONDITION_VARIABLE) &cond->cv, (PSRWLOCK) &mutex->srw, INFINITE, 0);
+}
+
+void cond_signal(Cond* cond)
+{
+    WakeConditionVariable((PCONDITION_VARIABLE) &cond->cv);
+}
+
+void cond_broadcast(Cond* cond)
+{
+    WakeAllConditionVariable((PCONDITION_VARIABLE) &cond->cv);
+}
+
+double time_now()
+{
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+}
+
+#else
+
+static void* thread_start(void* param)
+{
+    Thread_Start start = *(Thread_Start*) param;
+    free(param);
+    start.proc(start.data);
+    trace_thread_done();
+    return NULL;
+}
+
+int thread_create(Thread* thread, Thread_Proc proc, void* data)
+{
+    Thread_Start* start = (Thread_Start*) malloc(sizeof(Thread_Start));
+    hd_assert(start != NULL);
+    start->proc = proc;
+    start->data = data;
+
+    if (pthread_create(&thread->handle, NULL, thread_start, start) != 0)
+    {
+        free(start);
+        return 0;
+    }
+
+    return 1;
+}
+
+void thread_join(Thread* thread)
+{
+    pthread_join(thread->handle, NULL);
+}
+
+void mutex_make(Mutex* mutex)
+{
+    pthread_mutex_init(&mutex->handle, NULL);
+}
+
+void mutex_free(Mutex* mutex)
+{
+    pthread_mutex_destroy(&mutex->handle);
+}
+
+void mutex_lock(Mutex* mutex)
+{
+    pthread_mutex_lock(&mutex->handle);
+}
+
+void mutex_unlock(Mutex* mutex)
+{
+    pthread_mutex_unlock(&mutex->handle);
+}
+
+void cond_make(Cond* cond)
+{
+    pthread_cond_init(&cond->handle, NULL);
+}
+
+void cond_free(Cond* cond)
+{
+    pthread_cond_destroy(&cond->handle);
+}
+
+void cond_wait(Cond* cond, Mutex* mutex)
+{
+    pthread_cond_wait(&cond->handle, &mutex->handle);
+}
+
+void cond_signal(Cond* cond)
+{
+    pthread_cond_signal(&cond->handle);
+}
+
+void cond_broadcast(Cond* cond)
+{
+    pthread_cond_broadcast(&cond->handle);
+}
+
+double time_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif // _WIN32
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef void (*Thread_Proc)(void* data);
+
+typedef struct
+{
+    #ifdef _WIN32
+    void* handle;
+    #else
+    pthread_t handle;
+    #endif
+} Thread;
+
+typedef struct
+{
+    #ifdef _WIN32
+    void* srw;
+    #else
+    pthread_mutex_t handle;
+    #endif
+} Mutex;
+
+typedef struct
+{
+    #ifdef _WIN32
+    void* cv;
+    #else
+    pthread_cond_t handle;
+    #endif
+} Cond;
+
+int  thread_create(Thread* thread, Thread_Proc proc, void* data);
+void thread_join(Thread* thread);
+
+void mutex_make(Mutex* mutex);
+void mutex_free(Mutex* mutex);
+void mutex_lock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+
+void cond_make(Cond* cond);
+void cond_free(Cond* cond);
+void cond_wait(Cond* cond, Mutex* mutex);
+void cond_signal(Cond* cond);
+void cond_broadcast(Cond* cond);
+
+// Seconds since some point in the past. Only goes forward.
+double time_now();
@@ -0,0 +1,298 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads.h"
+#include "containers/darray.h"
+#include "containers/hd_assert.h"
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef struct
+{
+    // Set while a thread is recording into it.
+    int in_use;
+    char thread_name[TRACE_NAME_SIZE];
+
+    // Events go round the ring, count is how many were ever
+    // recorded so anything past TRACE_BUFFER_EVENTS was dropped.
+    Trace_Event* events;
+    size_t count;
+} Trace_Buffer;
+
+static int tracing;
+static double trace_started;
+
+// Only taken to hand out buffers, never to record into them.
+static Mutex trace_lock;
+static DArray(Trace_Buffer*) trace_buffers;
+
+static THREAD_LOCAL Trace_Buffer* thread_buffer;
+
+void trace_start()
+{
+    if (!tracing)
+    {
+        mutex_make(&trace_lock);
+        da_make(trace_buffers);
+        tracing = 1;
+    }
+
+    trace_started = time_now();
+    trace_name_thread("main");
+}
+
+void trace_stop()
+{
+    if (!tracing)
+        return;
+
+    da_foreach(Trace_Buffer*, buffer, trace_buffers)
+    {
+        free((*buffer)->events);
+        free(*buffer);
+    }
+
+    da_free(trace_buffers);
+    mutex_free(&trace_lock);
+
+    tracing = 0;
+    thread_buffer = NULL;
+}
+
+int trace_enabled()
+{
+    return tracing;
+}
+
+// Only called with the lock. A thread with a name gets the buffer
+// an earlier thread with the same name had, so each worker keeps
+// its own track across builds.
+static Trace_Buffer* find_buffer(const char* name)
+{
+    Trace_Buffer* unused = NULL;
+
+    da_foreach(Trace_Buffer*, buffer, trace_buffers)
+    {
+        if ((*buffer)->in_use)
+            continue;
+
+        if (name && strcmp((*buffer)->thread_name, name) == 0)
+            return *buffer;
+
+        if (!unused && !(*buffer)->thread_name[0])
+            unused = *buffer;
+    }
+
+    if (unused)
+        return unused;
+
+    Trace_Buffer* buffer = (Trace_Buffer*) calloc(1, sizeof(Trace_Buffer));
+    hd_assert(buffer != NULL);
+
+    buffer->events = (Trace_Event*) malloc(TRACE_BUFFER_EVENTS * sizeof(Trace_Event));
+    hd_assert(buffer->events != NULL);
+
+    da_push_back(trace_buffers, buffer);
+    return buffer;
+}
+
+static void copy_text(char* dest, const char* text, size_t size)
+{
+    strncpy(dest, text, size - 1);
+    dest[size - 1] = '\0';
+}
+
+static Trace_Buffer* acquire_buffer(const char* name)
+{
+    mutex_lock(&trace_lock);
+
+    Trace_Buffer* buffer = find_buffer(name);
+    buffer->in_use = 1;
+    if (name)
+        copy_text(buffer->thread_name, name, TRACE_NAME_SIZE);
+
+    mutex_unlock(&trace_lock);
+    return buffer;
+}
+
+void trace_name_thread(const char* name)
+{
+    if (!tracing)
+        return;
+
+    if (thread_buffer)
+    {
+        copy_text(thread_buffer->thread_name, name, TRACE_NAME_SIZE);
+        return;
+    }
+
+    thread_buffer = acquire_buffer(name);
+}
+
+const char* trace_thread_name()
+{
+    return (thread_buffer) ? thread_buffer->thread_name : "";
+}
+
+void trace_thread_done()
+{
+    if (!thread_buffer)
+        return;
+
+    mutex_lock(&trace_lock);
+    thread_buffer->in_use = 0;
+    mutex_unlock(&trace_lock);
+
+    thread_buffer = NULL;
+}
+
+static Trace_Event* next_event()
+{
+    if (!thread_buffer)
+        thread_buffer = acquire_buffer(NULL);
+
+    Trace_Buffer* buffer = thread_buffer;
+    return buffer->events + (buffer->count++ % TRACE_BUFFER_EVENTS);
+}
+
+Trace_Span trace_begin(const char* name)
+{
+    Trace_Span span = { name, 0 };
+    if (tracing)
+        span.start = time_now();
+
+    return span;
+}
+
+void trace_end(Trace_Span span, const char* detail)
+{
+    if (!tracing || span.start == 0)
+        return;
+
+    double now = time_now();
+
+    Trace_Event* event = next_event();
+    event->type     = TRACE_SPAN;
+    event->name     = span.name;
+    event->start    = span.start;
+    event->duration = now - span.start;
+    event->value    = 0;
+
+    if (detail)
+        copy_text(event->detail, detail, TRACE_DETAIL_SIZE);
+    else
+        event->detail[0] = '\0';
+}
+
+void trace_counter(const char* name, long long value)
+{
+    if (!tracing)
+        return;
+
+    Trace_Event* event = next_event();
+    event->type      = TRACE_COUNTER;
+    event->name      = name;
+    event->start     = time_now();
+    event->duration  = 0;
+    event->value     = value;
+    event->detail[0] = '\0';
+}
+
+// Details are mostly file names which could have anything in them.
+static void write_escaped(FILE* file, const char* text)
+{
+    for (const char* c = text; *c; c++)
+    {
+        unsigned char ch = (unsigned char) *c;
+
+        if (ch == '"' || ch == '\\')
+            fprintf(file, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(file, "\\u%04x", ch);
+        else
+            fputc(ch, file);
+    }
+}
+
+static void write_event(FILE* file, Trace_Event* event, int tid)
+{
+    double ts = (event->start - trace_started) * 1e6;
+
+    if (event->type == TRACE_COUNTER)
+    {
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%lld}}",
+                event->name, ts, tid, event->value);
+        return;
+    }
+
+    fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+            event->name, ts, event->duration * 1e6, tid);
+
+    if (event->detail[0])
+    {
+        fprintf(file, ",\"args\":{\"detail\":\"");
+        write_escaped(file, event->detail);
+        fprintf(file, "\"}");
+    }
+
+    fprintf(file, "}");
+}
+
+int trace_write(char* path)
+{
+    if (!tracing)
+        return 1;
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return 0;
+
+    size_t dropped = 0;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"swg\"}}");
+
+    mutex_lock(&trace_lock);
+
+    for (int i = 0; i < da_size(trace_buffers); i++)
+    {
+        Trace_Buffer* buffer = trace_buffers[i];
+        int tid = i + 1;
+
+        if (buffer->thread_name[0])
+        {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", tid);
+            write_escaped(file, buffer->thread_name);
+            fprintf(file, "\"}}");
+            fprintf(file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                    tid, tid);
+        }
+
+        size_t first = 0;
+        if (buffer->count > TRACE_BUFFER_EVENTS)
+        {
+            first = buffer->count - TRACE_BUFFER_EVENTS;
+            dropped += first;
+        }
+
+        for (size_t e = first; e < buffer->count; e++)
+            write_event(file, buffer->events + (e % TRACE_BUFFER_EVENTS), tid);
+
+        // Each write only has what happened since the last one,
+        // so every build in watch mode gets a trace of its own.
+        buffer->count = 0;
+    }
+
+    mutex_unlock(&trace_lock);
+
+    fprintf(file, "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"dropped_events\":%zu}}\n", dropped);
+
+    int res = !ferror(file);
+    return fclose(file) == 0 && res;
+}
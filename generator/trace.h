@@ -0,0 +1,66 @@
+#pragma once
+
+// Events each thread keeps. Once a thread's buffer is full
+// its oldest events are dropped.
+#define TRACE_BUFFER_EVENTS (32 * 1024)
+
+// Longest detail kept with a span, like the page it was for.
+#define TRACE_DETAIL_SIZE 64
+#define TRACE_NAME_SIZE   32
+
+typedef enum
+{
+    TRACE_SPAN,
+    TRACE_COUNTER
+} Trace_Event_Type;
+
+typedef struct
+{
+    Trace_Event_Type type;
+    const char* name;
+    double start;
+    double duration;
+    long long value;
+    char detail[TRACE_DETAIL_SIZE];
+} Trace_Event;
+
+typedef struct
+{
+    // Start is 0 when tracing is off.
+    const char* name;
+    double start;
+} Trace_Span;
+
+/*
+    Records what every thread was doing for --trace, as Chrome trace
+    events (chrome://tracing or ui.perfetto.dev). Events go into a
+    buffer that only the thread itself writes to, so recording one
+    doesn't take a lock. Buffers are reused by later threads once
+    the thread that had one finishes. Span and counter names have
+    to be string literals since they're only looked at when the
+    trace is written, details and thread names are copied.
+*/
+void trace_start();
+void trace_stop();
+int  trace_enabled();
+
+// Writes every event recorded since the last write, once the
+// threads that recorded them are done. Returns 0 on failure.
+int trace_write(char* path);
+
+// Names the calling thread's track. A thread with the same name
+// as one that finished earlier carries on its track.
+void trace_name_thread(const char* name);
+
+// Empty if the thread hasn't been named.
+const char* trace_thread_name();
+
+// Called by threads.c when a thread finishes.
+void trace_thread_done();
+
+Trace_Span trace_begin(const char* name);
+
+// Detail can be NULL.
+void trace_end(Trace_Span span, const char* detail);
+
+void trace_counter(const char* name, long long value);
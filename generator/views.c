@@ -0,0 +1,221 @@
+#include "views.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "containers/hd_assert.h"
+
+int view_key_parse(String name, View_Key* key)
+{
+    if (string_cmp(name, "name"))
+        *key = VIEW_KEY_NAME;
+    else if (string_cmp(name, "date"))
+        *key = VIEW_KEY_DATE;
+    else if (string_cmp(name, "year"))
+        *key = VIEW_KEY_YEAR;
+    else
+        return 0;
+
+    return 1;
+}
+
+void view_cache_make(View_Cache* cache)
+{
+    mutex_make(&cache->lock);
+    cache->views = NULL;
+    da_make(cache->views);
+    cache->index = (View_Lookup) { 0 };
+}
+
+static void view_free(View* view)
+{
+    da_foreach(View_Group, group, view->groups)
+        if (group->name)
+            string_free(&group->name);
+    da_free(view->groups);
+
+    da_free(view->order);
+    free(view);
+}
+
+void view_cache_free(View_Cache* cache)
+{
+    da_foreach(View*, view, cache->views)
+        view_free(*view);
+    da_free(cache->views);
+
+    dict_foreach(int, bkt, cache->index)
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free(cache->index);
+
+    mutex_free(&cache->lock);
+}
+
+typedef struct
+{
+    Project_Ref ref;
+    Project* project;
+    int position;
+
+    // Every entry has the spec so they can be compared without
+    // having to go through a global.
+    View_Key key;
+    int descending;
+} View_Entry;
+
+static int lower(char ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+static int compare_names(String a, String b)
+{
+    for (; *a && lower(*a) == lower(*b); a++, b++);
+    return lower(*a) - lower(*b);
+}
+
+static int has_key(Project* project, View_Key key)
+{
+    return (key == VIEW_KEY_NAME) ? project->name != NULL : project->date_key != 0;
+}
+
+static int compare_keys(Project* a, Project* b, View_Key key)
+{
+    switch (key)
+    {
+        case VIEW_KEY_NAME: return compare_names(a->name, b->name);
+        case VIEW_KEY_DATE: return (a->date_key > b->date_key) - (a->date_key < b->date_key);
+        case VIEW_KEY_YEAR: return (a->date_key / 10000) - (b->date_key / 10000);
+    }
+
+    return 0;
+}
+
+// Projects without the key go last either way and projects
+// with the same key stay in the order they were in.
+static int compare_entries(const void* a, const void* b)
+{
+    const View_Entry* x = a;
+    const View_Entry* y = b;
+
+    int x_has = has_key(x->project, x->key);
+    int y_has = has_key(y->project, y->key);
+
+    int res = y_has - x_has;
+    if (res == 0 && x_has)
+    {
+        res = compare_keys(x->project, y->project, x->key);
+        if (x->descending)
+            res = -res;
+    }
+
+    if (res == 0)
+        res = x->position - y->position;
+
+    return res;
+}
+
+static String group_name(Project* project, View_Key key)
+{
+    if (!has_key(project, key))
+        return NULL;
+
+    switch (key)
+    {
+        case VIEW_KEY_NAME: return string_make(project->name);
+        case VIEW_KEY_DATE: return (project->date) ? string_make(project->date) : NULL;
+        case VIEW_KEY_YEAR:
+        {
+            char year[16];
+            sprintf(year, "%d", project->date_key / 10000);
+            return string_make(year);
+        }
+    }
+
+    return NULL;
+}
+
+static void add_groups(View* view, View_Entry* entries, int count, View_Key key)
+{
+    for (int i = 0; i < count;)
+    {
+        int end = i + 1;
+        while (end < count &&
+               has_key(entries[i].project, key) == has_key(entries[end].project, key) &&
+               (!has_key(entries[i].project, key) || compare_keys(entries[i].project, entries[end].project, key) == 0))
+            end++;
+
+        View_Group group = { group_name(entries[i].project, key), i, end - i };
+        da_push_back(view->groups, group);
+        i = end;
+    }
+}
+
+static View* view_make(Portfolio portfolio, Skill_Map* skills, View_Source source, int index, View_Spec spec)
+{
+    View* view = (View*) calloc(1, sizeof(View));
+    hd_assert(view != NULL);
+
+    da_make(view->order);
+    da_make(view->groups);
+
+    DArray(Project_Ref) refs = (source == VIEW_OF_SKILL) ? skills->skills[index].projects : NULL;
+    int count = (source == VIEW_OF_SKILL) ? da_size(refs) : da_size(portfolio.personas[index].projects);
+
+    if (count == 0)
+        return view;
+
+    View_Entry* entries = (View_Entry*) malloc(count * sizeof(View_Entry));
+    hd_assert(entries != NULL);
+
+    for (int i = 0; i < count; i++)
+    {
+        Project_Ref ref = (source == VIEW_OF_SKILL) ? refs[i] : (Project_Ref) { index, i };
+
+        entries[i].ref        = ref;
+        entries[i].project    = portfolio.personas[ref.persona].projects + ref.project;
+        entries[i].position   = i;
+        entries[i].key        = spec.key;
+        entries[i].descending = spec.descending;
+    }
+
+    qsort(entries, count, sizeof(View_Entry), compare_entries);
+
+    for (int i = 0; i < count; i++)
+        da_push_back(view->order, entries[i].ref);
+
+    if (spec.kind == VIEW_GROUP)
+        add_groups(view, entries, count, spec.key);
+
+    free(entries);
+    return view;
+}
+
+View* view_cache_get(View_Cache* cache, Portfolio portfolio, Skill_Map* skills,
+                     View_Source source, int index, View_Spec spec)
+{
+    char key[64];
+    sprintf(key, "%c%d:%d:%d:%d", (source == VIEW_OF_SKILL) ? 's' : 'p',
+            index, spec.kind, spec.key, spec.descending);
+
+    mutex_lock(&cache->lock);
+
+    View* view;
+    Dict_Bkt(int) bkt = dict_find(cache->index, key);
+    if (bkt != dict_end(cache->index))
+    {
+        view = cache->views[bkt->value];
+    }
+    else
+    {
+        view = view_make(portfolio, skills, source, index, spec);
+
+        int view_index = da_size(cache->views);
+        da_push_back(cache->views, view);
+        dict_put(cache->index, key, view_index);
+    }
+
+    mutex_unlock(&cache->lock);
+    return view;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "portfolio.h"
+#include "skills.h"
+#include "threads.h"
+#include "containers/string.h"
+#include "containers/darray.h"
+#include "containers/dictionary.h"
+
+typedef enum
+{
+    VIEW_NONE,
+    VIEW_SORT,
+    VIEW_GROUP
+} View_Kind;
+
+typedef enum
+{
+    VIEW_KEY_NAME,
+    VIEW_KEY_DATE,
+    VIEW_KEY_YEAR
+} View_Key;
+
+// What comes after | in a list tag, like
+// <$projects | sort date desc -> p { ... }>
+typedef struct
+{
+    View_Kind kind;
+    View_Key key;
+    int descending;
+} View_Spec;
+
+// Returns 0 if the name isn't a key.
+int view_key_parse(String name, View_Key* key);
+
+typedef struct
+{
+    // NULL for projects without the key, like ones with no date.
+    String name;
+    int first;
+    int count;
+} View_Group;
+
+/*
+    A list of projects in the order a view puts them in, as places
+    in the portfolio so the projects themselves are never copied or
+    moved. Groups are runs of the order that share a key.
+*/
+typedef struct
+{
+    DArray(Project_Ref) order;
+    DArray(View_Group) groups;
+} View;
+
+typedef Dict(int) View_Lookup;
+
+typedef enum
+{
+    VIEW_OF_PERSONA,
+    VIEW_OF_SKILL
+} View_Source;
+
+/*
+    Every view a build has needed so far. Views are made the first
+    time a page asks for one and every page after that gets the same
+    one, so each list is only sorted once per build. Pages are
+    generated on several threads so finding a view takes a lock.
+*/
+typedef struct
+{
+    Mutex lock;
+    DArray(View*) views;
+    View_Lookup index;
+} View_Cache;
+
+// The cache can't be moved once it's made.
+void view_cache_make(View_Cache* cache);
+void view_cache_free(View_Cache* cache);
+
+// Projects of the persona or of the skill (with its index in the
+// skill map) as the spec says. The view stays around until the
+// cache is freed.
+View* view_cache_get(View_Cache* cache, Portfolio portfolio, Skill_Map* skills,
+                     View_Source source, int index, View_Spec spec);
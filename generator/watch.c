@@ -0,0 +1,208 @@
+#include "watch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "containers/hd_assert.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+#endif
+
+static void sleep_ms(int ms)
+{
+    #ifdef _WIN32
+    Sleep(ms);
+    #else
+    usleep(ms * 1000);
+    #endif
+}
+
+Watcher watcher_make()
+{
+    Watcher w = { 0 };
+    da_make(w.files);
+
+    #ifdef __linux__
+    w.fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    #else
+    w.fd = -1;
+    #endif
+
+    return w;
+}
+
+void watcher_free(Watcher* watcher)
+{
+    da_foreach(Watched_File, file, watcher->files)
+    {
+        string_free(&file->path);
+        string_free(&file->dir);
+        string_free(&file->name);
+    }
+    da_free(watcher->files);
+
+    #ifndef _WIN32
+    if (watcher->fd >= 0)
+        close(watcher->fd);
+    #endif
+}
+
+// Returns 1 if the file looks different than it did last time.
+static int check_file(Watched_File* file)
+{
+    struct stat st;
+    long long mtime = -1, size = -1;
+
+    if (stat(file->path, &st) == 0)
+    {
+        mtime = (long long) st.st_mtime;
+        size  = (long long) st.st_size;
+    }
+
+    int changed = mtime != file->mtime || size != file->size;
+    file->mtime = mtime;
+    file->size  = size;
+    return changed;
+}
+
+// Files that are already being watched are ignored.
+void watcher_add(Watcher* watcher, String path)
+{
+    da_foreach(Watched_File, file, watcher->files)
+        if (string_cmp(file->path, path))
+            return;
+
+    Watched_File file = { 0 };
+    file.path = string_make(path);
+
+    char* slash = strrchr(path, '/');
+    if (slash)
+    {
+        file.dir  = string_make_till_n(path, slash - path);
+        file.name = string_make(slash + 1);
+    }
+    else
+    {
+        file.dir  = string_make(".");
+        file.name = string_make(path);
+    }
+
+    #ifdef __linux__
+    // Adding a directory twice just gives back the same watch.
+    if (watcher->fd >= 0)
+        file.wd = inotify_add_watch(watcher->fd, file.dir, WATCH_EVENTS);
+    #endif
+
+    check_file(&file);
+    da_push_back(watcher->files, file);
+}
+
+#ifdef __linux__
+
+// Sets changed if any of the events were for a watched file. Returns
+// how much was read, 0 if there was nothing to read or -1 on errors.
+static ssize_t read_events(Watcher* watcher, int* changed)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    ssize_t len = read(watcher->fd, buffer, sizeof(buffer));
+    if (len <= 0)
+        return (len < 0 && errno != EINTR && errno != EAGAIN) ? -1 : 0;
+
+    for (char* ptr = buffer; ptr < buffer + len;)
+    {
+        struct inotify_event* event = (struct inotify_event*) ptr;
+        ptr += sizeof(struct inotify_event) + event->len;
+
+        if (event->len == 0)
+            continue;
+
+        da_foreach(Watched_File, file, watcher->files)
+        {
+            if (file->wd == event->wd && string_cmp(file->name, event->name))
+                *changed = 1;
+        }
+    }
+
+    return len;
+}
+
+static int wait_inotify(Watcher* watcher, int debounce_ms)
+{
+    int changed = 0;
+
+    while (1)
+    {
+        struct pollfd pfd = { watcher->fd, POLLIN, 0 };
+        int res = poll(&pfd, 1, (changed) ? debounce_ms : -1);
+
+        if (res < 0 && errno != EINTR)
+            return 0;
+
+        if (res == 0)
+            return 1;
+
+        if (res > 0 && read_events(watcher, &changed) < 0)
+            return 0;
+    }
+}
+
+#endif
+
+// Returns 1 if any of the files changed since the last check
+// without waiting. Meant for callers that wait on the watcher's
+// fd themselves, or check every WATCH_POLL_MS if there isn't one.
+int watcher_check(Watcher* watcher)
+{
+    int changed = 0;
+
+    #ifdef __linux__
+    if (watcher->fd >= 0)
+    {
+        while (read_events(watcher, &changed) > 0);
+        return changed;
+    }
+    #endif
+
+    da_foreach(Watched_File, file, watcher->files)
+        changed |= check_file(file);
+
+    return changed;
+}
+
+// Blocks until one of the files changes and nothing else has
+// changed for debounce_ms. Returns 0 if watching stopped working.
+int watcher_wait(Watcher* watcher, int debounce_ms)
+{
+    #ifdef __linux__
+    if (watcher->fd >= 0)
+        return wait_inotify(watcher, debounce_ms);
+    #endif
+
+    int changed = 0;
+
+    while (1)
+    {
+        sleep_ms((changed && debounce_ms < WATCH_POLL_MS) ? debounce_ms : WATCH_POLL_MS);
+
+        int any = 0;
+        da_foreach(Watched_File, file, watcher->files)
+            any |= check_file(file);
+
+        if (!any && changed)
+            return 1;
+
+        changed |= any;
+    }
+}
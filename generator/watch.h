@@ -0,0 +1,40 @@
+#pragma once
+
+#include "containers/string.h"
+#include "containers/darray.h"
+
+// How long things have to stay quiet after a change before a
+// rebuild starts, so a burst of saves only causes one build.
+#define WATCH_DEBOUNCE_MS 100
+
+// How often files get checked when inotify isn't available.
+#define WATCH_POLL_MS 250
+
+typedef struct
+{
+    String path;
+    String dir;
+    String name;
+    int wd;
+
+    long long mtime;
+    long long size;
+} Watched_File;
+
+/*
+    Waits for any of a set of files to change. On Linux the
+    directories holding the files are watched with inotify since
+    a lot of editors save by replacing the file. Everywhere else
+    the files' modification times are checked every so often.
+*/
+typedef struct
+{
+    DArray(Watched_File) files;
+    int fd;
+} Watcher;
+
+Watcher watcher_make();
+void    watcher_free(Watcher* watcher);
+void    watcher_add(Watcher* watcher, String path);
+int     watcher_wait(Watcher* watcher, int debounce_ms);
+int     watcher_check(Watcher* watcher);
@@ -1,7 +1,9 @@
 #include "webpage.h"
 
 #include <stdio.h>
+#include <string.h>
 #include "filestuff.h"
+#include "deps.h"
 #include "containers/hd_assert.h"
 #include "containers/darray.h"
 
@@ -22,6 +24,9 @@ Stage prop_stage_make()
     s.type = STAGE_PROPERTY;
     s.property.name         = NULL;
     s.property.parent_index = -1;
+    s.property.escape       = ESCAPE_TEXT;
+    s.property.scope        = 0;
+    s.property.slot         = 0;
     return s;
 }
 
@@ -31,6 +36,8 @@ Stage list_stage_make()
     s.type = STAGE_LIST;
     s.list.it_name      = NULL;
     s.list.parent_index = -1;
+    s.list.view         = (View_Spec) { VIEW_NONE };
+    s.list.depth        = 0;
     s.list.stages       = NULL;
     da_make(s.list.stages);
     return s;
@@ -96,7 +103,7 @@ Template_Parser template_parser_make(String template)
 {
     DArray(Stage) stages = NULL;
     da_make(stages);
-    return (Template_Parser){ template, 0, stages, TP_NO_PARSE, NULL };
+    return (Template_Parser){ template, 0, stages, TP_NO_PARSE, NULL, html_scanner_make(), NULL, 0 };
 }
 
 void template_parser_free(Template_Parser* tp)
@@ -187,9 +194,13 @@ static Stage get_list(Template_Parser* tp, DArray(Stage)* stages)
 
     list.list.parent_index = da_size((*stages)) - 1;
     list.list.it_name = identifier;
+    list.list.depth = da_size(tp->scopes) + 1;
 
     consume(tp);
+
+    da_push_back(tp->scopes, identifier);
     fill_stages(tp, '}', &list.list.stages);
+    da_pop_back(tp->scopes);
 
     if (peek(tp, 0) != '}')
         TP_ERROR(tp, "Template block must be closed with }");
@@ -199,6 +210,54 @@ static Stage get_list(Template_Parser* tp, DArray(Stage)* stages)
     return list;
 }
 
+// Starts parsing after |
+static View_Spec get_view(Template_Parser* tp)
+{
+    View_Spec view = { VIEW_NONE, VIEW_KEY_NAME, 0 };
+
+    String kind = get_identifier(tp);
+    if (kind && string_cmp(kind, "sort"))
+        view.kind = VIEW_SORT;
+    else if (kind && string_cmp(kind, "group_by"))
+        view.kind = VIEW_GROUP;
+
+    if (kind)
+        string_free(&kind);
+
+    if (view.kind == VIEW_NONE)
+    {
+        TP_ERROR(tp, "Expected sort or group_by after |");
+        return view;
+    }
+
+    String key = get_identifier(tp);
+    int valid = key && view_key_parse(key, &view.key);
+
+    if (key)
+        string_free(&key);
+
+    if (!valid)
+    {
+        TP_ERROR(tp, "Lists can only be sorted or grouped by name, date or year");
+        return view;
+    }
+
+    consume_ws(tp);
+
+    if (is_alpha_or_us(peek(tp, 0)))
+    {
+        String order = get_identifier(tp);
+        if (string_cmp(order, "desc"))
+            view.descending = 1;
+        else if (!string_cmp(order, "asc"))
+            TP_ERROR(tp, "Expected asc or desc after what the list is sorted by");
+
+        string_free(&order);
+    }
+
+    return view;
+}
+
 static Stage get_cond(Template_Parser* tp)
 {
     Stage cond = cond_stage_make();
@@ -261,6 +320,17 @@ static Stage get_cond(Template_Parser* tp)
     return cond;
 }
 
+// Depth of the innermost list the name is the variable of,
+// 0 if it isn't one.
+static int find_scope(Template_Parser* tp, String name)
+{
+    for (int i = da_size(tp->scopes) - 1; i >= 0 && name; i--)
+        if (string_cmp(name, tp->scopes[i]))
+            return i + 1;
+
+    return 0;
+}
+
 // tp->cur_index is stopped at the first instance of end char
 static void fill_stages(Template_Parser* tp, char end, DArray(Stage)* stages)
 {
@@ -300,6 +370,7 @@ static void fill_stages(Template_Parser* tp, char end, DArray(Stage)* stages)
                 Stage html = html_stage_make();
                 int length = tp->cur_index - start_idx - (is_in_$tag * 2);
                 html.html.content = string_make_till_n(tp->content + start_idx, length);
+                html_scanner_feed(&tp->html, html.html.content, length);
                 da_push_back((*stages), html);
             }
 
@@ -323,6 +394,38 @@ static void fill_stages(Template_Parser* tp, char end, DArray(Stage)* stages)
             continue;            
         }
 
+        if (peek(tp, 0) == '|')
+        {
+            consume(tp);
+
+            int last_elem_idx = da_size((*stages)) - 1;
+            if (tokens_in_$tag == 0 ||
+                (*stages)[last_elem_idx].type != STAGE_PROPERTY)
+            {
+                TP_ERROR(tp, "| can only be used after a property");
+                continue;
+            }
+
+            View_Spec view = get_view(tp);
+            if (tp->status == TP_FAILURE)
+                continue;
+
+            consume_ws(tp);
+
+            if (peek(tp, 0) != '-' || peek(tp, 1) != '>')
+            {
+                TP_ERROR(tp, "Expected -> after sort or group_by");
+                continue;
+            }
+
+            consume(tp); consume(tp);
+
+            Stage list = get_list(tp, stages);
+            list.list.view = view;
+            da_push_back((*stages), list);
+            continue;
+        }
+
         if (peek(tp, 0) == '>')
         {
             consume(tp);
@@ -369,6 +472,13 @@ static void fill_stages(Template_Parser* tp, char end, DArray(Stage)* stages)
 
         prop.property.name = prop_name;
         prop.property.parent_index = parent_index;
+        prop.property.escape = html_scanner_context(&tp->html);
+        prop.property.slot = tp->num_slots++;
+
+        if (parent_index >= 0)
+            prop.property.scope = (*stages)[parent_index].property.scope;
+        else
+            prop.property.scope = find_scope(tp, prop_name);
         da_push_back((*stages), prop);
         
         tokens_in_$tag++;
@@ -380,7 +490,14 @@ void template_parser_parse(Template_Parser* tp)
     // Just in case
     tp->cur_index = 0;
     tp->status = TP_NO_PARSE;
+    tp->html = html_scanner_make();
+    tp->num_slots = 0;
+
+    // The scopes point into the list stages and are
+    // only needed while the template is parsed.
+    da_make(tp->scopes);
     fill_stages(tp, '\0', &tp->stages);
+    da_free(tp->scopes);
 
     if (tp->status != TP_FAILURE)
         tp->status = TP_SUCCESS;
@@ -413,7 +530,14 @@ static void print_stages(DArray(Stage) stages)
 
             case STAGE_LIST:
             {
-                printf("[ list: %s -> %s [\n", stages[s->list.parent_index].property.name, s->list.it_name);
+                printf("[ list: %s", stages[s->list.parent_index].property.name);
+                if (s->list.view.kind != VIEW_NONE)
+                {
+                    printf(" | %s %d %s", (s->list.view.kind == VIEW_SORT) ? "sort" : "group_by",
+                           s->list.view.key, (s->list.view.descending) ? "desc" : "asc");
+                }
+
+                printf(" -> %s [\n", s->list.it_name);
                 print_stages(s->list.stages);
                 printf("\n]]\n");
             } break;
@@ -450,34 +574,179 @@ Webpage_Status template_parser_test(Portfolio portfolio)
     return WP_SUCCESS;
 }
 
+// Checks if any stage reads the personas, links or skills lists. Pages made
+// from such stages can't be generated until the whole portfolio is parsed.
+int stages_use_portfolio_lists(DArray(Stage) stages)
+{
+    da_foreach(Stage, s, stages)
+    {
+        switch (s->type)
+        {
+            case STAGE_PROPERTY:
+            {
+                if (s->property.parent_index == -1 &&
+                    (string_cmp(s->property.name, "personas") ||
+                     string_cmp(s->property.name, "links") ||
+                     string_cmp(s->property.name, "skills")))
+                    return 1;
+            } break;
+
+            case STAGE_LIST:
+            {
+                if (stages_use_portfolio_lists(s->list.stages))
+                    return 1;
+            } break;
+
+            case STAGE_CONDITIONAL:
+            {
+                if (stages_use_portfolio_lists(s->conditional.condition) ||
+                    stages_use_portfolio_lists(s->conditional.stages_if_true) ||
+                    stages_use_portfolio_lists(s->conditional.stages_if_false))
+                    return 1;
+            } break;
+
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+// Counts every stage, including the ones inside lists and
+// conditionals. Stages can be NULL for templates that weren't loaded.
+size_t stages_count(DArray(Stage) stages)
+{
+    if (!stages)
+        return 0;
+
+    size_t count = 0;
+    da_foreach(Stage, s, stages)
+    {
+        count++;
+
+        switch (s->type)
+        {
+            case STAGE_LIST:
+            {
+                count += stages_count(s->list.stages);
+            } break;
+
+            case STAGE_CONDITIONAL:
+            {
+                count += stages_count(s->conditional.condition) +
+                         stages_count(s->conditional.stages_if_true) +
+                         stages_count(s->conditional.stages_if_false);
+            } break;
+
+            default:
+                break;
+        }
+    }
+
+    return count;
+}
+
+void stages_add_assets(DArray(Stage) stages, Asset_Map* assets)
+{
+    da_foreach(Stage, s, stages)
+    {
+        switch (s->type)
+        {
+            case STAGE_HTML:
+            {
+                assets_add_html(assets, s->html.content);
+            } break;
+
+            case STAGE_LIST:
+            {
+                stages_add_assets(s->list.stages, assets);
+            } break;
+
+            case STAGE_CONDITIONAL:
+            {
+                stages_add_assets(s->conditional.stages_if_true, assets);
+                stages_add_assets(s->conditional.stages_if_false, assets);
+            } break;
+
+            default:
+                break;
+        }
+    }
+}
+
+// Output is only recorded as segments pointing into the stage or
+// portfolio strings so those need to outlive the generated page.
+// When streaming it goes through the stream's buffer instead.
+static void emit_output(void* data, char* chunk, size_t length)
+{
+    Generator* gen = data;
+    gen->output_size += length;
+
+    if (gen->stream)
+    {
+        stream_write(gen->stream, chunk, length);
+        return;
+    }
+
+    Segment seg = { chunk, length };
+    da_push_back(gen->segments, seg);
+}
+
+static void add_data(Generator* gen, char* data, size_t length)
+{
+    if (length == 0)
+        return;
+
+    if (gen->minify)
+        minify_write(&gen->minifier, data, length);
+    else
+        emit_output(gen, data, length);
+}
+
 static void add_to_buffer(Generator* gen, String str)
 {
     int len = string_length(str) - 1;
-    for (int i = 0; i < len; i++)
-        da_push_back(gen->buffer, str[i]);
+    if (len <= 0)
+        return;
+
+    add_data(gen, str, len);
 }
 
 Generator generator_make(DArray(Stage) stages)
 {
     Generator g = { 0 };
     g.stages = stages;
-    da_make(g.buffer);
-    dict_make(g.vs);
+    da_make(g.segments);
+    da_make(g.memos);
+    da_make(g.scopes);
+
+    Stamped_Variable page = { 0 };
+    da_push_back(g.scopes, page);
+
+    minifier_make(&g.minifier);
     return g;
 }
 
-void generator_free(Generator* generator)
+// The deps dictionary is only created once something gets recorded.
+static void free_deps(Generator* generator)
 {
-    da_foreach(Stage, stage, generator->stages)
-        stage_free(stage);
-    da_free(generator->stages);
+    dict_foreach(int, dep, generator->deps)
+        if (dep->key)
+            string_free(&dep->key);
+    dict_free(generator->deps);
+}
 
-    dict_foreach(Variable, var, generator->vs)
-        if (var->key)
-            string_free(&var->key);
-    dict_free(generator->vs);
+// The stages belong to whoever parsed them so
+// generators can share them.
+void generator_free(Generator* generator)
+{
+    da_free(generator->scopes);
+    da_free(generator->memos);
 
-    da_free(generator->buffer);
+    free_deps(generator);
+    da_free(generator->segments);
+    minifier_free(&generator->minifier);
 
     if (generator->message)
         string_free(&generator->message);
@@ -489,8 +758,90 @@ void generator_free(Generator* generator)
         gen->message = string_make("Generator Error: "m); \
     } while (0)
 
-static Variable get_persona_prop(Generator* gen, Stage* stage, Persona persona, int is_selected)
+static void record_dep(Generator* gen, char* kind, String owner, char* field)
 {
+    if (!gen->track_deps)
+        return;
+
+    char key[DEP_KEY_SIZE];
+    dep_key(key, kind, owner, field);
+
+    if (dict_find(gen->deps, key) == dict_end(gen->deps))
+        dict_put(gen->deps, key, 1);
+}
+
+// Pages depend on every asset they could have referenced, even ones
+// that don't exist yet, so they change once the file shows up.
+static Asset* find_asset(Generator* gen, char* path, size_t length)
+{
+    Asset* asset = assets_find(gen->assets, path, length);
+    if (!asset)
+        return NULL;
+
+    record_dep(gen, "asset", asset->path, NULL);
+    return (asset->fingerprinted) ? asset : NULL;
+}
+
+// Swaps asset paths in attribute values for their fingerprinted
+// names. Everything around them is output as it is.
+static void add_html(Generator* gen, String html)
+{
+    if (!gen->assets || !gen->assets->rewrite_html)
+    {
+        add_to_buffer(gen, html);
+        return;
+    }
+
+    int len = string_length(html) - 1;
+    if (len <= 0)
+        return;
+
+    size_t length = len;
+    size_t pos = 0, start, value_length, written = 0;
+
+    while (html_next_value(html, length, &pos, &start, &value_length))
+    {
+        Asset* asset = find_asset(gen, html + start, value_length);
+        if (!asset)
+            continue;
+
+        add_data(gen, html + written, start - written);
+        add_to_buffer(gen, asset->fingerprinted);
+        written = start + value_length;
+    }
+
+    add_data(gen, html + written, length - written);
+}
+
+static void escape_output(void* data, char* chunk, size_t length)
+{
+    add_data((Generator*) data, chunk, length);
+}
+
+// Values from the portfolio are escaped for where they are in
+// the page so they can't break the html around them.
+static void add_value(Generator* gen, String value, Escape_Context escape)
+{
+    if (!value)
+        return;
+
+    if (gen->assets)
+    {
+        Asset* asset = find_asset(gen, value, string_length(value) - 1);
+        if (asset)
+            value = asset->fingerprinted;
+    }
+
+    int len = string_length(value) - 1;
+    if (len > 0)
+        escape_html(value, len, escape, escape_output, gen);
+}
+
+static Variable get_persona_prop(Generator* gen, Stage* stage, Persona persona, int persona_index, int is_selected)
+{
+    if (!string_cmp(stage->property.name, "selected"))
+        record_dep(gen, "persona", persona.name, stage->property.name);
+
     if (string_cmp(stage->property.name, "name"))
         return var_make_string(persona.name);
         
@@ -510,7 +861,19 @@ static Variable get_persona_prop(Generator* gen, Stage* stage, Persona persona,
         return var_make_string_list(persona.abilities);
 
     if (string_cmp(stage->property.name, "projects"))
-        return var_make_project_list(persona.projects);
+    {
+        Variable var = var_make_project_list(persona.projects);
+        var.project_list.persona = persona_index;
+
+        // Only the selected persona's projects are split over pages.
+        if (is_selected && gen->page)
+        {
+            var.project_list.first = gen->page->first_project;
+            var.project_list.count = gen->page->num_projects;
+        }
+
+        return var;
+    }
 
     if (string_cmp(stage->property.name, "selected"))
         return var_make_bool(is_selected);
@@ -518,7 +881,8 @@ static Variable get_persona_prop(Generator* gen, Stage* stage, Persona persona,
     return (Variable) { 0 };
 }
 
-static Variable get_project_prop(Generator* gen, Stage* stage, Project proj)
+static Variable get_project_prop(Generator* gen, Stage* stage, Project proj, int persona_index,
+                                 Portfolio portfolio, int selected_index)
 {
     if (string_cmp(stage->property.name, "name"))
         return var_make_string(proj.name);
@@ -538,11 +902,23 @@ static Variable get_project_prop(Generator* gen, Stage* stage, Project proj)
     if (string_cmp(stage->property.name, "images"))
         return var_make_string_list(proj.images);
 
+    if (string_cmp(stage->property.name, "page") && proj.page)
+        return var_make_string(proj.page);
+
+    if (string_cmp(stage->property.name, "persona") && persona_index >= 0)
+    {
+        Variable var = var_make_persona(portfolio.personas[persona_index], persona_index == selected_index);
+        var.persona.index = persona_index;
+        return var;
+    }
+
     return (Variable) { 0 };
 }
 
 static Variable get_link_prop(Generator* gen, Stage* stage, Link link)
 {
+    record_dep(gen, "link", link.name, stage->property.name);
+
     if (string_cmp(stage->property.name, "name"))
         return var_make_string(link.name);
         
@@ -558,24 +934,322 @@ static Variable get_link_prop(Generator* gen, Stage* stage, Link link)
     return (Variable) { 0 };
 }
 
-static Variable get_value(Generator* gen, DArray(Stage) stages, Stage* stage, Portfolio portfolio, int selected_index)
+int persona_page_count(Portfolio portfolio, int persona_index)
 {
-    if (stage->property.parent_index == -1)
+    int num_projects = da_size(portfolio.personas[persona_index].projects);
+    int page_size = portfolio.page_size;
+
+    if (page_size <= 0 || num_projects <= page_size)
+        return 1;
+
+    return (num_projects + page_size - 1) / page_size;
+}
+
+void page_name(char* name, Persona persona, int number)
+{
+    if (number == 1)
+        snprintf(name, PAGE_NAME_SIZE, "%s.html", persona.name);
+    else
+        snprintf(name, PAGE_NAME_SIZE, "%s-%d.html", persona.name, number);
+}
+
+size_t name_slug(char* dest, size_t size, char* name)
+{
+    size_t length = 0;
+    int dash = 0;
+
+    for (char* c = name; c && *c && length + 1 < size; c++)
+    {
+        char ch = *c;
+        if (ch >= 'A' && ch <= 'Z')
+            ch += 'a' - 'A';
+
+        int keep = (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') || (unsigned char) ch >= 0x80;
+        if (!keep)
+        {
+            dash = length > 0;
+            continue;
+        }
+
+        if (dash && length + 2 < size)
+            dest[length++] = '-';
+
+        dest[length++] = ch;
+        dash = 0;
+    }
+
+    dest[length] = '\0';
+    return length;
+}
+
+void persona_name_projects(Persona* persona)
+{
+    // Slugs are cut short so both of them, the dashes, any number
+    // and .html always fit in a page name.
+    char persona_slug[PAGE_NAME_SIZE / 2 - 16];
+    char project_slug[PAGE_NAME_SIZE / 2 - 16];
+
+    if (name_slug(persona_slug, sizeof(persona_slug), persona->name) == 0)
+        strcpy(persona_slug, "persona");
+
+    Dict(int) taken = { 0 };
+    da_foreach(Project, project, persona->projects)
+    {
+        if (project->page)
+        {
+            dict_put(taken, project->page, 1);
+            continue;
+        }
+
+        if (name_slug(project_slug, sizeof(project_slug), project->name) == 0)
+            strcpy(project_slug, "project");
+
+        // Projects with the same name get numbers after the first.
+        char name[PAGE_NAME_SIZE];
+        snprintf(name, PAGE_NAME_SIZE, "%s--%s.html", persona_slug, project_slug);
+
+        for (int n = 2; dict_find(taken, name) != dict_end(taken); n++)
+            snprintf(name, PAGE_NAME_SIZE, "%s--%s-%d.html", persona_slug, project_slug, n);
+
+        project->page = string_make(name);
+        dict_put(taken, project->page, 1);
+    }
+
+    dict_foreach(int, bkt, taken)
+        if (bkt->key)
+            string_free(&bkt->key);
+    dict_free(taken);
+}
+
+Page_Info page_info_make(Portfolio portfolio, int persona_index, int number)
+{
+    Page_Info page = { 0 };
+    page.number = number;
+    page.count  = 1;
+
+    if (persona_index >= 0)
     {
-        Dict_Bkt(Variable) var = dict_find(gen->vs, stage->property.name);
-        if (var != dict_end(gen->vs) &&
-            var->value.type != VAR_NONE)
+        Persona persona = portfolio.personas[persona_index];
+        int num_projects = da_size(persona.projects);
+
+        page.count = persona_page_count(portfolio, persona_index);
+        page.first_project = (portfolio.page_size > 0) ? (number - 1) * portfolio.page_size : 0;
+        page.num_projects  = num_projects - page.first_project;
+
+        if (portfolio.page_size > 0 && page.num_projects > portfolio.page_size)
+            page.num_projects = portfolio.page_size;
+
+        char name[PAGE_NAME_SIZE];
+        if (number > 1)
         {
-            return var->value;
+            page_name(name, persona, number - 1);
+            page.prev_name = string_make(name);
         }
 
+        if (number < page.count)
+        {
+            page_name(name, persona, number + 1);
+            page.next_name = string_make(name);
+        }
+    }
+
+    char text[16];
+    sprintf(text, "%d", page.number);
+    page.number_text = string_make(text);
+
+    sprintf(text, "%d", page.count);
+    page.count_text = string_make(text);
+
+    return page;
+}
+
+void page_info_free(Page_Info* page)
+{
+    string_free(&page->number_text);
+    string_free(&page->count_text);
+
+    if (page->prev_name)
+        string_free(&page->prev_name);
+
+    if (page->next_name)
+        string_free(&page->next_name);
+}
+
+static Variable get_skill_prop(Generator* gen, Stage* stage, Skill* skill)
+{
+    record_dep(gen, "skill", skill->page, NULL);
+
+    if (string_cmp(stage->property.name, "name"))
+        return var_make_string(skill->name);
+
+    if (string_cmp(stage->property.name, "page"))
+        return var_make_string(skill->page);
+
+    if (string_cmp(stage->property.name, "projects"))
+    {
+        Variable var = var_make_project_refs(skill->projects);
+        var.project_refs.skill = (gen->skills) ? skill - gen->skills->skills : -1;
+        return var;
+    }
+
+    return (Variable) { 0 };
+}
+
+static Variable get_group_prop(Generator* gen, Stage* stage, Variable group)
+{
+    if (string_cmp(stage->property.name, "name") && group.project_group.name)
+        return var_make_string(group.project_group.name);
+
+    if (string_cmp(stage->property.name, "projects"))
+    {
+        Variable var = var_make_project_refs(group.project_group.list);
+        var.project_refs.first = group.project_group.first;
+        var.project_refs.count = group.project_group.count;
+        return var;
+    }
+
+    return (Variable) { 0 };
+}
+
+// Swaps a persona's or skill's projects for the sorted or grouped
+// view of them. Paginated lists keep their range, which is then a
+// range of the view.
+static Variable apply_view(Generator* gen, Variable var, View_Spec spec, Portfolio portfolio)
+{
+    View_Source source;
+    int index, first, count;
+
+    if (var.type == VAR_PROJECT_LIST && var.project_list.persona >= 0)
+    {
+        source = VIEW_OF_PERSONA;
+        index  = var.project_list.persona;
+        first  = var.project_list.first;
+        count  = var.project_list.count;
+    }
+    else if (var.type == VAR_PROJECT_REFS && var.project_refs.skill >= 0 && gen->skills)
+    {
+        source = VIEW_OF_SKILL;
+        index  = var.project_refs.skill;
+        first  = var.project_refs.first;
+        count  = var.project_refs.count;
+    }
+    else
+    {
+        GEN_ERROR(gen, "Only the projects of a persona or a skill can be sorted or grouped");
+        return (Variable) { 0 };
+    }
+
+    if (!gen->views)
+    {
+        GEN_ERROR(gen, "Lists can't be sorted or grouped here");
+        return (Variable) { 0 };
+    }
+
+    View* view = view_cache_get(gen->views, portfolio, gen->skills, source, index, spec);
+
+    Variable res = (spec.kind == VIEW_GROUP) ? var_make_project_groups(view) : var_make_project_refs(view->order);
+    if (spec.kind == VIEW_GROUP)
+    {
+        res.project_groups.first = first;
+        res.project_groups.count = count;
+    }
+    else
+    {
+        res.project_refs.first = first;
+        res.project_refs.count = count;
+    }
+
+    return res;
+}
+
+static Variable page_string(String str)
+{
+    return (str) ? var_make_string(str) : (Variable) { 0 };
+}
+
+// Returns 0 if the name isn't one of the page properties.
+static int get_page_prop(Generator* gen, Stage* stage, Portfolio portfolio, int selected_index, Variable* var)
+{
+    String name = stage->property.name;
+    Page_Info empty = { 0 };
+    Page_Info* page = (gen->page) ? gen->page : &empty;
+
+    if (string_cmp(name, "page"))
+        *var = page_string(page->number_text);
+    else if (string_cmp(name, "page_count"))
+        *var = page_string(page->count_text);
+    else if (string_cmp(name, "prev_page"))
+        *var = page_string(page->prev_name);
+    else if (string_cmp(name, "next_page"))
+        *var = page_string(page->next_name);
+    else if (string_cmp(name, "has_prev_page"))
+        *var = var_make_bool(page->prev_name != NULL);
+    else if (string_cmp(name, "has_next_page"))
+        *var = var_make_bool(page->next_name != NULL);
+    else
+        return 0;
+
+    // How many pages there are comes down to the number of projects.
+    if (selected_index >= 0)
+        record_dep(gen, "persona", portfolio.personas[selected_index].name, "projects");
+
+    return 1;
+}
+
+static Variable get_value(Generator* gen, DArray(Stage) stages, Stage* stage, Portfolio portfolio, int selected_index);
+
+static Variable resolve_value(Generator* gen, DArray(Stage) stages, Stage* stage, Portfolio portfolio, int selected_index)
+{
+    if (stage->property.parent_index == -1)
+    {
+        if (stage->property.scope > 0)
+            return gen->scopes[stage->property.scope].var;
+
         if (string_cmp(stage->property.name, "personas"))
+        {
+            record_dep(gen, "personas", NULL, NULL);
             return var_make_persona_list(portfolio.personas);
+        }
 
         if (string_cmp(stage->property.name, "links"))
+        {
+            record_dep(gen, "links", NULL, NULL);
             return var_make_link_list(portfolio.links);
+        }
+
+        if (string_cmp(stage->property.name, "skills") && gen->skills)
+        {
+            record_dep(gen, "skills", NULL, NULL);
+            return var_make_skill_list(gen->skills->skills);
+        }
+
+        if (string_cmp(stage->property.name, "skill") && gen->skill)
+            return var_make_skill(gen->skill);
+
+        Variable page_var;
+        if (get_page_prop(gen, stage, portfolio, selected_index, &page_var))
+            return page_var;
+
+        // Project pages get their project and persona pages get
+        // their persona by name too.
+        if (string_cmp(stage->property.name, "persona") && selected_index >= 0)
+        {
+            Variable persona = var_make_persona(portfolio.personas[selected_index], 1);
+            persona.persona.index = selected_index;
+            return persona;
+        }
 
-        return get_persona_prop(gen, stage, portfolio.personas[selected_index], 1);
+        if (string_cmp(stage->property.name, "project") && gen->project)
+        {
+            Variable project = var_make_project(*gen->project);
+            project.project.persona = selected_index;
+            return project;
+        }
+
+        if (selected_index < 0)
+            return (Variable) { 0 };
+
+        return get_persona_prop(gen, stage, portfolio.personas[selected_index], selected_index, 1);
     }
 
     Variable var = get_value(gen, stages, stages + stage->property.parent_index, portfolio, selected_index);
@@ -584,12 +1258,12 @@ static Variable get_value(Generator* gen, DArray(Stage) stages, Stage* stage, Po
     {
         case VAR_PERSONA:
         {
-            return get_persona_prop(gen, stage, var.persona.data, var.persona.selected);
+            return get_persona_prop(gen, stage, var.persona.data, var.persona.index, var.persona.selected);
         }
 
         case VAR_PROJECT:
         {
-            return get_project_prop(gen, stage, var.project.data);
+            return get_project_prop(gen, stage, var.project.data, var.project.persona, portfolio, selected_index);
         }
 
         case VAR_LINK:
@@ -597,6 +1271,16 @@ static Variable get_value(Generator* gen, DArray(Stage) stages, Stage* stage, Po
             return get_link_prop(gen, stage, var.link.data);
         }
 
+        case VAR_SKILL:
+        {
+            return get_skill_prop(gen, stage, var.skill.data);
+        }
+
+        case VAR_PROJECT_GROUP:
+        {
+            return get_group_prop(gen, stage, var);
+        }
+
         default:
         {
             GEN_ERROR(gen, "Parent variable not valid");
@@ -605,6 +1289,42 @@ static Variable get_value(Generator* gen, DArray(Stage) stages, Stage* stage, Po
     }
 }
 
+// Properties are only looked up once for each page or each item of
+// the list their variable comes from. After that it's their slot.
+static Variable get_value(Generator* gen, DArray(Stage) stages, Stage* stage, Portfolio portfolio, int selected_index)
+{
+    int slot = stage->property.slot;
+    unsigned long long stamp = gen->scopes[stage->property.scope].stamp;
+
+    while (da_size(gen->memos) <= slot)
+    {
+        Stamped_Variable empty = { 0 };
+        da_push_back(gen->memos, empty);
+    }
+
+    if (gen->memos[slot].stamp == stamp)
+        return gen->memos[slot].var;
+
+    Variable var = resolve_value(gen, stages, stage, portfolio, selected_index);
+
+    gen->memos[slot].var   = var;
+    gen->memos[slot].stamp = stamp;
+    return var;
+}
+
+// Gives the variable of the list at depth a new value.
+static void bind_scope(Generator* gen, int depth, Variable var)
+{
+    while (da_size(gen->scopes) <= depth)
+    {
+        Stamped_Variable empty = { 0 };
+        da_push_back(gen->scopes, empty);
+    }
+
+    gen->scopes[depth].var   = var;
+    gen->scopes[depth].stamp = ++gen->stamp;
+}
+
 Variable evaluate_condition(Generator* gen, DArray(Stage) stages, Portfolio portfolio, int selected_index)
 {
     // For now it just checks the value of the last stage.
@@ -634,7 +1354,7 @@ static void fill_buffer(Generator* gen, DArray(Stage) stages,
         {
             case STAGE_HTML:
             {
-                add_to_buffer(gen, stage->html.content);
+                add_html(gen, stage->html.content);
             } break;
 
             case STAGE_PROPERTY:
@@ -645,7 +1365,7 @@ static void fill_buffer(Generator* gen, DArray(Stage) stages,
                     break;
                 
                 if (var.type == VAR_STRING)
-                    add_to_buffer(gen, var.string.data);
+                    add_value(gen, var.string.data, stage->property.escape);
 
             } break;
 
@@ -653,6 +1373,9 @@ static void fill_buffer(Generator* gen, DArray(Stage) stages,
             {
                 Variable var = get_value(gen, stages, stages + stage->list.parent_index, portfolio, selected_index);
 
+                if (gen->status != GEN_FAILURE && stage->list.view.kind != VIEW_NONE)
+                    var = apply_view(gen, var, stage->list.view, portfolio);
+
                 if (gen->status == GEN_FAILURE)
                     break;
 
@@ -666,28 +1389,24 @@ static void fill_buffer(Generator* gen, DArray(Stage) stages,
                                 break;
 
                             Variable v = var_make_string(*str);
-                            dict_put(gen->vs, stage->list.it_name, v);
+                            bind_scope(gen, stage->list.depth, v);
                             fill_buffer(gen, stage->list.stages, portfolio, selected_index);
                         }
-
-                        Variable empty = (Variable) { 0 };
-                        dict_put(gen->vs, stage->list.it_name, empty);
                     } break;
 
                     case VAR_PROJECT_LIST:
                     {
-                        da_foreach(Project, proj, var.project_list.list)
+                        int end = var.project_list.first + var.project_list.count;
+                        for (int i = var.project_list.first; i < end; i++)
                         {
                             if (gen->status == GEN_FAILURE)
                                 break;
 
-                            Variable v = var_make_project(*proj);
-                            dict_put(gen->vs, stage->list.it_name, v);
+                            Variable v = var_make_project(var.project_list.list[i]);
+                            v.project.persona = var.project_list.persona;
+                            bind_scope(gen, stage->list.depth, v);
                             fill_buffer(gen, stage->list.stages, portfolio, selected_index);
                         }
-
-                        Variable empty = (Variable) { 0 };
-                        dict_put(gen->vs, stage->list.it_name, empty);
                     } break;
 
                     case VAR_PERSONA_LIST:
@@ -699,12 +1418,69 @@ static void fill_buffer(Generator* gen, DArray(Stage) stages,
                                 break;
 
                             Variable v = var_make_persona(var.persona_list.list[i], selected_index == i);
-                            dict_put(gen->vs, stage->list.it_name, v);
+                            v.persona.index = i;
+                            bind_scope(gen, stage->list.depth, v);
                             fill_buffer(gen, stage->list.stages, portfolio, selected_index);
                         }
+                    } break;
 
-                        Variable empty = (Variable) { 0 };
-                        dict_put(gen->vs, stage->list.it_name, empty);
+                    case VAR_SKILL_LIST:
+                    {
+                        int size = da_size(var.skill_list.list);
+                        for (int i = 0; i < size; i++)
+                        {
+                            if (gen->status == GEN_FAILURE)
+                                break;
+
+                            Variable v = var_make_skill(var.skill_list.list + i);
+                            bind_scope(gen, stage->list.depth, v);
+                            fill_buffer(gen, stage->list.stages, portfolio, selected_index);
+                        }
+                    } break;
+
+                    case VAR_PROJECT_REFS:
+                    {
+                        int end = var.project_refs.first + var.project_refs.count;
+                        for (int i = var.project_refs.first; i < end; i++)
+                        {
+                            if (gen->status == GEN_FAILURE)
+                                break;
+
+                            Project_Ref* ref = var.project_refs.list + i;
+                            Project* proj = portfolio.personas[ref->persona].projects + ref->project;
+                            record_dep(gen, "project", proj->page, NULL);
+
+                            Variable v = var_make_project(*proj);
+                            v.project.persona = ref->persona;
+                            bind_scope(gen, stage->list.depth, v);
+                            fill_buffer(gen, stage->list.stages, portfolio, selected_index);
+                        }
+                    } break;
+
+                    case VAR_PROJECT_GROUPS:
+                    {
+                        int end = var.project_groups.first + var.project_groups.count;
+                        da_foreach(View_Group, group, var.project_groups.view->groups)
+                        {
+                            if (gen->status == GEN_FAILURE)
+                                break;
+
+                            // Only the part of the group that's on the page.
+                            int group_first = (group->first > var.project_groups.first) ? group->first : var.project_groups.first;
+                            int group_end   = (group->first + group->count < end) ? group->first + group->count : end;
+                            if (group_first >= group_end)
+                                continue;
+
+                            Variable v;
+                            v.type = VAR_PROJECT_GROUP;
+                            v.project_group.name  = group->name;
+                            v.project_group.list  = var.project_groups.view->order;
+                            v.project_group.first = group_first;
+                            v.project_group.count = group_end - group_first;
+
+                            bind_scope(gen, stage->list.depth, v);
+                            fill_buffer(gen, stage->list.stages, portfolio, selected_index);
+                        }
                     } break;
 
                     case VAR_LINK_LIST:
@@ -715,12 +1491,9 @@ static void fill_buffer(Generator* gen, DArray(Stage) stages,
                                 break;
 
                             Variable v = var_make_link(*link);
-                            dict_put(gen->vs, stage->list.it_name, v);
+                            bind_scope(gen, stage->list.depth, v);
                             fill_buffer(gen, stage->list.stages, portfolio, selected_index);
                         }
-
-                        Variable empty = (Variable) { 0 };
-                        dict_put(gen->vs, stage->list.it_name, empty);
                     } break;
 
                     default:
@@ -761,108 +1534,56 @@ void generate_page(Generator* generator, Portfolio portfolio, int selected_index
     generator->cur_index = 0;
     generator->status = GEN_NO_GEN;
 
+    // Values found for the last page are no good for this one.
+    generator->scopes[0].stamp = ++generator->stamp;
+
+    // The generator may have been moved since the last page.
+    if (generator->minify)
+        minifier_reset(&generator->minifier, emit_output, generator);
+
     fill_buffer(generator, generator->stages, portfolio, selected_index);
 
+    if (generator->minify)
+        minify_finish(&generator->minifier);
+
     if (generator->status != GEN_FAILURE)
         generator->status = GEN_SUCCESS;
 }
 
-Webpage_Status generate_webpages(Portfolio portfolio)
+void generate_page_stream(Generator* generator, Portfolio portfolio, int selected_index, Stream* stream)
 {
-    String home_template = load_file(portfolio.home_template);
-    if (!home_template)
-        return WP_MISSING_TEMPLATE;
-
-    Template_Parser tp = template_parser_make(home_template);
-    template_parser_parse(&tp);
-
-    if (tp.status == GEN_FAILURE)
-    {
-        printf("%s\n", tp.message);
-        return WP_TEMPLATE_ERROR;
-    }
-
-    Generator gen = generator_make(tp.stages);
-    generate_page(&gen, portfolio, -1);
-
-    if (gen.status == GEN_FAILURE)
-    {
-        printf("%s\n", gen.message);
-        return WP_TEMPLATE_ERROR;
-    }
-
-    String home_output = generator_output(gen);
-    char filename[128];
-    sprintf(filename, "%s/index.html", portfolio.outdir);
-    int res = write_file(filename, home_output);
+    generator->stream = stream;
+    generate_page(generator, portfolio, selected_index);
+    generator->stream = NULL;
 
-    if (!res)
-        return WP_WRITE_ERROR;
-
-    printf("%s\n", filename);
-
-    generator_free(&gen);
-    string_free(&home_output);
-    string_free(&home_template);
+    stream_flush(stream);
+}
 
-    String page_template = load_file(portfolio.page_template);
-    if (!page_template)
-        return WP_MISSING_TEMPLATE;
+void generator_reset(Generator* generator)
+{
+    da_clear(generator->segments);
+    generator->output_size = 0;
 
-    tp = template_parser_make(page_template);
-    template_parser_parse(&tp);
+    free_deps(generator);
+}
 
-    if (tp.status == TP_FAILURE)
-    {
-        printf("%s\n", tp.message);
-        return WP_TEMPLATE_ERROR;
-    }
+// The caller owns the returned keys.
+DArray(String) generator_take_deps(Generator* generator)
+{
+    DArray(String) keys = NULL;
+    da_make(keys);
 
-    gen = generator_make(tp.stages);
-    int num_personas = da_size(portfolio.personas);
-    for (int i = 0; gen.status != GEN_FAILURE && i < num_personas; i++)
+    dict_foreach(int, dep, generator->deps)
     {
-        generate_page(&gen, portfolio, i);
-        
-        if (gen.status == GEN_FAILURE)
+        if (dep->key)
         {
-            printf("%s\n", gen.message);
-            return WP_TEMPLATE_ERROR;
+            da_push_back(keys, dep->key);
+            dep->key = NULL;
         }
-
-        String output = generator_output(gen);
-        sprintf(filename, "%s/%s.html", portfolio.outdir, portfolio.personas[i].name);
-        int res = write_file(filename, output);
-
-        if (!res)
-            return WP_WRITE_ERROR;
-
-        printf("%s\n", filename);
-
-        generator_reset(&gen);
-        string_free(&output);
     }
 
-    generator_free(&gen);
-    string_free(&page_template);
-
-    if (gen.status != GEN_SUCCESS)
-        return WP_TEMPLATE_ERROR;
-
-    return WP_SUCCESS;
-}
-
-void generator_reset(Generator* generator)
-{
-    da_free(generator->buffer);
-    da_make(generator->buffer);
-
-    dict_foreach(Variable, var, generator->vs)
-        if (var->key)
-            string_free(&var->key);
-    
-    dict_free(generator->vs);
-    dict_make(generator->vs);
+    dict_free(generator->deps);
+    return keys;
 }
 
 String generator_output(Generator generator)
@@ -870,12 +1591,18 @@ String generator_output(Generator generator)
     if (generator.status != GEN_SUCCESS)
         return NULL;
 
-    int end = da_size(generator.buffer) - 1;
-    
-    if (generator.buffer[end])
-        da_push_back(generator.buffer, '\0');
-    
-    return string_make(generator.buffer);
+    String output = NULL;
+    string_resize(&output, generator.output_size);
+
+    size_t offset = 0;
+    da_foreach(Segment, seg, generator.segments)
+    {
+        memcpy(output + offset, seg->data, seg->length);
+        offset += seg->length;
+    }
+
+    output[offset] = '\0';
+    return output;
 }
 
 Variable var_make_bool(int value)
@@ -905,6 +1632,7 @@ Variable var_make_persona(Persona data, int selected)
     var.type = VAR_PERSONA;
     var.persona.data = data;
     var.persona.selected = selected;
+    var.persona.index = -1;
 
     return var;
 }
@@ -915,6 +1643,7 @@ Variable var_make_project(Project data)
 
     var.type = VAR_PROJECT;
     var.project.data = data;
+    var.project.persona = -1;
 
     return var;
 }
@@ -944,7 +1673,10 @@ Variable var_make_project_list(DArray(Project) list)
     Variable var;
 
     var.type = VAR_PROJECT_LIST;
-    var.project_list.list = list;
+    var.project_list.list  = list;
+    var.project_list.first = 0;
+    var.project_list.count = da_size(list);
+    var.project_list.persona = -1;
 
     return var;
 }
@@ -966,5 +1698,50 @@ Variable var_make_persona_list(DArray(Persona) list)
     var.type = VAR_PERSONA_LIST;
     var.persona_list.list = list;
 
+    return var;
+}
+
+Variable var_make_skill(Skill* data)
+{
+    Variable var;
+
+    var.type = VAR_SKILL;
+    var.skill.data = data;
+
+    return var;
+}
+
+Variable var_make_skill_list(DArray(Skill) list)
+{
+    Variable var;
+
+    var.type = VAR_SKILL_LIST;
+    var.skill_list.list = list;
+
+    return var;
+}
+
+Variable var_make_project_refs(DArray(Project_Ref) list)
+{
+    Variable var;
+
+    var.type = VAR_PROJECT_REFS;
+    var.project_refs.list  = list;
+    var.project_refs.first = 0;
+    var.project_refs.count = da_size(list);
+    var.project_refs.skill = -1;
+
+    return var;
+}
+
+Variable var_make_project_groups(View* view)
+{
+    Variable var;
+
+    var.type = VAR_PROJECT_GROUPS;
+    var.project_groups.view  = view;
+    var.project_groups.first = 0;
+    var.project_groups.count = da_size(view->order);
+
     return var;
 }
\ No newline at end of file
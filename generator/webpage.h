@@ -1,6 +1,12 @@
 #pragma once
 
 #include "portfolio.h"
+#include "filestuff.h"
+#include "minify.h"
+#include "assets.h"
+#include "skills.h"
+#include "views.h"
+#include "escape.h"
 #include "containers/string.h"
 #include "containers/darray.h"
 #include "containers/dictionary.h"
@@ -25,16 +31,28 @@ typedef struct Stage
             String content;
         } html;
 
+        // Escape is where the property is in the html, worked out
+        // when the template is parsed. So is scope, the depth of
+        // the list whose variable the property starts from (0 if
+        // it starts from the page), and slot, which is where the
+        // generator keeps the property's value once it's found.
         struct
         {
             String name;
             int parent_index;
+            Escape_Context escape;
+            int scope;
+            int slot;
         } property;
 
+        // The view is how the list is sorted or grouped, if at all.
+        // Depth is 1 for lists that aren't inside another list.
         struct
         {
             String it_name;
             int parent_index;
+            View_Spec view;
+            int depth;
             DArray(struct Stage) stages;
         } list;
 
@@ -67,6 +85,14 @@ typedef struct
     DArray(Stage) stages;
     Template_Parser_Status status;
     String message;
+
+    // Where the html parsed so far has left off.
+    Html_Scanner html;
+
+    // Variables of the lists being parsed, innermost last,
+    // and how many properties have been given slots.
+    DArray(String) scopes;
+    int num_slots;
 } Template_Parser;
 
 Template_Parser template_parser_make(String template);
@@ -82,7 +108,9 @@ typedef enum
 } Webpage_Status;
 
 Webpage_Status template_parser_test(Portfolio portfolio);
-Webpage_Status generate_webpages(Portfolio portfolio);
+int stages_use_portfolio_lists(DArray(Stage) stages);
+size_t stages_count(DArray(Stage) stages);
+void stages_add_assets(DArray(Stage) stages, Asset_Map* assets);
 
 typedef enum
 {
@@ -96,6 +124,11 @@ typedef enum
     VAR_LINK_LIST,
     VAR_PROJECT_LIST,
     VAR_PERSONA_LIST,
+    VAR_SKILL,
+    VAR_SKILL_LIST,
+    VAR_PROJECT_REFS,
+    VAR_PROJECT_GROUP,
+    VAR_PROJECT_GROUPS,
 } Variable_Type;
 
 typedef struct
@@ -107,8 +140,10 @@ typedef struct
             int value;
         } bool;
 
+        // Index is the persona's place in the portfolio.
         struct {
             int selected;
+            int index;
             Persona data;
         } persona;
 
@@ -116,8 +151,10 @@ typedef struct
             Link data;
         } link;
 
+        // Persona is the index of the persona the project is from.
         struct {
             Project data;
+            int persona;
         } project;
 
         struct {
@@ -132,13 +169,52 @@ typedef struct
             DArray(Link) list;
         } link_list;
 
+        // Paginated pages only go through part of the list.
         struct {
             DArray(Project) list;
+            int first;
+            int count;
+            int persona;
         } project_list;
         
         struct {
             DArray(Persona) list;
         } persona_list;
+
+        struct {
+            Skill* data;
+        } skill;
+
+        struct {
+            DArray(Skill) list;
+        } skill_list;
+
+        // Projects from anywhere in the portfolio. Sorted lists
+        // can be cut to a page like project lists. Skill is the
+        // index of the skill the list is from, -1 for views.
+        struct {
+            DArray(Project_Ref) list;
+            int first;
+            int count;
+            int skill;
+        } project_refs;
+
+        // Part of a view's order that shares a key. Groups on
+        // paginated pages only have the projects on the page.
+        struct {
+            String name;
+            DArray(Project_Ref) list;
+            int first;
+            int count;
+        } project_group;
+
+        // Groups of a view that have projects between first and
+        // first + count in its order.
+        struct {
+            View* view;
+            int first;
+            int count;
+        } project_groups;
     };
 } Variable;
 
@@ -151,6 +227,53 @@ Variable var_make_string_list(DArray(String) list);
 Variable var_make_link_list(DArray(Link) list);
 Variable var_make_project_list(DArray(Project) list);
 Variable var_make_persona_list(DArray(Persona) list);
+Variable var_make_skill(Skill* data);
+Variable var_make_skill_list(DArray(Skill) list);
+Variable var_make_project_refs(DArray(Project_Ref) list);
+Variable var_make_project_groups(View* view);
+
+// Longest name a page can have, without the output directory.
+#define PAGE_NAME_SIZE 128
+
+/*
+    A persona's projects are split over several pages when the
+    portfolio sets $page_size. Page 1 keeps the persona's name and
+    the rest get a number after it, like Name.html, Name-2.html.
+    Each page is rendered on its own with only its range of the
+    projects, so they can all be generated at the same time.
+*/
+typedef struct
+{
+    int number;
+    int count;
+    int first_project;
+    int num_projects;
+
+    // What templates see as page, page_count, prev_page and
+    // next_page. Pages point into these so they have to stay
+    // around until the page is written.
+    String number_text;
+    String count_text;
+    String prev_name;
+    String next_name;
+} Page_Info;
+
+int persona_page_count(Portfolio portfolio, int persona_index);
+void page_name(char* name, Persona persona, int number);
+
+// Lower case letters and digits, with everything in between turned
+// into single dashes. Anything outside of ASCII is kept as it is.
+// Returns the length of the slug.
+size_t name_slug(char* dest, size_t size, char* name);
+
+// Gives every project of the persona that doesn't have a page name
+// yet a name made from the persona and project names, like
+// game-developer--space-race.html.
+void persona_name_projects(Persona* persona);
+
+// Persona index -1 is for the home page, which is never split.
+Page_Info page_info_make(Portfolio portfolio, int persona_index, int number);
+void page_info_free(Page_Info* page);
 
 typedef enum
 {
@@ -161,16 +284,62 @@ typedef enum
 
 typedef struct
 {
-    Dict(Variable) vs;
+    Variable var;
+    unsigned long long stamp;
+} Stamped_Variable;
+
+typedef struct
+{
+    // Variable of the list at each depth, with the page at depth 0.
+    // Scopes get a new stamp every time their variable changes and
+    // a property's value is kept in its slot in memos for as long as
+    // its scope has the same stamp.
+    DArray(Stamped_Variable) scopes;
+    DArray(Stamped_Variable) memos;
+    unsigned long long stamp;
+
     DArray(Stage) stages;
     int cur_index;
-    DArray(char) buffer;
+    DArray(Segment) segments;
+    Stream* stream;
+    size_t output_size;
     Generator_Status status;
     String message;
+
+    // Names of the inputs read while generating the page. Only
+    // filled in when track_deps is set (see deps.h).
+    int track_deps;
+    Dict(int) deps;
+
+    // Output goes through the minifier first when set.
+    int minify;
+    Minifier minifier;
+
+    // Asset paths are swapped for their fingerprinted names if set.
+    Asset_Map* assets;
+
+    // Part of the selected persona's projects that are on the
+    // page. Everything is on one page if this isn't set.
+    Page_Info* page;
+
+    // The project a project page is for, which templates
+    // get as project. NULL on every other page.
+    Project* project;
+
+    // Every skill in the portfolio, which templates get as skills,
+    // and the skill a skill page is for. Both can be NULL.
+    Skill_Map* skills;
+    Skill* skill;
+
+    // Sorted and grouped lists, shared by every generator of a
+    // build. Lists can't have views if it's NULL.
+    View_Cache* views;
 } Generator;
 
 Generator generator_make(DArray(Stage) stages);
 void generator_free(Generator* generator);
 void generator_reset(Generator* generator);
 void generate_page(Generator* generator, Portfolio portfolio, int selected_index);
-String generator_output(Generator generator);
\ No newline at end of file
+void generate_page_stream(Generator* generator, Portfolio portfolio, int selected_index, Stream* stream);
+String generator_output(Generator generator);
+DArray(String) generator_take_deps(Generator* generator);
\ No newline at end of file
@@ -0,0 +1,516 @@
+#include "writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include "jobs.h"
+#include "containers/hd_assert.h"
+
+// Building with SWG_NO_IO_URING always uses the thread pool.
+#if defined(__linux__) && !defined(SWG_NO_IO_URING)
+#define USE_IO_URING
+#endif
+
+#ifdef USE_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+// Creates the directories for every file, skipping the ones the
+// file before it was already in.
+static void make_output_dirs(Output_File* files, int count)
+{
+    char* last = NULL;
+    size_t last_length = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        char* path = files[i].path;
+        size_t length = 0;
+
+        for (size_t j = 0; path[j]; j++)
+            if (path[j] == '/' || path[j] == '\\')
+                length = j;
+
+        if (length == 0 || (last && length == last_length && !strncmp(path, last, length)))
+            continue;
+
+        make_dirs(path);
+        last = path;
+        last_length = length;
+    }
+}
+
+static void write_blocking(Output_File* file)
+{
+    errno = 0;
+    if (!write_segments(file->path, file->segments, file->count))
+        file->error = (errno) ? errno : EIO;
+}
+
+static void write_file_job(void* data, int worker, int job)
+{
+    write_blocking((Output_File*) data + job);
+}
+
+#ifdef USE_IO_URING
+
+// Most iovecs a single writev takes.
+#define WRITER_IOV_MAX 1024
+
+typedef struct
+{
+    int fd;
+    unsigned entries;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void*  sq_map;
+    size_t sq_map_size;
+    void*  cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+
+    // Entries that have been queued and the ones the kernel took,
+    // and how many of those haven't completed yet.
+    unsigned tail;
+    unsigned submitted;
+    unsigned in_flight;
+} Ring;
+
+static int ring_supports_ops(int fd)
+{
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*) calloc(1, size);
+    hd_assert(probe != NULL);
+
+    int res = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+
+    int ops[] = { IORING_OP_OPENAT, IORING_OP_WRITEV, IORING_OP_CLOSE };
+    for (int i = 0; res && i < (int) (sizeof(ops) / sizeof(ops[0])); i++)
+        res = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+
+    free(probe);
+    return res;
+}
+
+static void ring_free(Ring* ring)
+{
+    if (ring->sqes && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_size);
+
+    if (ring->cq_map && ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map)
+        munmap(ring->cq_map, ring->cq_map_size);
+
+    if (ring->sq_map && ring->sq_map != MAP_FAILED)
+        munmap(ring->sq_map, ring->sq_map_size);
+
+    close(ring->fd);
+    free(ring);
+}
+
+// Returns NULL if the kernel can't do everything the writer needs.
+static Ring* ring_make(unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return NULL;
+
+    if (!ring_supports_ops(fd))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    Ring* ring = (Ring*) calloc(1, sizeof(Ring));
+    hd_assert(ring != NULL);
+
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    int single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_map)
+    {
+        if (ring->cq_map_size > ring->sq_map_size)
+            ring->sq_map_size = ring->cq_map_size;
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+    ring->cq_map = (single_map) ? ring->sq_map :
+                   mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+    ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        ring_free(ring);
+        return NULL;
+    }
+
+    char* sq = (char*) ring->sq_map;
+    ring->sq_head  = (unsigned*) (sq + params.sq_off.head);
+    ring->sq_tail  = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+
+    char* cq = (char*) ring->cq_map;
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes    = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    ring->tail = ring->submitted = *ring->sq_tail;
+    return ring;
+}
+
+// Callers never queue more than the ring holds between runs.
+static struct io_uring_sqe* ring_get_sqe(Ring* ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    hd_assert(ring->tail - head < ring->entries);
+
+    unsigned index = ring->tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = ring->sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+
+    ring->sq_array[index] = index;
+    ring->tail++;
+    return sqe;
+}
+
+typedef struct
+{
+    int fd;
+    int closed;
+    size_t expected;
+    size_t written;
+    struct iovec* iov;
+} File_State;
+
+enum { OP_OPEN, OP_WRITE, OP_CLOSE };
+
+#define USER_DATA(file, op) (((uint64_t) (file) << 2) | (op))
+
+static void complete(Output_File* files, File_State* states, struct io_uring_cqe* cqe)
+{
+    int file = (int) (cqe->user_data >> 2);
+    int op   = (int) (cqe->user_data & 3);
+    int res  = cqe->res;
+
+    Output_File* out = files + file;
+    File_State* state = states + file;
+
+    switch (op)
+    {
+        case OP_OPEN:
+        {
+            if (res >= 0)
+                state->fd = res;
+            else
+                out->error = -res;
+        } break;
+
+        case OP_WRITE:
+        {
+            // Writes after a short one get cancelled and
+            // the file is written again afterwards.
+            if (res >= 0)
+                state->written += res;
+            else if (res != -ECANCELED && !out->error)
+                out->error = -res;
+        } break;
+
+        case OP_CLOSE:
+        {
+            if (res != -ECANCELED)
+                state->closed = 1;
+
+            if (res < 0 && res != -ECANCELED && !out->error)
+                out->error = -res;
+        } break;
+    }
+}
+
+// Handles every completion that's come in. Returns how many there were.
+static unsigned ring_reap(Ring* ring, Output_File* files, File_State* states)
+{
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned reaped = 0;
+
+    for (; head != tail; head++, reaped++)
+        complete(files, states, ring->cqes + (head & *ring->cq_mask));
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+    ring->in_flight -= reaped;
+    return reaped;
+}
+
+// Called once the ring stopped working. Whatever the kernel already
+// took can still be using the fds and buffers, so this waits for all
+// of it to complete before anything else touches them. Entries the
+// kernel never took are dropped.
+static void ring_drain(Ring* ring, Output_File* files, File_State* states)
+{
+    ring->submitted = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    ring->tail = ring->submitted;
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+    ring_reap(ring, files, states);
+
+    while (ring->in_flight > 0)
+    {
+        // Completions still get posted without the syscall,
+        // so keep polling for them if it fails.
+        int res = syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (res < 0 && errno != EINTR)
+            usleep(1000);
+
+        ring_reap(ring, files, states);
+    }
+}
+
+// Submits everything that's been queued and handles completions
+// until count of them came in. Returns 0 if the ring stopped working,
+// after everything it took has completed.
+static int ring_run(Ring* ring, unsigned count, Output_File* files, File_State* states)
+{
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+    unsigned done = 0;
+    while (done < count)
+    {
+        unsigned to_submit = ring->tail - ring->submitted;
+        int res = syscall(__NR_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        if (res < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+
+            ring_drain(ring, files, states);
+            return 0;
+        }
+
+        ring->submitted += res;
+        ring->in_flight += res;
+
+        done += ring_reap(ring, files, states);
+    }
+
+    return 1;
+}
+
+static unsigned writes_needed(size_t count)
+{
+    return (unsigned) ((count + WRITER_IOV_MAX - 1) / WRITER_IOV_MAX);
+}
+
+/*
+    Files go through in chunks that fit in the ring. All the opens of
+    a chunk are submitted together, then every file's writes and its
+    close are linked so the close only runs once the writes worked.
+    Anything that didn't go through completely (short writes, or the
+    ring failing) is written again with blocking calls.
+*/
+static int ring_write_files(Ring* ring, Output_File* files, int count)
+{
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += files[i].count;
+
+    if (count <= 0)
+        return 1;
+
+    File_State* states = (File_State*) calloc((size_t) count, sizeof(File_State));
+    struct iovec* iov = (struct iovec*) malloc((total + 1) * sizeof(struct iovec));
+    hd_assert(states != NULL && iov != NULL);
+
+    struct iovec* next_iov = iov;
+    for (int i = 0; i < count; i++)
+    {
+        states[i].fd  = -1;
+        states[i].iov = next_iov;
+
+        for (size_t j = 0; j < files[i].count; j++)
+        {
+            next_iov[j].iov_base = files[i].segments[j].data;
+            next_iov[j].iov_len  = files[i].segments[j].length;
+            states[i].expected  += files[i].segments[j].length;
+        }
+
+        next_iov += files[i].count;
+    }
+
+    int working = 1;
+    int first = 0;
+    while (working && first < count)
+    {
+        // Files too big for the ring are left for the blocking writes.
+        int last = first;
+        unsigned ops = 0;
+        while (last < count)
+        {
+            unsigned file_ops = writes_needed(files[last].count) + 1;
+            if (file_ops <= ring->entries && ops + file_ops > ring->entries)
+                break;
+
+            if (file_ops <= ring->entries)
+                ops += file_ops;
+            last++;
+        }
+
+        unsigned opens = 0;
+        for (int i = first; i < last; i++)
+        {
+            if (writes_needed(files[i].count) + 1 > ring->entries)
+                continue;
+
+            struct io_uring_sqe* sqe = ring_get_sqe(ring);
+            sqe->opcode     = IORING_OP_OPENAT;
+            sqe->fd         = AT_FDCWD;
+            sqe->addr       = (uint64_t) (uintptr_t) files[i].path;
+            sqe->len        = 0644;
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            sqe->user_data  = USER_DATA(i, OP_OPEN);
+            opens++;
+        }
+
+        working = ring_run(ring, opens, files, states);
+
+        unsigned queued = 0;
+        for (int i = first; working && i < last; i++)
+        {
+            int fd = states[i].fd;
+            if (fd < 0)
+                continue;
+
+            size_t offset = 0;
+            for (size_t j = 0; j < files[i].count; j += WRITER_IOV_MAX)
+            {
+                size_t n = files[i].count - j;
+                if (n > WRITER_IOV_MAX)
+                    n = WRITER_IOV_MAX;
+
+                struct io_uring_sqe* sqe = ring_get_sqe(ring);
+                sqe->opcode    = IORING_OP_WRITEV;
+                sqe->fd        = fd;
+                sqe->addr      = (uint64_t) (uintptr_t) (states[i].iov + j);
+                sqe->len       = (unsigned) n;
+                sqe->off       = offset;
+                sqe->flags     = IOSQE_IO_LINK;
+                sqe->user_data = USER_DATA(i, OP_WRITE);
+                queued++;
+
+                for (size_t k = 0; k < n; k++)
+                    offset += states[i].iov[j + k].iov_len;
+            }
+
+            struct io_uring_sqe* sqe = ring_get_sqe(ring);
+            sqe->opcode    = IORING_OP_CLOSE;
+            sqe->fd        = fd;
+            sqe->user_data = USER_DATA(i, OP_CLOSE);
+            queued++;
+        }
+
+        if (working)
+            working = ring_run(ring, queued, files, states);
+
+        first = last;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        File_State* state = states + i;
+
+        if (state->fd >= 0 && !state->closed)
+            close(state->fd);
+
+        int finished = state->fd >= 0 && state->closed && state->written == state->expected;
+        if (!files[i].error && !finished)
+            write_blocking(files + i);
+    }
+
+    free(iov);
+    free(states);
+    return working;
+}
+
+#endif // USE_IO_URING
+
+File_Writer file_writer_make(int threads)
+{
+    File_Writer writer = { 0 };
+    writer.threads = (threads > 1) ? threads : 1;
+
+    #ifdef USE_IO_URING
+    writer.ring = ring_make(WRITER_RING_ENTRIES);
+    #endif
+
+    return writer;
+}
+
+void file_writer_free(File_Writer* writer)
+{
+    #ifdef USE_IO_URING
+    if (writer->ring)
+        ring_free((Ring*) writer->ring);
+    #endif
+
+    writer->ring = NULL;
+}
+
+void file_writer_write(File_Writer* writer, Output_File* files, int count)
+{
+    for (int i = 0; i < count; i++)
+        files[i].error = 0;
+
+    make_output_dirs(files, count);
+
+    #ifdef USE_IO_URING
+    if (writer && writer->ring)
+    {
+        // The thread pool takes over for good if the ring breaks.
+        if (!ring_write_files((Ring*) writer->ring, files, count))
+            file_writer_free(writer);
+
+        return;
+    }
+    #endif
+
+    if (writer && writer->threads > 1 && count > 1)
+    {
+        int threads = (writer->threads < count) ? writer->threads : count;
+        jobs_run(threads, count, write_file_job, files);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+        write_blocking(files + i);
+}
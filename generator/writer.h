@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include "filestuff.h"
+
+// Operations handed to the kernel at once when using io_uring.
+#define WRITER_RING_ENTRIES 256
+
+// Blocking writers used when io_uring isn't available.
+#define WRITER_THREADS 4
+
+// A file made of pieces of memory that get written in order.
+// error is set to the errno of whatever went wrong, 0 otherwise.
+typedef struct
+{
+    char*    path;
+    Segment* segments;
+    size_t   count;
+    int      error;
+} Output_File;
+
+/*
+    Writes many files at once. On Linux the opens, writes and closes
+    for a whole batch go through io_uring so a batch costs a couple
+    of system calls instead of a few per file. Everywhere else, or if
+    the kernel doesn't support it, a pool of threads does blocking
+    writes. Directories are created as needed either way.
+*/
+typedef struct
+{
+    void* ring;
+    int threads;
+} File_Writer;
+
+File_Writer file_writer_make(int threads);
+void file_writer_free(File_Writer* writer);
+
+// Writer can be NULL to write everything on the calling thread.
+void file_writer_write(File_Writer* writer, Output_File* files, int count);
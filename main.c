@@ -1,66 +1,451 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "generator/filestuff.h"
 #include "generator/parser.h"
 #include "generator/portfolio.h"
 #include "generator/webpage.h"
+#include "generator/build.h"
+#include "generator/hash.h"
+#include "generator/watch.h"
+#include "generator/serve.h"
+#include "generator/trace.h"
 
 #include "containers/darray.h"
 #include "containers/string.h"
 
 // #define DEBUG
 
+static void print_usage()
+{
+    printf("Usage: swg [options] <portfolio file>\n");
+    printf("Options:\n");
+    printf("    --stream[=<KB>]    Stream pages to disk through a fixed size buffer\n");
+    printf("    -j <N>             Render N pages at the same time\n");
+    printf("    --incremental      Only regenerate pages whose inputs changed\n");
+    printf("    --prune            Delete pages earlier runs wrote that aren't generated any more,\n");
+    printf("                       unless they were edited since\n");
+    printf("    --compress[=<1-9>] Write gzip (and brotli) compressed copies of every page\n");
+    printf("    --minify           Strip comments and extra whitespace from the HTML\n");
+    printf("    --assets           Copy referenced files into the output under fingerprinted names\n");
+    printf("    --search           Write a search index over the projects to search.idx\n");
+    printf("    --stats[=<file>]   Print where the build spent its time (and write it to <file> as JSON)\n");
+    printf("    --trace <file>     Write what every thread did to <file> for chrome://tracing\n");
+    printf("    --watch            Keep running and rebuild whenever an input changes\n");
+    printf("    --serve [:<port>]  Serve a preview of the site on localhost without writing it\n");
+}
+
+static void print_status(Webpage_Status status)
+{
+    switch (status)
+    {
+        case WP_MISSING_TEMPLATE:
+        {
+            printf("Template not found.\n");
+        } break;
+
+        case WP_WRITE_ERROR:
+        {
+            printf("Couldn't write to file.\n");
+        } break;
+
+        case WP_TEMPLATE_ERROR:
+        {
+            printf("Error generating webpage.\n");
+        } break;
+    }
+}
+
+// Lexing, parsing and loading templates overlap. The lexer only
+// runs one statement ahead of the parser and templates start
+// loading on their own thread as soon as their paths are known.
+// The lexer takes the contents. Returns 0 if parsing failed.
+static int parse_portfolio(Site_Build* build, String contents, Portfolio* portfolio)
+{
+    Build_Stats* stats = build->options.stats;
+    Trace_Span span = trace_begin("portfolio");
+
+    Lexer lexer = lexer_make(contents);
+    Parser parser = parser_make(NULL);
+
+    int more = 1;
+    while (more)
+    {
+        Stat_Span span = stats_begin(stats, STAT_LEX);
+        more = lexer_lex_step(&lexer);
+        stats_end(stats, span);
+
+        if (lexer.status == LEXER_FAILURE)
+        {
+            printf("%s\n", lexer.message);
+            break;
+        }
+
+        // The last token is the '$' of the next statement
+        // unless the whole file has been lexed.
+        parser.tokens = lexer.tokens;
+        int num_tokens = da_size(parser.tokens) - more;
+
+        while (parser.status != PARSER_FAILURE && parser.current_token_idx < num_tokens)
+        {
+            Stat_Span span = stats_begin(stats, STAT_PARSE);
+            Parse_Step step = parser_parse_step(&parser, portfolio);
+            stats_end(stats, span);
+
+            if (parser.status == PARSER_FAILURE)
+                break;
+
+            if (step == PARSE_STEP_SETTING &&
+                portfolio->home_template && portfolio->page_template)
+                site_build_load_templates(build, *portfolio);
+
+            if (step == PARSE_STEP_PERSONA)
+                site_build_persona_parsed(build, *portfolio, da_size(portfolio->personas) - 1);
+        }
+
+        if (parser.status == PARSER_FAILURE)
+        {
+            printf("%s\n", parser.message);
+            break;
+        }
+    }
+
+    int res = lexer.status != LEXER_FAILURE && parser.status != PARSER_FAILURE;
+
+    if (stats)
+        stats->tokens = da_size(lexer.tokens);
+
+    // The tokens belong to the lexer.
+    parser.tokens = NULL;
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    trace_end(span, NULL);
+    return res;
+}
+
+// Rebuilds the site whenever the portfolio, one of its templates or,
+// with --assets, one of the files it copies changes. Builds are
+// incremental and keep their parsed templates and manifest around for
+// the next one. The portfolio is only parsed again if it changed,
+// otherwise the one from last time gets reused. Stats are reported and
+// the trace is written after every build.
+static int watch_site(char* filepath, Webpage_Options options, char* stats_path, char* trace_path)
+{
+    options.incremental = 1;
+
+    Build_Cache cache = build_cache_make();
+    Watcher watcher = watcher_make();
+    watcher_add(&watcher, filepath);
+
+    Portfolio portfolio = portfolio_make();
+    uint64_t portfolio_hash = 0;
+    int has_portfolio = 0;
+
+    do
+    {
+        if (options.stats)
+            stats_reset(options.stats);
+
+        if (trace_path)
+            trace_start();
+
+        Stat_Span span = stats_begin(options.stats, STAT_LOAD);
+        String contents = load_file(filepath);
+        stats_end(options.stats, span);
+
+        if (!contents)
+        {
+            printf("Error: Couldn't read %s\n", filepath);
+            continue;
+        }
+
+        Site_Build build = site_build_make(options, &cache);
+        uint64_t hash = hash_bytes(contents, strlen(contents), 0);
+
+        if (has_portfolio && hash == portfolio_hash)
+        {
+            string_free(&contents);
+        }
+        else
+        {
+            portfolio_free(&portfolio);
+            portfolio = portfolio_make();
+            portfolio_hash = hash;
+            has_portfolio = parse_portfolio(&build, contents, &portfolio);
+        }
+
+        if (has_portfolio)
+        {
+            print_status(site_build_finish(&build, portfolio));
+
+            if (portfolio.home_template)
+                watcher_add(&watcher, portfolio.home_template);
+
+            if (portfolio.page_template)
+                watcher_add(&watcher, portfolio.page_template);
+
+            if (portfolio.project_template)
+                watcher_add(&watcher, portfolio.project_template);
+
+            if (portfolio.skill_template)
+                watcher_add(&watcher, portfolio.skill_template);
+
+            // Copied assets are named after their contents, so the
+            // pages using them have to change when they do.
+            if (build.has_assets)
+            {
+                da_foreach(Asset, asset, build.assets.assets)
+                {
+                    if (asset->status != ASSET_MISSING)
+                        watcher_add(&watcher, asset->path);
+                }
+            }
+
+            if (options.stats)
+                stats_report(options.stats, stats_path);
+        }
+
+        site_build_free(&build);
+
+        if (trace_path && !trace_write(trace_path))
+            printf("Error: Couldn't write %s\n", trace_path);
+
+        printf("Watching for changes...\n");
+        fflush(stdout);
+    } while (watcher_wait(&watcher, WATCH_DEBOUNCE_MS));
+
+    watcher_free(&watcher);
+    portfolio_free(&portfolio);
+    build_cache_free(&cache);
+    trace_stop();
+    return 1;
+}
+
 int main(int argc, char* argv[])
 {
+    Webpage_Options options = { 0 };
+    char* filepath = NULL;
+    int watch = 0;
+    int port = 0;
+
+    Build_Stats stats;
+    char* stats_path = NULL;
+    char* trace_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--stream", 8) == 0)
+        {
+            options.stream_size = WP_DEFAULT_STREAM_SIZE;
+
+            if (argv[i][8] == '=')
+                options.stream_size = strtoul(argv[i] + 9, NULL, 10) * 1024;
+
+            if (options.stream_size == 0)
+            {
+                printf("Error: Stream buffer size must be at least 1KB\n");
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (strncmp(argv[i], "--compress", 10) == 0)
+        {
+            options.compress_level = COMPRESS_DEFAULT_LEVEL;
+
+            if (argv[i][10] == '=')
+                options.compress_level = atoi(argv[i] + 11);
+
+            if (options.compress_level < 1 || options.compress_level > COMPRESS_MAX_LEVEL)
+            {
+                printf("Error: Compression level must be between 1 and 9\n");
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (strcmp(argv[i], "--incremental") == 0)
+        {
+            options.incremental = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--prune") == 0)
+        {
+            options.prune = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--minify") == 0)
+        {
+            options.minify = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--assets") == 0)
+        {
+            options.assets = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--search") == 0)
+        {
+            options.search = 1;
+            continue;
+        }
+
+        if (strncmp(argv[i], "--stats", 7) == 0 && (argv[i][7] == '\0' || argv[i][7] == '='))
+        {
+            options.stats = &stats;
+
+            if (argv[i][7] == '=')
+                stats_path = argv[i] + 8;
+
+            if (stats_path && *stats_path == '\0')
+            {
+                printf("Error: --stats= expects a file to write the stats to\n");
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (strncmp(argv[i], "--trace", 7) == 0 && (argv[i][7] == '\0' || argv[i][7] == '='))
+        {
+            if (argv[i][7] == '=')
+                trace_path = argv[i] + 8;
+            else if (i + 1 < argc)
+                trace_path = argv[++i];
+
+            if (!trace_path || *trace_path == '\0')
+            {
+                printf("Error: --trace expects a file to write the trace to\n");
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (strcmp(argv[i], "--watch") == 0)
+        {
+            watch = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--serve") == 0)
+        {
+            port = SERVE_DEFAULT_PORT;
+
+            char* addr = (i + 1 < argc) ? argv[i + 1] : "";
+            if (*addr == ':' || (*addr >= '0' && *addr <= '9'))
+            {
+                port = atoi(addr + (*addr == ':'));
+                i++;
+            }
+
+            if (port <= 0 || port > 65535)
+            {
+                printf("Error: --serve expects a port like :8080\n");
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            char* count = argv[i] + 2;
+            if (*count == '\0' && i + 1 < argc)
+                count = argv[++i];
+
+            options.jobs = atoi(count);
+            if (options.jobs < 1)
+            {
+                printf("Error: -j expects a positive number of jobs\n");
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (argv[i][0] == '-')
+        {
+            printf("Error: Unknown option %s\n", argv[i]);
+            print_usage();
+            return 1;
+        }
+
+        filepath = argv[i];
+    }
+
     #ifdef DEBUG
-    String contents = load_file("portfolio/portfolio.txt");
+    filepath = "portfolio/portfolio.txt";
     #else    
-    if (argc < 2)
+    if (!filepath)
     {
         printf("Error: No file provided\n");
+        print_usage();
         return 1;
     }
-
-    String contents = load_file(argv[1]);
     #endif    
 
-    Lexer lexer = lexer_make(contents);
-    lexer_lex(&lexer);
+    if (port)
+        return !serve_site(filepath, port);
+
+    if (options.stats)
+        stats_make(options.stats);
+
+    if (watch)
+        return watch_site(filepath, options, stats_path, trace_path);
+
+    if (trace_path)
+        trace_start();
 
-    if (lexer.status == LEXER_FAILURE)
+    Stat_Span span = stats_begin(options.stats, STAT_LOAD);
+    String contents = load_file(filepath);
+    stats_end(options.stats, span);
+
+    if (!contents)
     {
-        printf("%s\n", lexer.message);
+        printf("Error: Couldn't read %s\n", filepath);
         return 1;
     }
 
-    Parser parser = parser_make(lexer.tokens);
-    Portfolio portfolio = parser_parse(&parser);
+    Site_Build build = site_build_make(options, NULL);
+    Portfolio portfolio = portfolio_make();
 
-    if (parser.status == PARSER_FAILURE)
+    if (!parse_portfolio(&build, contents, &portfolio))
     {
-        printf("%s\n", parser.message);
+        site_build_free(&build);
+
+        if (trace_path)
+            trace_write(trace_path);
+
         return 1;
     }
 
-    Webpage_Status status = generate_webpages(portfolio);
-    switch (status)
+    Webpage_Status status = site_build_finish(&build, portfolio);
+    site_build_free(&build);
+
+    print_status(status);
+
+    if (trace_path)
     {
-        case WP_MISSING_TEMPLATE:
-        {
-            printf("Template not found.\n");
-        } break;
+        if (!trace_write(trace_path))
+            printf("Error: Couldn't write %s\n", trace_path);
 
-        case WP_WRITE_ERROR:
-        {
-            printf("Couldn't write to file.\n");
-        } break;
+        trace_stop();
+    }
 
-        case WP_TEMPLATE_ERROR:
-        {
-            printf("Error generating webpage.\n");
-        } break;
+    if (options.stats)
+    {
+        stats_report(options.stats, stats_path);
+        stats_free(options.stats);
     }
 
-    parser_free(&parser);
     portfolio_free(&portfolio);
-}
\ No newline at end of file
+}